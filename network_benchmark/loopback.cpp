@@ -0,0 +1,250 @@
+#include "loopback.hpp"
+
+#include <utility\network.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <thread>
+
+using namespace std;
+using namespace utility;
+
+namespace
+{
+	typedef chrono::steady_clock clock_type;
+
+	const size_t SIZE_OF_TIMESTAMP = sizeof(clock_type::rep);
+
+	struct case_result
+	{
+		size_t messages;
+		double seconds;
+		vector<double> latencies_us;
+	};
+
+	//	the listening and the connecting address of the case, they're unique per case
+	//	so the connections of the previous case don't get in the way
+	pair<string, string> addresses_of(const string& transport_, size_t index_)
+	{
+		const auto suffix = to_string(index_);
+
+		if (transport_ == "tcp")
+		{
+			return { to_string(27300 + index_), "localhost" };
+		}
+
+		if (transport_ == "unix")
+		{
+			char temp_path[MAX_PATH];
+			GetTempPathA(MAX_PATH, temp_path);
+
+			const auto address = string { "unix:" } + temp_path + "loopback_benchmark_" + suffix + ".sock";
+			return { address, address };
+		}
+
+		if (transport_ == "shm")
+		{
+			const auto address = "shm:loopback_benchmark_" + suffix;
+			return { address, address };
+		}
+
+		throw runtime_error { "unknown transport: " + transport_ };
+	}
+
+	void send_messages(end_point& end_point_, size_t count_, size_t size_)
+	{
+		vector<char> message(size_, 'x');
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			const auto now = clock_type::now().time_since_epoch().count();
+			memcpy(message.data(), &now, SIZE_OF_TIMESTAMP);
+
+			end_point_.write(message.data(), message.size());
+		}
+	}
+
+	//	reads in big chunks and picks the timestamps at the message boundaries
+	void receive_messages(end_point& end_point_, size_t count_, size_t size_, vector<double>& latencies_us_)
+	{
+		vector<char> buffer(64 * 1024);
+
+		//	the timestamp of the current message may be split over two reads
+		char timestamp[SIZE_OF_TIMESTAMP];
+		size_t offset_in_message = 0;
+
+		latencies_us_.reserve(count_);
+
+		for (size_t received = 0; received < count_;)
+		{
+			const auto size = end_point_.read(buffer.data(), buffer.size());
+
+			if (size == 0)
+			{
+				throw runtime_error { "the sender has disconnected" };
+			}
+
+			const auto now = clock_type::now().time_since_epoch().count();
+
+			for (size_t i = 0; i < size;)
+			{
+				if (offset_in_message < SIZE_OF_TIMESTAMP)
+				{
+					const auto n = SIZE_OF_TIMESTAMP - offset_in_message < size - i ? SIZE_OF_TIMESTAMP - offset_in_message : size - i;
+
+					memcpy(timestamp + offset_in_message, buffer.data() + i, n);
+					offset_in_message += n;
+					i += n;
+				}
+				else
+				{
+					const auto n = size_ - offset_in_message < size - i ? size_ - offset_in_message : size - i;
+
+					offset_in_message += n;
+					i += n;
+				}
+
+				if (offset_in_message == size_)
+				{
+					clock_type::rep sent;
+					memcpy(&sent, timestamp, SIZE_OF_TIMESTAMP);
+
+					latencies_us_.push_back(chrono::duration<double, micro> { clock_type::duration { now - sent } }.count());
+
+					offset_in_message = 0;
+					++received;
+				}
+			}
+		}
+	}
+
+	case_result run_case(const string& transport_, size_t index_, size_t size_, size_t count_of_connections_, size_t count_of_messages_)
+	{
+		const auto addresses = addresses_of(transport_, index_);
+
+		server srv { desc { addresses.first } };
+
+		vector<unique_ptr<end_point>> receivers;
+		vector<unique_ptr<client>> senders;
+
+		auto accepting = async(launch::async, [&]
+		{
+			for (size_t i = 0; i < count_of_connections_; ++i)
+			{
+				receivers.push_back(make_unique<end_point>(srv.listening()));
+			}
+		});
+
+		for (size_t i = 0; i < count_of_connections_; ++i)
+		{
+			senders.push_back(make_unique<client>(addresses.second, desc { addresses.first }));
+			senders.back()->set_no_delay(true);
+		}
+
+		accepting.get();
+
+		//	the messages are split evenly, the remainder goes to the first connection
+		const auto per_connection = count_of_messages_ / count_of_connections_;
+		const auto remainder = count_of_messages_ % count_of_connections_;
+
+		vector<vector<double>> latencies(count_of_connections_);
+		vector<future<void>> tasks;
+
+		const auto start = clock_type::now();
+
+		for (size_t i = 0; i < count_of_connections_; ++i)
+		{
+			const auto count = per_connection + (i == 0 ? remainder : 0);
+
+			tasks.push_back(async(launch::async, receive_messages, ref(*receivers[i]), count, size_, ref(latencies[i])));
+			tasks.push_back(async(launch::async, send_messages, ref(*senders[i]), count, size_));
+		}
+
+		//	all of them are waited for before the first error is rethrown
+		for (auto& t : tasks)
+		{
+			t.wait();
+		}
+
+		const auto seconds = chrono::duration<double> { clock_type::now() - start }.count();
+
+		for (auto& t : tasks)
+		{
+			t.get();
+		}
+
+		case_result result { count_of_messages_, seconds, { } };
+
+		for (auto& l : latencies)
+		{
+			result.latencies_us.insert(result.latencies_us.end(), l.begin(), l.end());
+		}
+
+		sort(result.latencies_us.begin(), result.latencies_us.end());
+
+		return result;
+	}
+
+	double percentile(const vector<double>& sorted_, double p_)
+	{
+		if (sorted_.empty())
+		{
+			return 0;
+		}
+
+		const auto i = static_cast<size_t>(p_ * sorted_.size());
+		return sorted_[i < sorted_.size() ? i : sorted_.size() - 1];
+	}
+
+	size_t default_count_of_messages(size_t size_)
+	{
+		const size_t count = 64 * 1024 * 1024 / size_;
+		return count < 2000 ? 2000 : count > 200000 ? 200000 : count;
+	}
+}
+
+void run_loopback(const loopback_options& options_, report& report_)
+{
+	size_t index = 0;
+
+	for (auto& transport : options_.transports)
+	{
+		for (auto requested_size : options_.sizes)
+		{
+			const auto size = requested_size < SIZE_OF_TIMESTAMP ? SIZE_OF_TIMESTAMP : requested_size;
+
+			for (auto connections : options_.connections)
+			{
+				const auto count_of_connections = connections ? connections : 1;
+				const auto count_of_messages = options_.messages ? options_.messages : default_count_of_messages(size);
+
+				auto& row = report_.add("loopback")
+					.set("transport", transport)
+					.set("size", size)
+					.set("connections", count_of_connections);
+
+				try
+				{
+					auto r = run_case(transport, index++, size, count_of_connections, count_of_messages);
+
+					row.set("messages", r.messages)
+						.set("seconds", r.seconds, 3)
+						.set("mb_per_s", r.messages * size / r.seconds / 1e6)
+						.set("msgs_per_s", r.messages / r.seconds, 0)
+						.set("latency_p50_us", percentile(r.latencies_us, 0.50), 1)
+						.set("latency_p90_us", percentile(r.latencies_us, 0.90), 1)
+						.set("latency_p99_us", percentile(r.latencies_us, 0.99), 1)
+						.set("latency_p999_us", percentile(r.latencies_us, 0.999), 1)
+						.set("latency_max_us", r.latencies_us.empty() ? 0.0 : r.latencies_us.back(), 1);
+				}
+				catch (exception& e_)
+				{
+					row.set("error", e_.what());
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "report.hpp"
+
+#include <string>
+#include <vector>
+
+//
+//	the loopback matrix: every transport x size of a message x count of connections
+//
+//	Each connection is driven by its own sender and receiver thread. Every message
+//	carries the steady_clock time of its sending in its first 8 bytes, so the
+//	receiver records the one way latency of every message, queueing included.
+//
+struct loopback_options
+{
+	//	the messages are at least 8 bytes for the timestamp
+	std::vector<size_t> sizes { 64, 1024, 16 * 1024, 64 * 1024 };
+	std::vector<size_t> connections { 1, 4, 16 };
+
+	//	"tcp", "unix", "shm"
+	std::vector<std::string> transports { "tcp" };
+
+	//	per case, shared by the connections, zero: about 64MB but 2000..200000 messages
+	size_t messages = 0;
+};
+
+//	adds a row per case to the "loopback" suite, a failed case has an "error" field
+void run_loopback(const loopback_options&, report&);
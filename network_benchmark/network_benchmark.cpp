@@ -0,0 +1,813 @@
+#include <utility\network.hpp>
+#include <utility\event_loop.hpp>
+#include <utility\framing.hpp>
+#include <utility\coalescing_writer.hpp>
+#include <utility\buffer_pool.hpp>
+#include <utility\connection_pool.hpp>
+#include <thread_pool\thread_pool>
+
+#include "loopback.hpp"
+#include "report.hpp"
+#include "rpc_benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#pragma comment(lib, "utility.lib")
+#pragma comment(lib, "thread_pool.lib")
+
+using namespace std;
+using namespace utility;
+
+//
+//	non-interactive benchmark harness, the results are printed as JSON by default
+//
+//	suites:
+//		loopback	the transports x sizes of a message x counts of connections, with the
+//					throughput and the percentiles of the one way latency, see loopback.hpp
+//		backends	one connection, blocking vs. event_loop backends, and the registered I/O
+//					with the slices, which aren't copied
+//		events		debugger like events as frames, one write per event vs. coalesced writes
+//		transports	loopback TCP, unix socket and shared memory by streaming and by ping-pong
+//		connect		the latency of getting a connection: connecting every time vs. a connection_pool
+//		receive		handing the received messages over to a thread_pool task by copying vs. by
+//					pooled slices
+//		rpc			calls per second of an echo method by size and by count of calls in flight
+//
+//	usage: network_benchmark [options]
+//		--suites loopback,backends,...|all		default: loopback
+//		--sizes 64,1024,16384,65536				sizes of a message of the loopback and the rpc suites
+//		--connections 1,4,16					counts of connections of the loopback suite
+//		--transports tcp,unix,shm				transports of the loopback suite, default: tcp
+//		--messages N							per loopback and rpc case, default: derived from the size
+//		--in-flight 1,64						counts of calls in flight of the rpc suite
+//		--count N								messages of the other suites, default: 100000
+//		--size N								size of a message of the other suites, default: 64
+//		--format json|table						default: json
+//		--output <path>							default: the standard output
+//
+
+// every heap allocation of the process is counted
+atomic<size_t> count_of_allocations { 0 };
+
+void* operator new(size_t size_)
+{
+	++count_of_allocations;
+
+	if (auto ptr = malloc(size_ ? size_ : 1))
+	{
+		return ptr;
+	}
+
+	throw bad_alloc { };
+}
+
+void operator delete(void* ptr_) noexcept
+{
+	free(ptr_);
+}
+
+enum E_MODE { MODE_BLOCKING, MODE_POLL, MODE_REGISTERED_IO, MODE_REGISTERED_IO_SLICES };
+
+struct result
+{
+	double messages_per_second;
+	double cpu_us_per_message;
+};
+
+// user + kernel time of the whole process
+double process_cpu_seconds()
+{
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+
+	auto to_seconds = [](FILETIME ft_)
+	{
+		ULARGE_INTEGER n;
+		n.LowPart = ft_.dwLowDateTime;
+		n.HighPart = ft_.dwHighDateTime;
+
+		return n.QuadPart / 1e7;
+	};
+
+	return to_seconds(kernel) + to_seconds(user);
+}
+
+void run_blocking(end_point& sender_, end_point& receiver_, size_t count_, size_t size_)
+{
+	thread th_sender { [&]
+	{
+		vector<char> message(size_, 'x');
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			sender_.write(message.data(), message.size());
+		}
+	} };
+
+	vector<char> buffer(64 * 1024);
+
+	for (size_t received = 0; received < count_ * size_;)
+	{
+		received += receiver_.read(buffer.data(), buffer.size());
+	}
+
+	th_sender.join();
+}
+
+void run_async(event_loop& loop_, end_point& sender_, end_point& receiver_, size_t count_, size_t size_)
+{
+	loop_.attach(sender_);
+	loop_.attach(receiver_);
+
+	vector<char> message(size_, 'x');
+	vector<char> buffer(64 * 1024);
+
+	promise<void> sent, received;
+
+	// one message in flight, the next one is written by the completion of the previous one
+	atomic<size_t> count_of_sent { 0 };
+	function<void(size_t, exception_ptr)> on_sent = [&](size_t, exception_ptr)
+	{
+		if (++count_of_sent == count_)
+		{
+			sent.set_value();
+			return;
+		}
+
+		sender_.async_write(message.data(), message.size(), on_sent);
+	};
+
+	size_t count_of_received_bytes = 0;
+	function<void(size_t, exception_ptr)> on_received = [&](size_t size_of_chunk_, exception_ptr error_)
+	{
+		count_of_received_bytes += size_of_chunk_;
+
+		if (error_ || size_of_chunk_ == 0 || count_of_received_bytes == count_ * size_)
+		{
+			received.set_value();
+			return;
+		}
+
+		receiver_.async_read(buffer.data(), buffer.size(), on_received);
+	};
+
+	receiver_.async_read(buffer.data(), buffer.size(), on_received);
+	sender_.async_write(message.data(), message.size(), on_sent);
+
+	sent.get_future().wait();
+	received.get_future().wait();
+
+	loop_.detach(sender_);
+	loop_.detach(receiver_);
+}
+
+//	the same with the blocks of the event_loop, the registered I/O sends and receives them in place
+void run_async_slices(event_loop& loop_, end_point& sender_, end_point& receiver_, size_t count_, size_t size_)
+{
+	loop_.attach(sender_);
+	loop_.attach(receiver_);
+
+	auto block = loop_.acquire_buffer(size_);
+	fill(block.first, block.first + size_, 'x');
+
+	const auto message = block.second.slice(0, size_);
+
+	promise<void> sent, received;
+
+	atomic<size_t> count_of_sent { 0 };
+	function<void(size_t, exception_ptr)> on_sent = [&](size_t, exception_ptr)
+	{
+		if (++count_of_sent == count_)
+		{
+			sent.set_value();
+			return;
+		}
+
+		sender_.async_write(message, on_sent);
+	};
+
+	size_t count_of_received_bytes = 0;
+	function<void(buffer_slice, exception_ptr)> on_received = [&](buffer_slice slice_, exception_ptr error_)
+	{
+		count_of_received_bytes += slice_.size();
+
+		if (error_ || slice_.empty() || count_of_received_bytes == count_ * size_)
+		{
+			received.set_value();
+			return;
+		}
+
+		receiver_.async_read_slice(on_received);
+	};
+
+	receiver_.async_read_slice(on_received);
+	sender_.async_write(message, on_sent);
+
+	sent.get_future().wait();
+	received.get_future().wait();
+
+	loop_.detach(sender_);
+	loop_.detach(receiver_);
+}
+
+result measure(E_MODE mode_, size_t count_, size_t size_)
+{
+	// a fresh port for every run, the previous connections may be still in TIME_WAIT
+	const auto port = to_string(27200 + mode_);
+
+	server srv { desc { port } };
+
+	auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+	client c { "localhost", desc { port } };
+	auto ptr_peer = accepting.get();
+
+	thread_pool pool { 2 };
+	unique_ptr<event_loop> ptr_loop;
+
+	if (mode_ == MODE_POLL)
+	{
+		ptr_loop = make_unique<event_loop>(pool, 1, IO_BACKEND_POLL);
+	}
+	else if (mode_ == MODE_REGISTERED_IO || mode_ == MODE_REGISTERED_IO_SLICES)
+	{
+		ptr_loop = make_unique<event_loop>(pool, 1, IO_BACKEND_REGISTERED_IO);
+	}
+
+	const auto cpu_start = process_cpu_seconds();
+	const auto start = chrono::high_resolution_clock::now();
+
+	if (mode_ == MODE_REGISTERED_IO_SLICES)
+	{
+		run_async_slices(*ptr_loop, c, *ptr_peer, count_, size_);
+	}
+	else if (ptr_loop)
+	{
+		run_async(*ptr_loop, c, *ptr_peer, count_, size_);
+	}
+	else
+	{
+		run_blocking(c, *ptr_peer, count_, size_);
+	}
+
+	const chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+	const auto cpu_elapsed = process_cpu_seconds() - cpu_start;
+
+	return { count_ / elapsed.count(), cpu_elapsed * 1e6 / count_ };
+}
+
+enum E_EVENT_WRITER { EVENT_WRITER_DIRECT, EVENT_WRITER_DIRECT_NO_DELAY, EVENT_WRITER_COALESCED };
+
+double measure_events(E_EVENT_WRITER writer_, size_t count_)
+{
+	const auto port = to_string(27210 + writer_);
+
+	server srv { desc { port } };
+
+	auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+	client c { "localhost", desc { port } };
+	auto ptr_peer = accepting.get();
+
+	// about the size of a value change notification of the debugger
+	const string EVENT { "{\"type\": \"value_change\", \"rv_name\": \"0x0000001234567890\", \"value\": \"42\"}" };
+
+	const auto start = chrono::high_resolution_clock::now();
+
+	auto receiving = async(launch::async, [&]
+	{
+		frame_reader reader { *ptr_peer };
+
+		size_t count_of_events = 0;
+		while (count_of_events < count_ && reader.read())
+		{
+			++count_of_events;
+		}
+
+		return count_of_events;
+	});
+
+	if (writer_ == EVENT_WRITER_COALESCED)
+	{
+		c.set_no_delay(true);
+
+		coalescing_writer cw { c };
+		frame_writer writer { cw };
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			writer.write(EVENT);
+		}
+
+		cw.flush();
+	}
+	else
+	{
+		c.set_no_delay(writer_ == EVENT_WRITER_DIRECT_NO_DELAY);
+
+		frame_writer writer { c };
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			writer.write(EVENT);
+		}
+	}
+
+	if (receiving.get() != count_)
+	{
+		throw runtime_error { "the connection was closed before every event arrived" };
+	}
+
+	const chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+
+	return count_ / elapsed.count();
+}
+
+struct transport_result
+{
+	double messages_per_second;
+	double cpu_us_per_message;
+	double round_trip_us;
+};
+
+transport_result measure_transport(const string& server_address_, const string& client_address_, size_t count_, size_t size_)
+{
+	server srv { desc { server_address_ } };
+
+	auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+	client c { client_address_, desc { server_address_ } };
+	auto ptr_peer = accepting.get();
+
+	c.set_no_delay(true);
+	ptr_peer->set_no_delay(true);
+
+	transport_result result;
+
+	// streaming
+	{
+		const auto cpu_start = process_cpu_seconds();
+		const auto start = chrono::high_resolution_clock::now();
+
+		run_blocking(c, *ptr_peer, count_, size_);
+
+		const chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+
+		result.messages_per_second = count_ / elapsed.count();
+		result.cpu_us_per_message = (process_cpu_seconds() - cpu_start) * 1e6 / count_;
+	}
+
+	// ping-pong, the peer echoes every message
+	{
+		const size_t count_of_round_trips = count_ / 10 + 1;
+
+		thread th_echo { [&]
+		{
+			vector<char> buffer(size_);
+
+			for (size_t i = 0; i < count_of_round_trips; ++i)
+			{
+				for (size_t received = 0; received < size_;)
+				{
+					received += ptr_peer->read(buffer.data() + received, size_ - received);
+				}
+
+				ptr_peer->write(buffer.data(), size_);
+			}
+		} };
+
+		vector<char> message(size_, 'x');
+
+		const auto start = chrono::high_resolution_clock::now();
+
+		for (size_t i = 0; i < count_of_round_trips; ++i)
+		{
+			c.write(message.data(), size_);
+
+			for (size_t received = 0; received < size_;)
+			{
+				received += c.read(message.data() + received, size_ - received);
+			}
+		}
+
+		const chrono::duration<double, micro> elapsed = chrono::high_resolution_clock::now() - start;
+
+		th_echo.join();
+
+		result.round_trip_us = elapsed.count() / count_of_round_trips;
+	}
+
+	return result;
+}
+
+struct connect_result
+{
+	double p50_us;
+	double p99_us;
+};
+
+connect_result measure_connect(bool pooled_, size_t count_)
+{
+	const auto port = to_string(27240 + pooled_);
+
+	thread_pool pool { 1 };
+	event_loop loop { pool };
+	server srv { desc { port } };
+
+	mutex mtx;
+	vector<shared_ptr<end_point>> accepted;
+
+	srv.async_accept(loop, [&](shared_ptr<end_point> ptr_end_point_, exception_ptr error_)
+	{
+		if (!error_)
+		{
+			lock_guard<mutex> l { mtx };
+			accepted.push_back(move(ptr_end_point_));
+		}
+	});
+
+	connection_pool connections;
+
+	vector<double> latencies;
+	latencies.reserve(count_);
+
+	for (size_t i = 0; i < count_; ++i)
+	{
+		const auto start = chrono::high_resolution_clock::now();
+
+		if (pooled_)
+		{
+			auto connection = connections.acquire("localhost", port);
+			connection->write("x", 1);
+		}
+		else
+		{
+			client c { "localhost", desc { port } };
+			c.write("x", 1);
+		}
+
+		const chrono::duration<double, micro> elapsed = chrono::high_resolution_clock::now() - start;
+		latencies.push_back(elapsed.count());
+	}
+
+	sort(latencies.begin(), latencies.end());
+
+	return { latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100] };
+}
+
+enum E_RECEIVER { RECEIVER_COPY, RECEIVER_POOLED_SLICES };
+
+struct receive_result
+{
+	double allocations_per_mb;
+	double copied_bytes_per_mb;
+};
+
+receive_result measure_receive(E_RECEIVER receiver_, size_t count_, size_t size_)
+{
+	const auto port = to_string(27220 + receiver_);
+
+	server srv { desc { port } };
+
+	auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+	client c { "localhost", desc { port } };
+	auto ptr_peer = accepting.get();
+
+	thread_pool pool { 1 };
+	buffer_pool buffers;
+	ptr_peer->set_buffer_pool(buffers);
+
+	atomic<size_t> count_of_processed_bytes { 0 };
+
+	const vector<char> message(size_, 'x');
+
+	thread th_sender { [&]
+	{
+		for (size_t i = 0; i < count_; ++i)
+		{
+			c.write(message.data(), message.size());
+		}
+	} };
+
+	// the sender doesn't allocate, everything counted from here belongs to the receiver
+	const size_t allocations_before = count_of_allocations;
+	size_t copied_bytes = 0;
+	size_t received_bytes = 0;
+
+	while (received_bytes < count_ * size_)
+	{
+		if (receiver_ == RECEIVER_COPY)
+		{
+			// the way the callers of read() did it: a buffer per read, a copy for the task
+			vector<char> buffer(512);
+
+			const auto size = ptr_peer->read(buffer.data(), buffer.size());
+			if (size == 0)
+			{
+				break;
+			}
+
+			auto ptr_chunk = make_shared<string>(buffer.data(), size);
+			copied_bytes += size;
+			received_bytes += size;
+
+			pool.submit([ptr_chunk, &count_of_processed_bytes] { count_of_processed_bytes += ptr_chunk->size(); });
+		}
+		else
+		{
+			auto slice = ptr_peer->read_slice();
+			if (slice.empty())
+			{
+				break;
+			}
+
+			received_bytes += slice.size();
+
+			pool.submit([slice, &count_of_processed_bytes] { count_of_processed_bytes += slice.size(); });
+		}
+	}
+
+	const size_t allocations = count_of_allocations - allocations_before;
+
+	th_sender.join();
+
+	while (count_of_processed_bytes < received_bytes)
+	{
+		this_thread::yield();
+	}
+
+	if (receiver_ == RECEIVER_POOLED_SLICES)
+	{
+		copied_bytes = buffers.statistics().copied_bytes;
+	}
+
+	const double mb = received_bytes / (1024.0 * 1024.0);
+
+	return { allocations / mb, copied_bytes / mb };
+}
+
+vector<string> split(const string& list_)
+{
+	vector<string> items;
+
+	istringstream is { list_ };
+
+	for (string item; getline(is, item, ',');)
+	{
+		if (!item.empty())
+		{
+			items.push_back(item);
+		}
+	}
+
+	return items;
+}
+
+vector<size_t> split_numbers(const string& list_)
+{
+	vector<size_t> numbers;
+
+	for (auto& item : split(list_))
+	{
+		numbers.push_back(stoul(item));
+	}
+
+	return numbers;
+}
+
+void run_backends(size_t count_, size_t size_, report& report_)
+{
+	const pair<E_MODE, const char*> modes[] =
+	{
+		{ MODE_BLOCKING, "blocking" },
+		{ MODE_POLL, "poll" },
+		{ MODE_REGISTERED_IO, "registered_io" },
+		{ MODE_REGISTERED_IO_SLICES, "registered_io_slices" },
+	};
+
+	for (auto& m : modes)
+	{
+		auto& row = report_.add("backends").set("backend", m.second).set("messages", count_).set("size", size_);
+
+		try
+		{
+			auto r = measure(m.first, count_, size_);
+
+			row.set("msgs_per_s", r.messages_per_second, 0)
+				.set("cpu_us_per_msg", r.cpu_us_per_message);
+		}
+		catch (exception& e_)
+		{
+			row.set("error", e_.what());
+		}
+	}
+}
+
+void run_events(size_t count_, report& report_)
+{
+	const pair<E_EVENT_WRITER, const char*> event_writers[] =
+	{
+		{ EVENT_WRITER_DIRECT, "direct" },
+		{ EVENT_WRITER_DIRECT_NO_DELAY, "direct_nodelay" },
+		{ EVENT_WRITER_COALESCED, "coalesced" },
+	};
+
+	for (auto& w : event_writers)
+	{
+		auto& row = report_.add("events").set("writer", w.second).set("events", count_);
+
+		try
+		{
+			row.set("events_per_s", measure_events(w.first, count_), 0);
+		}
+		catch (exception& e_)
+		{
+			row.set("error", e_.what());
+		}
+	}
+}
+
+void run_transports(size_t count_, size_t size_, report& report_)
+{
+	char temp_path[MAX_PATH];
+	GetTempPathA(MAX_PATH, temp_path);
+
+	const string unix_address = string { "unix:" } + temp_path + "network_benchmark.sock";
+
+	const tuple<const char*, string, string> transports[] =
+	{
+		make_tuple("tcp", "27230", "localhost"),
+		make_tuple("unix", unix_address, unix_address),
+		make_tuple("shm", "shm:network_benchmark", "shm:network_benchmark"),
+	};
+
+	for (auto& t : transports)
+	{
+		auto& row = report_.add("transports").set("transport", get<0>(t)).set("messages", count_).set("size", size_);
+
+		try
+		{
+			auto r = measure_transport(get<1>(t), get<2>(t), count_, size_);
+
+			row.set("msgs_per_s", r.messages_per_second, 0)
+				.set("cpu_us_per_msg", r.cpu_us_per_message)
+				.set("rtt_us", r.round_trip_us);
+		}
+		catch (exception& e_)
+		{
+			row.set("error", e_.what());
+		}
+	}
+}
+
+void run_connect(report& report_)
+{
+	const size_t count_of_connects = 1000;
+
+	for (auto pooled : { false, true })
+	{
+		auto& row = report_.add("connect").set("connection", pooled ? "pooled" : "connect").set("requests", count_of_connects);
+
+		try
+		{
+			auto r = measure_connect(pooled, count_of_connects);
+
+			row.set("p50_us", r.p50_us, 1)
+				.set("p99_us", r.p99_us, 1);
+		}
+		catch (exception& e_)
+		{
+			row.set("error", e_.what());
+		}
+	}
+}
+
+void run_receive(size_t count_, size_t size_, report& report_)
+{
+	const pair<E_RECEIVER, const char*> receivers[] =
+	{
+		{ RECEIVER_COPY, "copy" },
+		{ RECEIVER_POOLED_SLICES, "pooled_slices" },
+	};
+
+	for (auto& r : receivers)
+	{
+		auto& row = report_.add("receive").set("receiver", r.second).set("messages", count_).set("size", size_);
+
+		try
+		{
+			auto result = measure_receive(r.first, count_, size_);
+
+			row.set("allocs_per_mb", result.allocations_per_mb, 0)
+				.set("memcpy_bytes_per_mb", result.copied_bytes_per_mb, 0);
+		}
+		catch (exception& e_)
+		{
+			row.set("error", e_.what());
+		}
+	}
+}
+
+int main(int argc_, char* argv_[])
+{
+	vector<string> suites { "loopback" };
+	loopback_options loopback;
+	rpc_options rpc;
+
+	size_t count_of_messages = 100000;
+	size_t size_of_message = 64;
+
+	string format = "json";
+	string output;
+
+	try
+	{
+		for (int i = 1; i < argc_; ++i)
+		{
+			const string option = argv_[i];
+
+			if (i + 1 == argc_)
+			{
+				throw invalid_argument { "missing value of " + option };
+			}
+
+			const string value = argv_[++i];
+
+			if (option == "--suites") suites = split(value);
+			else if (option == "--sizes") loopback.sizes = rpc.sizes = split_numbers(value);
+			else if (option == "--connections") loopback.connections = split_numbers(value);
+			else if (option == "--transports") loopback.transports = split(value);
+			else if (option == "--messages") loopback.messages = rpc.calls = stoul(value);
+			else if (option == "--in-flight") rpc.in_flight = split_numbers(value);
+			else if (option == "--count") count_of_messages = stoul(value);
+			else if (option == "--size") size_of_message = stoul(value);
+			else if (option == "--format") format = value;
+			else if (option == "--output") output = value;
+			else throw invalid_argument { "unknown option " + option };
+		}
+
+		if (format != "json" && format != "table")
+		{
+			throw invalid_argument { "unknown format " + format };
+		}
+	}
+	catch (exception& e_)
+	{
+		cerr << e_.what() << endl;
+		cerr << "usage: network_benchmark [--suites loopback,backends,events,transports,connect,receive,rpc|all]"
+			" [--sizes N,...] [--connections N,...] [--transports tcp,unix,shm] [--messages N] [--in-flight N,...]"
+			" [--count N] [--size N] [--format json|table] [--output path]" << endl;
+
+		return 2;
+	}
+
+	auto selected = [&](const char* suite_)
+	{
+		return find(suites.begin(), suites.end(), "all") != suites.end() ||
+			find(suites.begin(), suites.end(), suite_) != suites.end();
+	};
+
+	report results;
+
+	if (selected("loopback")) run_loopback(loopback, results);
+	if (selected("backends")) run_backends(count_of_messages, size_of_message, results);
+	if (selected("events")) run_events(count_of_messages, results);
+	if (selected("transports")) run_transports(count_of_messages, size_of_message, results);
+	if (selected("connect")) run_connect(results);
+	if (selected("receive")) run_receive(count_of_messages, size_of_message, results);
+	if (selected("rpc")) run_rpc(rpc, results);
+
+	ofstream file;
+
+	if (!output.empty())
+	{
+		file.open(output);
+
+		if (!file)
+		{
+			cerr << "can't open " << output << endl;
+			return 1;
+		}
+	}
+
+	ostream& os = output.empty() ? cout : file;
+
+	if (format == "json")
+	{
+		results.print_json(os);
+	}
+	else
+	{
+		results.print_table(os);
+	}
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include "report.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace
+{
+	string quoted(const string& text_)
+	{
+		ostringstream sb;
+		sb << '"';
+
+		for (auto c : text_)
+		{
+			switch (c)
+			{
+			case '"': sb << "\\\""; break;
+			case '\\': sb << "\\\\"; break;
+			case '\n': sb << "\\n"; break;
+			case '\r': sb << "\\r"; break;
+			case '\t': sb << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					sb << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(c) << dec << setfill(' ');
+				}
+				else
+				{
+					sb << c;
+				}
+			}
+		}
+
+		sb << '"';
+		return sb.str();
+	}
+}
+
+report::row& report::row::set(const string& name_, const string& value_)
+{
+	_fields.push_back({ name_, value_, true });
+	return *this;
+}
+
+report::row& report::row::set(const string& name_, const char* value_)
+{
+	return set(name_, string { value_ });
+}
+
+report::row& report::row::set(const string& name_, double value_, int precision_)
+{
+	ostringstream sb;
+	sb << fixed << setprecision(precision_) << value_;
+
+	_fields.push_back({ name_, sb.str(), false });
+	return *this;
+}
+
+report::row& report::row::set(const string& name_, size_t value_)
+{
+	_fields.push_back({ name_, to_string(value_), false });
+	return *this;
+}
+
+report::row& report::add(const string& suite_)
+{
+	for (auto& s : _suites)
+	{
+		if (s.first == suite_)
+		{
+			s.second.emplace_back();
+			return s.second.back();
+		}
+	}
+
+	_suites.emplace_back(suite_, deque<row> { });
+	_suites.back().second.emplace_back();
+
+	return _suites.back().second.back();
+}
+
+void report::print_json(ostream& os_) const
+{
+	os_ << "{" << endl << "  \"suites\": {";
+
+	const char* suite_separator = "";
+
+	for (auto& s : _suites)
+	{
+		os_ << suite_separator << endl << "    " << quoted(s.first) << ": [";
+		suite_separator = ",";
+
+		const char* row_separator = "";
+
+		for (auto& r : s.second)
+		{
+			os_ << row_separator << endl << "      { ";
+			row_separator = ",";
+
+			const char* field_separator = "";
+
+			for (auto& f : r._fields)
+			{
+				os_ << field_separator << quoted(f.name) << ": " << (f.is_string ? quoted(f.text) : f.text);
+				field_separator = ", ";
+			}
+
+			os_ << " }";
+		}
+
+		os_ << endl << "    ]";
+	}
+
+	os_ << endl << "  }" << endl << "}" << endl;
+}
+
+void report::print_table(ostream& os_) const
+{
+	for (auto& s : _suites)
+	{
+		//	the columns are the union of the fields in the order of their first appearance
+		vector<string> columns;
+
+		for (auto& r : s.second)
+		{
+			for (auto& f : r._fields)
+			{
+				if (find(columns.begin(), columns.end(), f.name) == columns.end())
+				{
+					columns.push_back(f.name);
+				}
+			}
+		}
+
+		vector<size_t> widths;
+
+		for (auto& c : columns)
+		{
+			size_t width = c.size();
+
+			for (auto& r : s.second)
+			{
+				for (auto& f : r._fields)
+				{
+					if (f.name == c && f.text.size() > width)
+					{
+						width = f.text.size();
+					}
+				}
+			}
+
+			widths.push_back(width + 2);
+		}
+
+		os_ << s.first << endl;
+
+		for (size_t i = 0; i < columns.size(); ++i)
+		{
+			os_ << setw(widths[i]) << columns[i];
+		}
+
+		os_ << endl;
+
+		for (auto& r : s.second)
+		{
+			for (size_t i = 0; i < columns.size(); ++i)
+			{
+				string text;
+
+				for (auto& f : r._fields)
+				{
+					if (f.name == columns[i])
+					{
+						text = f.text;
+					}
+				}
+
+				os_ << setw(widths[i]) << text;
+			}
+
+			os_ << endl;
+		}
+
+		os_ << endl;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <deque>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+//	the results of the benchmark: named suites of flat rows
+//
+//	it's printed as
+//		{ "suites": { "<suite>": [ { "<field>": <value>, ... }, ... ], ... } }
+//	or as a table per suite for reading by eye
+//
+class report
+{
+public:
+	class row
+	{
+		friend class report;
+	public:
+		row& set(const std::string& name_, const std::string& value_);
+		row& set(const std::string& name_, const char* value_);
+		row& set(const std::string& name_, double value_, int precision_ = 2);
+		row& set(const std::string& name_, size_t value_);
+
+	private:
+		struct field
+		{
+			std::string name;
+			std::string text;
+			bool is_string;
+		};
+
+		std::vector<field> _fields;
+	};
+
+	//	the suites are printed in the order of their first row, the reference stays valid
+	row& add(const std::string& suite_);
+
+	void print_json(std::ostream&) const;
+	void print_table(std::ostream&) const;
+
+private:
+	std::vector<std::pair<std::string, std::deque<row>>> _suites;
+};
@@ -0,0 +1,105 @@
+#include "rpc_benchmark.hpp"
+
+#include <utility\mirror.h>
+#include <utility\rpc.hpp>
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace std;
+using namespace utility;
+
+namespace
+{
+	struct echo_service
+	{
+		string echo(string text_)
+		{
+			return text_;
+		}
+	};
+
+	double run_case(const base_runtime_database& runtime_, size_t index_, size_t size_, size_t in_flight_, size_t count_of_calls_)
+	{
+		const auto port = to_string(27400 + index_);
+
+		rpc_server srv { runtime_, desc { port } };
+		srv.bind("echo", object_ref { echo_service { } });
+
+		rpc_client c { runtime_, "localhost", desc { port } };
+
+		const string text(size_, 'x');
+
+		deque<future<object_ref>> calls;
+
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 0; i < count_of_calls_; ++i)
+		{
+			if (calls.size() == in_flight_)
+			{
+				calls.front().get();
+				calls.pop_front();
+			}
+
+			calls.push_back(c.call("echo", "echo", { object_ref { string { text } } }));
+		}
+
+		for (auto& f : calls)
+		{
+			f.get();
+		}
+
+		return chrono::duration<double> { chrono::steady_clock::now() - start }.count();
+	}
+
+	size_t default_count_of_calls(size_t size_)
+	{
+		const size_t count = 32 * 1024 * 1024 / (size_ ? size_ : 1);
+		return count < 1000 ? 1000 : count > 100000 ? 100000 : count;
+	}
+}
+
+void run_rpc(const rpc_options& options_, report& report_)
+{
+	base_runtime_database runtime;
+
+	runtime.add(make_shared<cpp_class_t>(
+		"echo_service",
+		type_of<echo_service>(),
+		make_constructor<echo_service>(),
+		method_t { "echo", &echo_service::echo }
+	));
+
+	size_t index = 0;
+
+	for (auto size : options_.sizes)
+	{
+		for (auto in_flight : options_.in_flight)
+		{
+			const auto window = in_flight ? in_flight : 1;
+			const auto count_of_calls = options_.calls ? options_.calls : default_count_of_calls(size);
+
+			auto& row = report_.add("rpc")
+				.set("size", size)
+				.set("in_flight", window)
+				.set("calls", count_of_calls);
+
+			try
+			{
+				const auto seconds = run_case(runtime, index++, size, window, count_of_calls);
+
+				row.set("seconds", seconds, 3)
+					.set("calls_per_s", count_of_calls / seconds, 0)
+					.set("mb_per_s", 2.0 * count_of_calls * size / seconds / 1e6);
+			}
+			catch (exception& e_)
+			{
+				row.set("error", e_.what());
+			}
+		}
+	}
+}
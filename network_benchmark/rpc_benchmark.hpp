@@ -0,0 +1,23 @@
+#pragma once
+
+#include "report.hpp"
+
+#include <vector>
+
+//
+//	calls per second of rpc_client/rpc_server over loopback TCP
+//
+//	A string of the given size is echoed by a method of a remote object. The calls are
+//	made one by one, then pipelined by keeping a window of calls in flight.
+//
+struct rpc_options
+{
+	std::vector<size_t> sizes { 64, 1024, 16 * 1024, 64 * 1024 };
+	std::vector<size_t> in_flight { 1, 64 };
+
+	//	per case, zero: about 32MB but 1000..100000 calls
+	size_t calls = 0;
+};
+
+//	adds a row per case to the "rpc" suite, a failed case has an "error" field
+void run_rpc(const rpc_options&, report&);
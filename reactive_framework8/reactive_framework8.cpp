@@ -2,11 +2,18 @@
 //
 
 #include "stdafx.h"
+#include "rv_benchmark.hpp"
 
 void function_one();
 
-int main()
+int main(int argc_, char* argv_[])
 {
+	//	reactive_framework8 --benchmark [options], see rv_benchmark.hpp
+	if (argc_ > 1 && std::string { argv_[1] } == "--benchmark")
+	{
+		return reactive_framework8::run_benchmark({ argv_ + 2, argv_ + argc_ });
+	}
+
 	function_one();
 
 	system("pause");
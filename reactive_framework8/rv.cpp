@@ -3,6 +3,10 @@
 #include "rv_debugger.hpp"
 #include "rv_remote_debugger.hpp"
 
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
 using namespace reactive_framework8;
 using namespace std;
 
@@ -24,6 +28,253 @@ template<class T> weak_ptr<T> as_weak(shared_ptr<T> ptr_)
 }
 
 
+namespace
+{
+	//	the nodes on the path from the new edge, reaching one of them again closes a loop
+	void raise_height(graph::inotifiable& node_, size_t height_, vector<graph::inotifiable*>& path_)
+	{
+		if (node_.height >= height_ || find(path_.begin(), path_.end(), &node_) != path_.end())
+		{
+			return;
+		}
+
+		node_.height = height_;
+
+		path_.push_back(&node_);
+
+		for (auto& t : node_.targets)
+		{
+			if (auto target = t.lock())
+			{
+				raise_height(*target, height_ + 1, path_);
+			}
+		}
+
+		path_.pop_back();
+	}
+}
+
+void graph::add_edge(inotifiable& source_, weak_ptr<inotifiable> target_)
+{
+	auto target = target_.lock();
+
+	source_.targets.push_back(move(target_));
+
+	if (target)
+	{
+		vector<inotifiable*> path { &source_ };
+
+		raise_height(*target, source_.height + 1, path);
+	}
+}
+
+void graph::release_source(shared_ptr<inotifiable> ptr_source_)
+{
+	//	the sources released by the destructors of the released ones
+	thread_local vector<shared_ptr<inotifiable>> released;
+	thread_local bool is_releasing = false;
+
+	if (!ptr_source_)
+	{
+		return;
+	}
+
+	auto& targets = ptr_source_->targets;
+	targets.erase(remove_if(targets.begin(), targets.end(), [](const weak_ptr<inotifiable>& t_) { return t_.expired(); }), targets.end());
+
+	released.push_back(move(ptr_source_));
+
+	if (is_releasing)
+	{
+		return;
+	}
+
+	is_releasing = true;
+
+	while (!released.empty())
+	{
+		auto ptr_node = move(released.back());
+		released.pop_back();
+	}
+
+	is_releasing = false;
+}
+
+bool graph::reaches(const inotifiable& source_, const inotifiable& target_)
+{
+	vector<const inotifiable*> stack { &source_ };
+	unordered_set<const inotifiable*> visited { &source_ };
+
+	while (!stack.empty())
+	{
+		const inotifiable* ptr_node = stack.back();
+		stack.pop_back();
+
+		if (ptr_node == &target_)
+		{
+			return true;
+		}
+
+		for (auto& t : ptr_node->targets)
+		{
+			auto target = t.lock();
+
+			if (target && visited.insert(target.get()).second)
+			{
+				stack.push_back(target.get());
+			}
+		}
+	}
+
+	return false;
+}
+
+void graph::timer_scope::post(function<void()> fire_, bool is_synchronous_)
+{
+	unique_lock<mutex> lock { _mutex };
+
+	if (!_is_open)
+	{
+		return;
+	}
+
+	if (!is_synchronous_)
+	{
+		_fires.push_back(move(fire_));
+
+		if (!_thread.joinable())
+		{
+			auto ptr_self = shared_from_this();
+
+			_thread = thread { [ptr_self] { ptr_self->_run(); } };
+		}
+
+		_changed.notify_all();
+		return;
+	}
+
+	++_count_of_running;
+
+	lock.unlock();
+
+	try
+	{
+		fire_();
+	}
+	catch (...)
+	{
+		_end_fire();
+		throw;
+	}
+
+	_end_fire();
+}
+
+void graph::timer_scope::close()
+{
+	deque<function<void()>> fires;
+	thread fires_thread;
+
+	{
+		unique_lock<mutex> lock { _mutex };
+
+		_is_open = false;
+
+		fires.swap(_fires);
+		fires_thread = move(_thread);
+
+		_changed.notify_all();
+
+		//	a fire can't wait for itself, if it destroys the context
+		if (fires_thread.get_id() != this_thread::get_id())
+		{
+			_changed.wait(lock, [this] { return _count_of_running == 0; });
+		}
+	}
+
+	if (fires_thread.joinable())
+	{
+		if (fires_thread.get_id() == this_thread::get_id())
+		{
+			fires_thread.detach();
+		}
+		else
+		{
+			fires_thread.join();
+		}
+	}
+}
+
+void graph::timer_scope::_run()
+{
+	unique_lock<mutex> lock { _mutex };
+
+	while (_is_open)
+	{
+		if (_fires.empty())
+		{
+			_changed.wait(lock);
+			continue;
+		}
+
+		auto fire = move(_fires.front());
+		_fires.pop_front();
+
+		++_count_of_running;
+
+		lock.unlock();
+
+		try
+		{
+			fire();
+		}
+		catch (...)
+		{
+			//	the thread is kept alive like the thread of a clock, the fire has to handle its errors
+		}
+
+		//	the node can be released by it without the lock
+		fire = nullptr;
+
+		lock.lock();
+
+		--_count_of_running;
+		_changed.notify_all();
+	}
+}
+
+void graph::timer_scope::_end_fire()
+{
+	lock_guard<mutex> lock { _mutex };
+
+	--_count_of_running;
+	_changed.notify_all();
+}
+
+utility::stats_counter& graph::recompute_counter()
+{
+	static utility::stats_counter counter { "rv.recomputes" };
+	return counter;
+}
+
+utility::stats_counter& graph::value_change_counter()
+{
+	static utility::stats_counter counter { "rv.value_changes" };
+	return counter;
+}
+
+utility::stats_counter& graph::unchanged_value_counter()
+{
+	static utility::stats_counter counter { "rv.unchanged_values" };
+	return counter;
+}
+
+utility::stats_counter& graph::node_counter()
+{
+	static utility::stats_counter counter { "rv.nodes" };
+	return counter;
+}
+
 rv_builder::rv_builder(rv_context& rc_, std::shared_ptr<graph::inotifiable> ptr_op_)
 	: _rc{ rc_ }
 	, _current_operator{ std::move(ptr_op_) }
@@ -33,22 +284,235 @@ rv_builder::rv_builder(rv_context& rc_, std::shared_ptr<graph::inotifiable> ptr_
 class rv_context::rv_context_impl
 {
 public:
-	std::unordered_set<std::shared_ptr<graph::inotifiable>> intermediate_nodes;
+	virtual ~rv_context_impl() = default;
 
 	virtual rv_abstract_debugger& debugger() = 0;
 
 	virtual void reset_debugger(std::unique_ptr<rv_abstract_debugger> debugger_) = 0;
 
 	virtual void submit(std::function<void()> task_) = 0;
-	
+
+	void begin_change();
+	void end_change(graph::inotifiable& node_, bool is_changed_);
+
+	//
+	//	a batch is a change of the calling thread, so its changes are nested into it and the
+	//	outermost one propagates them in one wave. The other threads wait for its end. A batch
+	//	of a running wave is nested into it like a change.
+	//
+	void begin_batch();
+	void end_batch();
+
+	std::recursive_mutex pull_mutex;
+
+	//	a value node of every loop, see rv_context::_hold_loop
+	std::vector<std::weak_ptr<graph::inotifiable>> loops;
+
+protected:
+	typedef std::vector<std::shared_ptr<graph::inotifiable>> level;
+
+	//	recomputes the dirty nodes of the same height, they don't depend on each other
+	virtual void _recompute(level& nodes_) = 0;
+
+private:
+	struct dirty_node
+	{
+		size_t height;
+		std::shared_ptr<graph::inotifiable> ptr_node;
+
+		//	the lowest one is on the top of the queue
+		bool operator<(const dirty_node& other_) const
+		{
+			return height > other_.height;
+		}
+	};
+
+	//	guards the queue, the is_queued flags of the nodes and the owner
+	std::mutex _mutex;
+	std::condition_variable _idle;
+
+	std::priority_queue<dirty_node> _dirty_nodes;
+
+	//
+	//	the thread, which changes the nodes and drains the queue, the other threads wait
+	//	for it in begin_change()
+	//	The changes made by its wave are nested into the change, which has started it.
+	//
+	bool _is_owned = false;
+	std::thread::id _owner;
+	size_t _depth_of_changes = 0;
+	const rv_context_impl* _ptr_previous_context = nullptr;
+
+	void _end(std::unique_lock<std::mutex>& lock_);
+	void _drain(std::unique_lock<std::mutex>& lock_);
+	void _release(std::unique_lock<std::mutex>& lock_);
 };
 
+namespace
+{
+	//	the context, whose wave is evaluated by this thread, its changes join the wave
+	thread_local const rv_context::rv_context_impl* running_context = nullptr;
+
+	class running_scope
+	{
+	public:
+		explicit running_scope(const rv_context::rv_context_impl& rc_)
+			: _ptr_previous { running_context }
+		{
+			running_context = &rc_;
+		}
+
+		~running_scope()
+		{
+			running_context = _ptr_previous;
+		}
+
+	private:
+		const rv_context::rv_context_impl* _ptr_previous;
+	};
+}
+
+void rv_context::rv_context_impl::begin_change()
+{
+	if (running_context == this)
+	{
+		//	the threads of the pool don't own the wave, their changes are simply queued
+		if (this_thread::get_id() == _owner)
+		{
+			++_depth_of_changes;
+		}
+
+		return;
+	}
+
+	unique_lock<mutex> lock { _mutex };
+
+	_idle.wait(lock, [this] { return !_is_owned; });
+
+	_is_owned = true;
+	_owner = this_thread::get_id();
+	_depth_of_changes = 1;
+
+	_ptr_previous_context = running_context;
+	running_context = this;
+}
+
+void rv_context::rv_context_impl::end_change(graph::inotifiable& node_, bool is_changed_)
+{
+	unique_lock<mutex> lock { _mutex };
+
+	for (auto& t : node_.targets)
+	{
+		auto target = is_changed_ ? t.lock() : nullptr;
+
+		if (target && !target->is_queued)
+		{
+			target->is_queued = true;
+			_dirty_nodes.push({ target->height, move(target) });
+		}
+	}
+
+	if (this_thread::get_id() == _owner)
+	{
+		_end(lock);
+	}
+}
+
+void rv_context::rv_context_impl::begin_batch()
+{
+	begin_change();
+}
+
+void rv_context::rv_context_impl::end_batch()
+{
+	unique_lock<mutex> lock { _mutex };
+
+	if (this_thread::get_id() == _owner)
+	{
+		_end(lock);
+	}
+}
+
+void rv_context::rv_context_impl::_end(unique_lock<mutex>& lock_)
+{
+	//	the outermost change drains the queue
+	if (_depth_of_changes > 1)
+	{
+		--_depth_of_changes;
+		return;
+	}
+
+	try
+	{
+		_drain(lock_);
+	}
+	catch (...)
+	{
+		_release(lock_);
+		throw;
+	}
+
+	_release(lock_);
+}
+
+void rv_context::rv_context_impl::_drain(unique_lock<mutex>& lock_)
+{
+	try
+	{
+		level nodes;
+
+		while (!_dirty_nodes.empty())
+		{
+			const size_t height = _dirty_nodes.top().height;
+
+			for (; !_dirty_nodes.empty() && _dirty_nodes.top().height == height; _dirty_nodes.pop())
+			{
+				_dirty_nodes.top().ptr_node->is_queued = false;
+				nodes.push_back(_dirty_nodes.top().ptr_node);
+			}
+
+			lock_.unlock();
+
+			_recompute(nodes);
+			nodes.clear();
+
+			lock_.lock();
+		}
+	}
+	catch (...)
+	{
+		if (!lock_.owns_lock())
+		{
+			lock_.lock();
+		}
+
+		for (; !_dirty_nodes.empty(); _dirty_nodes.pop())
+		{
+			_dirty_nodes.top().ptr_node->is_queued = false;
+		}
+
+		throw;
+	}
+}
+
+void rv_context::rv_context_impl::_release(unique_lock<mutex>&)
+{
+	_is_owned = false;
+	_owner = thread::id { };
+	_depth_of_changes = 0;
+
+	running_context = _ptr_previous_context;
+
+	_idle.notify_all();
+}
+
 class rv_context_impl_multithreaded : public rv_context::rv_context_impl
 {
 public:
-	rv_context_impl_multithreaded()
-		: _thread_pool{ 10 }
-		, _debugger{ make_unique<rv_debugger>() }
+	rv_context_impl_multithreaded(size_t count_of_threads_)
+		: _debugger{ make_unique<rv_debugger>() }
+		, _count_of_threads { count_of_threads_ ? count_of_threads_ : _default_count_of_threads() }
+		, _thread_pool{ static_cast<int>(_count_of_threads) }
 	{
 	}
 
@@ -67,14 +531,98 @@ public:
 		_thread_pool.submit(move(task_));
 	}
 
+protected:
+	//
+	//	the nodes are split into a chunk per thread, the calling thread takes the first one
+	//	The level is done when every chunk is, so the values written by it are visible to
+	//	the next one.
+	//
+	void _recompute(level& nodes_) override
+	{
+		const size_t count_of_chunks = nodes_.size() < _count_of_threads + 1 ? nodes_.size() : _count_of_threads + 1;
+		const size_t chunk_size = (nodes_.size() + count_of_chunks - 1) / count_of_chunks;
+
+		mutex mtx;
+		condition_variable done;
+		size_t remaining = 0;
+		exception_ptr error;
+
+		auto recompute_chunk = [&](size_t begin_, size_t end_)
+		{
+			try
+			{
+				for (size_t i = begin_; i < end_; ++i)
+				{
+					nodes_[i]->invalidate();
+				}
+			}
+			catch (...)
+			{
+				lock_guard<mutex> lock { mtx };
+
+				if (!error)
+				{
+					error = current_exception();
+				}
+			}
+		};
+
+		for (size_t begin = chunk_size; begin < nodes_.size(); begin += chunk_size)
+		{
+			const size_t end = begin + chunk_size < nodes_.size() ? begin + chunk_size : nodes_.size();
+
+			{
+				lock_guard<mutex> lock { mtx };
+				++remaining;
+			}
+
+			_thread_pool.submit([&, begin, end]
+			{
+				{
+					running_scope running { *this };
+
+					recompute_chunk(begin, end);
+				}
+
+				lock_guard<mutex> lock { mtx };
+
+				if (--remaining == 0)
+				{
+					done.notify_one();
+				}
+			});
+		}
+
+		recompute_chunk(0, chunk_size < nodes_.size() ? chunk_size : nodes_.size());
+
+		{
+			unique_lock<mutex> lock { mtx };
+			done.wait(lock, [&] { return remaining == 0; });
+		}
+
+		if (error)
+		{
+			rethrow_exception(error);
+		}
+	}
+
 private:
 	//	1st - allocation 
 	//	2nd - deallocation - make sure no other thread keep locked its mutex
 	std::unique_ptr<rv_abstract_debugger> _debugger;
 
+	size_t _count_of_threads;
+
 	//	2nd - allocation
 	//	1st - deallocation - terminate running threads
 	utility::thread_pool _thread_pool;
+
+	static size_t _default_count_of_threads()
+	{
+		const size_t count = thread::hardware_concurrency();
+
+		return count > 1 ? count - 1 : 1;
+	}
 };
 
 class rv_context_impl_unittest : public rv_context::rv_context_impl
@@ -93,6 +641,16 @@ public:
 	{
 		task_();
 	}
+
+protected:
+	void _recompute(level& nodes_) override
+	{
+		for (auto& ptr_node : nodes_)
+		{
+			ptr_node->invalidate();
+		}
+	}
+
 private:
 	rv_debugger _debugger;
 };
@@ -101,12 +659,29 @@ private:
 
 
 
-rv_context::rv_context() : _impl { make_unique<rv_context_impl_unittest>() }
+rv_context::rv_context(E_EXECUTION_POLICY policy_, size_t count_of_threads_)
 {
+	if (policy_ == EXECUTION_POLICY_PARALLEL)
+	{
+		_impl = make_unique<rv_context_impl_multithreaded>(count_of_threads_);
+	}
+	else
+	{
+		_impl = make_unique<rv_context_impl_unittest>();
+	}
 }
 
 rv_context::~rv_context()
 {
+	_ptr_timer_scope->close();
+
+	for (auto& loop : _impl->loops)
+	{
+		if (auto ptr_node = loop.lock())
+		{
+			ptr_node->detach_source();
+		}
+	}
 }
 
 rv_abstract_debugger& rv_context::debugger()
@@ -124,12 +699,101 @@ void rv_context::submit(std::function<void()> task_)
 	_impl->submit(move(task_));
 }
 
+void rv_context::begin_change()
+{
+	_impl->begin_change();
+}
+
+void rv_context::end_change(graph::inotifiable& node_, bool is_changed_)
+{
+	_impl->end_change(node_, is_changed_);
+}
+
+
+void rv_context::_hold_loop(std::weak_ptr<graph::inotifiable> ptr_node_)
+{
+	_impl->loops.push_back(move(ptr_node_));
+}
+
+void rv_context::begin_pull()
+{
+	_impl->pull_mutex.lock();
+}
 
-void rv_context::_hold_this_internal_nodes(std::shared_ptr<graph::inotifiable> ptr_)
+void rv_context::end_pull()
 {
-	_impl->intermediate_nodes.insert(std::move(ptr_));
+	_impl->pull_mutex.unlock();
 }
 
+void rv_context::set_evaluation(E_EVALUATION evaluation_)
+{
+	_evaluation = evaluation_;
+}
+
+E_EVALUATION rv_context::evaluation() const
+{
+	return _evaluation;
+}
+
+void rv_context::set_clock(shared_ptr<rv_clock> ptr_clock_)
+{
+	_ptr_clock = move(ptr_clock_);
+}
+
+shared_ptr<rv_clock> rv_context::clock()
+{
+	if (!_ptr_clock)
+	{
+		_ptr_clock = rv_steady_clock::shared();
+	}
+
+	return _ptr_clock;
+}
+
+void rv_context::_begin_batch()
+{
+	_impl->begin_batch();
+}
+
+void rv_context::_end_batch()
+{
+	_impl->end_batch();
+}
+
+rv_transaction::rv_transaction(rv_context& rc_)
+	: _rc { rc_ }
+{
+	_rc._begin_batch();
+}
+
+rv_transaction::~rv_transaction()
+{
+	if (!_is_committed)
+	{
+		try
+		{
+			commit();
+		}
+		catch (...)
+		{
+			//	the values are set already, only the failed recomputation is lost
+		}
+	}
+}
+
+void rv_transaction::commit()
+{
+	if (_is_committed)
+	{
+		return;
+	}
+
+	_is_committed = true;
+
+	_rc._end_batch();
+}
+
+
 
 void function_one()
 {
@@ -9,11 +9,15 @@ using namespace std;
 
 void rv_abstract_debugger::set_name(void* ptr_urv_, string rv_name_)
 {
+	lock_guard<mutex> lock { _mtx_names };
+
 	_urv_to_name.insert({ ptr_urv_, move(rv_name_) });
 }
 
 string rv_abstract_debugger::name_of(void* ptr_, type_index ti_)
 {
+	lock_guard<mutex> lock { _mtx_names };
+
 	auto it = _urv_to_name.find(ptr_);
 
 	if (it == _urv_to_name.end())
@@ -103,6 +103,8 @@ namespace reactive_framework8
 		std::string name_of(void* ptr_, std::type_index ti_);
 		
 	private:
+		//	the nodes are notified by the threads of the context in parallel
+		std::mutex _mtx_names;
 		std::unordered_map<void*, std::string> _urv_to_name;
 
 		std::string generate_name(void* ptr_, std::type_index ti_);
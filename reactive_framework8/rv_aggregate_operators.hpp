@@ -0,0 +1,352 @@
+#pragma once
+#include "stdafx.h"
+
+#include "rv_clock.hpp"
+#include "rv_graph.hpp"
+#include "rv_time_operators.hpp"
+
+#include <deque>
+#include <functional>
+
+namespace reactive_framework8
+{
+	//
+	//	the values of a rolling aggregate: the last count values, the values within the last
+	//	duration or both, see rv_builder::rolling_sum
+	//
+	//		rc.rolling_max(100, a);
+	//		rc.rolling_mean(std::chrono::seconds { 1 }, a);
+	//
+	struct rv_window
+	{
+		rv_window(size_t count_)
+			: count { count_ }
+		{
+		}
+
+		template<class Rep, class Period> rv_window(std::chrono::duration<Rep, Period> duration_)
+			: duration { std::chrono::duration_cast<rv_clock::duration>(duration_) }
+		{
+		}
+
+		rv_window(size_t count_, rv_clock::duration duration_)
+			: count { count_ }
+			, duration { duration_ }
+		{
+		}
+
+		//	0: unlimited
+		size_t count = 0;
+		rv_clock::duration duration = rv_clock::duration::zero();
+	};
+
+	namespace graph
+	{
+		//
+		//	the accumulation of the changes of the source by func(accumulator, value), the
+		//	accumulator is kept by the node. Only the changes are accumulated, an unchanged
+		//	value of the source isn't propagated to it. Every change of a batch is accumulated
+		//	in order, see change_reader.
+		//	is_seeded: it starts from a seed, otherwise from the first value (R is T then)
+		//
+		template<class T, class R, class F, bool is_seeded> class scan_operator_node : public node<R>
+		{
+		public:
+			scan_operator_node(F func_, boost::optional<R> seed_, std::shared_ptr<node<T>> ptr_source_)
+				: _func { std::move(func_) }
+				, _accumulator { std::move(seed_) }
+				, _ptr_source { std::move(ptr_source_) }
+				, _changes { *_ptr_source }
+			{
+			}
+
+			~scan_operator_node()
+			{
+				release_source(std::move(_ptr_source));
+			}
+
+		private:
+			mutable F _func;
+			mutable boost::optional<R> _accumulator;
+			std::shared_ptr<node<T>> _ptr_source;
+			mutable change_reader<T> _changes;
+
+			boost::optional<R> _re_calc() const override
+			{
+				const auto values = _changes.read(*_ptr_source);
+
+				if (values.empty())
+				{
+					return { };
+				}
+
+				for (const auto& value : values)
+				{
+					_accumulate(value, std::integral_constant<bool, is_seeded> { });
+				}
+
+				return _accumulator;
+			}
+
+			void _accumulate(const T& value_, std::true_type) const
+			{
+				_accumulator = _func(std::move(*_accumulator), value_);
+			}
+
+			void _accumulate(const T& value_, std::false_type) const
+			{
+				if (_accumulator)
+				{
+					_accumulator = _func(std::move(*_accumulator), value_);
+				}
+				else
+				{
+					_accumulator = value_;
+				}
+			}
+		};
+
+		//
+		//	the aggregates of a rolling window, see rolling_operator_node: a value is added
+		//	when it enters the window, and removed when it's the oldest one leaving it, both
+		//	of them in O(1) amortized
+		//	value() is empty if the aggregate of an empty window is undefined
+		//
+		template<class T> class rolling_sum
+		{
+		public:
+			typedef T value_type;
+			typedef T result_type;
+
+			void add(const T& value_)
+			{
+				_sum += value_;
+			}
+
+			void remove(const T& value_)
+			{
+				_sum -= value_;
+			}
+
+			boost::optional<T> value() const
+			{
+				return _sum;
+			}
+
+		private:
+			T _sum { };
+		};
+
+		template<class T> class rolling_mean
+		{
+		public:
+			typedef T value_type;
+			typedef double result_type;
+
+			void add(const T& value_)
+			{
+				_sum += value_;
+				++_count;
+			}
+
+			void remove(const T& value_)
+			{
+				_sum -= value_;
+				--_count;
+			}
+
+			boost::optional<double> value() const
+			{
+				if (_count == 0)
+				{
+					return { };
+				}
+
+				return static_cast<double>(_sum) / _count;
+			}
+
+		private:
+			T _sum { };
+			size_t _count = 0;
+		};
+
+		//	the population variance by Welford's algorithm, which is reverted by a removal
+		template<class T> class rolling_variance
+		{
+		public:
+			typedef T value_type;
+			typedef double result_type;
+
+			void add(const T& value_)
+			{
+				const double value = static_cast<double>(value_);
+				const double delta = value - _mean;
+
+				++_count;
+				_mean += delta / _count;
+				_m2 += delta * (value - _mean);
+			}
+
+			void remove(const T& value_)
+			{
+				if (--_count == 0)
+				{
+					_mean = 0;
+					_m2 = 0;
+					return;
+				}
+
+				const double value = static_cast<double>(value_);
+				const double delta = value - _mean;
+
+				_mean -= delta / _count;
+				_m2 -= delta * (value - _mean);
+			}
+
+			boost::optional<double> value() const
+			{
+				if (_count == 0)
+				{
+					return { };
+				}
+
+				//	the rounding can make it slightly negative
+				return _m2 > 0 ? _m2 / _count : 0.0;
+			}
+
+		private:
+			size_t _count = 0;
+			double _mean = 0;
+			double _m2 = 0;
+		};
+
+		//
+		//	the extreme of the window by a monotonic deque: a value is dropped by a newer one,
+		//	which isn't less extreme, as it leaves the window later. The front is the extreme.
+		//	C: std::less for the minimum, std::greater for the maximum
+		//
+		template<class T, class C> class rolling_extreme
+		{
+		public:
+			typedef T value_type;
+			typedef T result_type;
+
+			void add(const T& value_)
+			{
+				while (!_candidates.empty() && !_before(_candidates.back().second, value_))
+				{
+					_candidates.pop_back();
+				}
+
+				_candidates.emplace_back(_added++, value_);
+			}
+
+			void remove(const T&)
+			{
+				if (!_candidates.empty() && _candidates.front().first == _removed)
+				{
+					_candidates.pop_front();
+				}
+
+				++_removed;
+			}
+
+			boost::optional<T> value() const
+			{
+				if (_candidates.empty())
+				{
+					return { };
+				}
+
+				return _candidates.front().second;
+			}
+
+		private:
+			C _before;
+
+			//	(the index of the value in the window, value)
+			std::deque<std::pair<size_t, T>> _candidates;
+			size_t _added = 0;
+			size_t _removed = 0;
+		};
+
+		template<class T> using rolling_min = rolling_extreme<T, std::less<T>>;
+		template<class T> using rolling_max = rolling_extreme<T, std::greater<T>>;
+
+		//
+		//	an aggregate A of the rolling window of the source, the values of the window are
+		//	kept by the node. The values of a time window expire by the timers of the clock,
+		//	the clock is nullptr if the window is counted only. The value of an undefined
+		//	aggregate, e.g. the mean of an expired window, is left as it was.
+		//	Every change of a batch enters the window, see timed_operator_node.
+		//
+		template<class A> class rolling_operator_node : public timed_operator_node<typename A::value_type, typename A::result_type>
+		{
+		public:
+			typedef typename A::value_type T;
+			typedef typename A::result_type R;
+
+			rolling_operator_node(std::shared_ptr<rv_clock> ptr_clock_, std::shared_ptr<timer_scope> ptr_scope_
+				, std::shared_ptr<node<T>> ptr_source_, rv_window window_)
+				: timed_operator_node<T, R>(std::move(ptr_clock_), std::move(ptr_scope_), std::move(ptr_source_))
+				, _window { window_ }
+			{
+				if (_window.count == 0 && _window.duration <= rv_clock::duration::zero())
+				{
+					throw std::invalid_argument { "rolling window without a count or a duration" };
+				}
+			}
+
+		private:
+			rv_window _window;
+			A _aggregate;
+
+			//	(the time of the change, value) in the order of the changes
+			std::deque<std::pair<rv_clock::time_point, T>> _values;
+
+			boost::optional<R> _on_change(const T& value_) override
+			{
+				const auto now = this->_ptr_clock ? this->_ptr_clock->now() : rv_clock::time_point { };
+
+				_values.emplace_back(now, value_);
+				_aggregate.add(value_);
+
+				if (_window.count != 0 && _values.size() > _window.count)
+				{
+					_pop();
+				}
+
+				return _expire(now);
+			}
+
+			boost::optional<R> _on_timer() override
+			{
+				return _expire(this->_ptr_clock->now());
+			}
+
+			boost::optional<R> _expire(rv_clock::time_point now_)
+			{
+				if (this->_ptr_clock)
+				{
+					while (!_values.empty() && _values.front().first + _window.duration <= now_)
+					{
+						_pop();
+					}
+
+					if (!_values.empty() && !this->_is_scheduled())
+					{
+						this->_schedule(_values.front().first + _window.duration);
+					}
+				}
+
+				return _aggregate.value();
+			}
+
+			void _pop()
+			{
+				_aggregate.remove(_values.front().second);
+				_values.pop_front();
+			}
+		};
+	}
+}
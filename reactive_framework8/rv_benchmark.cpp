@@ -0,0 +1,944 @@
+#include "stdafx.h"
+#include "rv_benchmark.hpp"
+#include "rv"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <thread>
+
+using namespace reactive_framework8;
+using namespace std;
+
+namespace
+{
+	//
+	//	every rv is an operator node and a value node, so a glitch-free change of the
+	//	source recomputes 2 nodes per rv and notifies the sink once
+	//
+	struct result_row
+	{
+		string suite;
+		string shape;
+		size_t rvs = 0;
+		size_t changes = 0;
+		double recomputes_per_change = 0;
+		double notifications_per_change = 0;
+
+		//	notifications of the sink with a value, which doesn't follow the source
+		size_t inconsistent = 0;
+
+		double us_per_change = 0;
+
+		//	snapshot reads of the other threads while propagating
+		double reads_per_s = 0;
+	};
+
+	//	trivially copyable, so its snapshots are published by the seqlock
+	struct reading
+	{
+		int n;
+		int twice;
+		double half;
+	};
+
+	ostream& operator<<(ostream& os_, const reading& r_)
+	{
+		return os_ << r_.n;
+	}
+
+	//	the rv_debugger of the context prints every change, it's muted while measuring
+	class muted_output
+	{
+	public:
+		muted_output()
+			: _ptr_saved { cout.rdbuf(nullptr) }
+		{
+		}
+
+		~muted_output()
+		{
+			cout.rdbuf(_ptr_saved);
+		}
+
+	private:
+		streambuf* _ptr_saved;
+	};
+
+	//	the source is set to 1..changes_, the sink has to be expected_(source) after each
+	result_row measure(string shape_, size_t rvs_, rv<int>& source_, rv<int>& sink_, function<int(int)> expected_, size_t changes_)
+	{
+		result_row row;
+		row.suite = "propagation";
+		row.shape = move(shape_);
+		row.rvs = rvs_;
+		row.changes = changes_;
+
+		size_t notifications = 0;
+		int current = 0;
+
+		sink_.subscribe([&](int n_)
+		{
+			++notifications;
+
+			if (n_ != expected_(current))
+			{
+				++row.inconsistent;
+			}
+		});
+
+		const auto recomputes = graph::recompute_counter().value();
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 1; i <= changes_; ++i)
+		{
+			current = static_cast<int>(i);
+			source_ << current;
+		}
+
+		const auto elapsed = chrono::duration<double, micro> { chrono::steady_clock::now() - start }.count();
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / changes_;
+		row.notifications_per_change = static_cast<double>(notifications) / changes_;
+		row.us_per_change = elapsed / changes_;
+
+		return row;
+	}
+
+	//	a balanced tree of sums over the rvs, the count of its rvs is added to rvs_
+	rv<int> sum_of(rv_context& rc_, vector<rv<int>> level_, size_t& rvs_)
+	{
+		while (level_.size() > 1)
+		{
+			vector<rv<int>> next;
+			next.reserve((level_.size() + 1) / 2);
+
+			for (size_t i = 0; i + 1 < level_.size(); i += 2)
+			{
+				next.emplace_back(rc_.map([](int a_, int b_) { return a_ + b_; }, level_[i], level_[i + 1]));
+			}
+
+			if (level_.size() % 2)
+			{
+				next.push_back(move(level_.back()));
+			}
+
+			rvs_ += level_.size() / 2;
+			level_ = move(next);
+		}
+
+		return move(level_.front());
+	}
+
+	//
+	//	source -> width_ maps -> a balanced tree of sums -> sink
+	//	the maps divide the source by divisor_, so they only change in every divisor_th change
+	//
+	result_row wide_diamond(size_t width_, size_t changes_, int divisor_ = 1)
+	{
+		muted_output muted;
+
+		rv_context rc;
+		rv<int> source { 0 };
+
+		vector<rv<int>> level;
+		level.reserve(width_);
+
+		for (size_t i = 0; i < width_; ++i)
+		{
+			const int offset = static_cast<int>(i);
+
+			level.emplace_back(rc.map([=](int n_) { return n_ / divisor_ + offset; }, source));
+		}
+
+		size_t rvs = width_;
+		rv<int> sink = sum_of(rc, move(level), rvs);
+
+		const int width = static_cast<int>(width_);
+		const int sum_of_offsets = width * (width - 1) / 2;
+
+		stringstream sb;
+		sb << "diamond " << width_;
+
+		if (divisor_ > 1)
+		{
+			sb << " / " << divisor_;
+		}
+
+		auto row = measure(sb.str(), rvs, source, sink, [=](int n_) { return width * (n_ / divisor_) + sum_of_offsets; }, changes_);
+
+		return row;
+	}
+
+	//
+	//	inputs_ sources -> a map each -> a balanced tree of sums -> sink, every source is
+	//	written in each tick, one by one or by an rv_context::batch
+	//
+	result_row ingestion(size_t inputs_, bool batched_, size_t ticks_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+
+		vector<rv<int>> sources;
+		vector<rv<int>> level;
+		sources.reserve(inputs_);
+		level.reserve(inputs_);
+
+		for (size_t i = 0; i < inputs_; ++i)
+		{
+			sources.emplace_back(0);
+			level.emplace_back(rc.map([](int n_) { return n_ * 2; }, sources.back()));
+		}
+
+		size_t rvs = inputs_ * 2;
+		rv<int> sink = sum_of(rc, move(level), rvs);
+
+		result_row row;
+		row.suite = "batch";
+		row.rvs = rvs;
+		row.changes = ticks_;
+
+		stringstream sb;
+		sb << inputs_ << " inputs " << (batched_ ? "batched" : "one by one");
+		row.shape = sb.str();
+
+		size_t notifications = 0;
+		int current = 0;
+
+		sink.subscribe([&](int n_)
+		{
+			++notifications;
+
+			if (n_ != 2 * current * static_cast<int>(inputs_))
+			{
+				++row.inconsistent;
+			}
+		});
+
+		auto write_all = [&]
+		{
+			for (auto& source : sources)
+			{
+				source << current;
+			}
+		};
+
+		const auto recomputes = graph::recompute_counter().value();
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 1; i <= ticks_; ++i)
+		{
+			current = static_cast<int>(i);
+
+			if (batched_)
+			{
+				rc.batch(write_all);
+			}
+			else
+			{
+				write_all();
+			}
+		}
+
+		const auto elapsed = chrono::duration<double, micro> { chrono::steady_clock::now() - start }.count();
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / ticks_;
+		row.notifications_per_change = static_cast<double>(notifications) / ticks_;
+		row.us_per_change = elapsed / ticks_;
+
+		return row;
+	}
+
+	//	a recomputation, which takes about work_ iterations, the result is the average
+	int average(int a_, int b_, size_t work_)
+	{
+		volatile unsigned sink = 0;
+
+		for (size_t i = 0; i < work_; ++i)
+		{
+			sink = sink * 31 + static_cast<unsigned>(i);
+		}
+
+		return (a_ + b_) / 2;
+	}
+
+	//
+	//	source -> width_ maps -> depth_ layers, each rv averages two neighbours of the
+	//	previous layer -> the first rv of the last layer is the sink
+	//
+	result_row deep_lattice(size_t width_, size_t depth_, size_t changes_, E_EXECUTION_POLICY policy_ = EXECUTION_POLICY_SEQUENTIAL, size_t work_ = 0)
+	{
+		muted_output muted;
+
+		rv_context rc { policy_ };
+		rv<int> source { 0 };
+
+		vector<rv<int>> layer;
+		layer.reserve(width_);
+
+		for (size_t i = 0; i < width_; ++i)
+		{
+			layer.emplace_back(rc.map([](int n_) { return n_; }, source));
+		}
+
+		for (size_t d = 0; d < depth_; ++d)
+		{
+			vector<rv<int>> next;
+			next.reserve(width_);
+
+			for (size_t i = 0; i < width_; ++i)
+			{
+				next.emplace_back(rc.map([=](int a_, int b_) { return average(a_, b_, work_); }, layer[i], layer[(i + 1) % width_]));
+			}
+
+			layer = move(next);
+		}
+
+		stringstream sb;
+		sb << "lattice " << width_ << "x" << depth_;
+
+		if (work_)
+		{
+			sb << (policy_ == EXECUTION_POLICY_PARALLEL ? " parallel" : " sequential");
+		}
+
+		auto row = measure(sb.str(), width_ * (depth_ + 1), source, layer.front(), [](int n_) { return n_; }, changes_);
+
+		if (work_)
+		{
+			row.suite = "parallel";
+		}
+
+		return row;
+	}
+
+	//
+	//	source -> 16 maps -> a balanced tree of sums, the readers_ threads read the snapshot of
+	//	a map by the seqlock or of a string by the pointer swap while the source is changed,
+	//	inconsistent is the count of the torn reads
+	//
+	result_row snapshot_reads(size_t readers_, bool seqlock_, size_t changes_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+		rv<int> source { 0 };
+
+		vector<rv<int>> level;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			level.emplace_back(rc.map([=](int n_) { return n_ + i; }, source));
+		}
+
+		size_t rvs = 16 + 2;
+		rv<int> sink = sum_of(rc, move(level), rvs);
+
+		rv<reading> numbers = rc.map([](int n_) { return reading { n_, n_ * 2, n_ / 2.0 }; }, source);
+		rv<string> text = rc.map([](int n_) { return string(static_cast<size_t>(16 + n_ % 48), static_cast<char>('a' + n_ % 26)); }, source);
+
+		result_row row;
+		row.suite = "snapshot";
+		row.rvs = rvs;
+		row.changes = changes_;
+
+		stringstream sb;
+		sb << readers_ << " readers " << (seqlock_ ? "seqlock" : "pointer swap");
+		row.shape = sb.str();
+
+		atomic<bool> is_done { false };
+		atomic<size_t> reads { 0 };
+		atomic<size_t> torn_reads { 0 };
+
+		vector<thread> readers;
+
+		for (size_t i = 0; i < readers_; ++i)
+		{
+			readers.emplace_back([&]
+			{
+				size_t count = 0;
+				size_t torn = 0;
+
+				while (!is_done.load(memory_order_relaxed))
+				{
+					if (seqlock_)
+					{
+						const auto r = numbers.snapshot();
+
+						torn += r && (r->twice != r->n * 2 || r->half != r->n / 2.0);
+					}
+					else
+					{
+						const auto t = text.snapshot();
+
+						torn += t && t->find_first_not_of(t->front()) != string::npos;
+					}
+
+					++count;
+				}
+
+				reads += count;
+				torn_reads += torn;
+			});
+		}
+
+		const auto recomputes = graph::recompute_counter().value();
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 1; i <= changes_; ++i)
+		{
+			source << static_cast<int>(i);
+		}
+
+		const auto elapsed = chrono::duration<double, micro> { chrono::steady_clock::now() - start }.count();
+
+		is_done = true;
+
+		for (auto& t : readers)
+		{
+			t.join();
+		}
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / changes_;
+		row.notifications_per_change = 1;
+		row.inconsistent = torn_reads;
+		row.us_per_change = elapsed / changes_;
+		row.reads_per_s = reads * 1e6 / elapsed;
+
+		return row;
+	}
+
+	//
+	//	source -> filter -> 4 maps -> sink, by an rv per stage or by one fused chain, see
+	//	rv_chain
+	//
+	result_row chain(bool fused_, size_t changes_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+		rv<int> source { 0 };
+
+		auto is_positive = [](int n_) { return n_ > 0; };
+		auto inc = [](int n_) { return n_ + 1; };
+
+		rv<int> sink;
+
+		if (fused_)
+		{
+			sink = rc.from(source).filter(is_positive).map(inc).map(inc).map(inc).map(inc).as();
+		}
+		else
+		{
+			rv<int> filtered = rc.filter(is_positive, source);
+			rv<int> a = rc.map(inc, filtered);
+			rv<int> b = rc.map(inc, a);
+			rv<int> c = rc.map(inc, b);
+
+			sink = rc.map(inc, c);
+		}
+
+		auto row = measure(fused_ ? "5 stages fused" : "5 stages", fused_ ? 1 : 5, source, sink, [](int n_) { return n_ + 4; }, changes_);
+		row.suite = "fusion";
+
+		return row;
+	}
+
+	//
+	//	source -> width_ maps of two inputs, the inputs are strings of 64 characters, which
+	//	are copied by the std::function maps and passed by reference to the direct ones,
+	//	see graph::direct_map_operator_node
+	//
+	result_row map_recompute(size_t width_, bool erased_, size_t changes_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+		rv<string> source { string(64, 'a') };
+		rv<string> other { string(64, 'b') };
+
+		vector<rv<size_t>> maps;
+		maps.reserve(width_);
+
+		for (size_t i = 0; i < width_; ++i)
+		{
+			if (erased_)
+			{
+				maps.emplace_back(rc.map(function<size_t(string, string)> { [=](string a_, string b_) { return a_.size() + b_.size() + i; } }, source, other));
+			}
+			else
+			{
+				maps.emplace_back(rc.map([=](const string& a_, const string& b_) { return a_.size() + b_.size() + i; }, source, other));
+			}
+		}
+
+		result_row row;
+		row.suite = "operator";
+		row.rvs = width_;
+		row.changes = changes_;
+
+		stringstream sb;
+		sb << width_ << " maps " << (erased_ ? "std::function" : "direct");
+		row.shape = sb.str();
+
+		maps.back().subscribe([&](size_t n_)
+		{
+			++row.notifications_per_change;
+
+			if (n_ != source.value()->size() + 64 + width_ - 1)
+			{
+				++row.inconsistent;
+			}
+		});
+
+		const auto recomputes = graph::recompute_counter().value();
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 1; i <= changes_; ++i)
+		{
+			source << string(64 + i % 2, 'a');
+		}
+
+		const auto elapsed = chrono::duration<double, micro> { chrono::steady_clock::now() - start }.count();
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / changes_;
+		row.notifications_per_change /= changes_;
+		row.us_per_change = elapsed / changes_;
+
+		return row;
+	}
+
+	//
+	//	source -> width_ maps -> a balanced tree of sums -> sink, a reporting subgraph, which
+	//	is only read after the last change, by the eager or the lazy evaluation
+	//
+	result_row reporting(size_t width_, E_EVALUATION evaluation_, size_t changes_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+		rv<int> source { 0 };
+
+		rc.set_evaluation(evaluation_);
+
+		vector<rv<int>> level;
+		level.reserve(width_);
+
+		for (size_t i = 0; i < width_; ++i)
+		{
+			const int offset = static_cast<int>(i);
+
+			level.emplace_back(rc.map([=](int n_) { return n_ + offset; }, source));
+		}
+
+		size_t rvs = width_;
+		rv<int> sink = sum_of(rc, move(level), rvs);
+
+		result_row row;
+		row.suite = "lazy";
+		row.rvs = rvs;
+		row.changes = changes_;
+
+		stringstream sb;
+		sb << "report " << width_ << (evaluation_ == EVALUATION_LAZY ? " lazy" : " eager");
+		row.shape = sb.str();
+
+		const auto recomputes = graph::recompute_counter().value();
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 1; i <= changes_; ++i)
+		{
+			source << static_cast<int>(i);
+		}
+
+		const int width = static_cast<int>(width_);
+
+		if (*sink.value() != width * static_cast<int>(changes_) + width * (width - 1) / 2)
+		{
+			++row.inconsistent;
+		}
+
+		const auto elapsed = chrono::duration<double, micro> { chrono::steady_clock::now() - start }.count();
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / changes_;
+		row.notifications_per_change = 0;
+		row.us_per_change = elapsed / changes_;
+
+		return row;
+	}
+
+	//
+	//	the maximum of the last window_ values of the source, by the monotonic deque of
+	//	rv_builder::rolling_max or by a map recomputing it over a copy of the history
+	//
+	result_row rolling(size_t window_, bool incremental_, size_t changes_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+		rv<int> source { 0 };
+
+		rv<int> sink;
+
+		if (incremental_)
+		{
+			sink = rc.rolling_max(window_, source);
+		}
+		else
+		{
+			sink = rc.map([window_, history = deque<int> { }](int n_) mutable
+			{
+				history.push_back(n_);
+
+				if (history.size() > window_)
+				{
+					history.pop_front();
+				}
+
+				const vector<int> values { history.begin(), history.end() };
+
+				return *max_element(values.begin(), values.end());
+			}, source);
+		}
+
+		stringstream sb;
+		sb << "max of " << window_ << (incremental_ ? " rolling" : " recomputed");
+
+		//	the same pseudo random changes for both
+		minstd_rand random;
+		uniform_int_distribution<int> values { 0, 1000000 };
+
+		deque<int> window { 0 };
+		size_t notifications = 0;
+		size_t inconsistent = 0;
+
+		sink.subscribe([&](int n_)
+		{
+			++notifications;
+
+			if (n_ != *max_element(window.begin(), window.end()))
+			{
+				++inconsistent;
+			}
+		});
+
+		result_row row;
+		row.suite = "rolling";
+		row.shape = sb.str();
+		row.rvs = 1;
+		row.changes = changes_;
+
+		const auto recomputes = graph::recompute_counter().value();
+		auto elapsed = chrono::steady_clock::duration::zero();
+
+		for (size_t i = 1; i <= changes_; ++i)
+		{
+			const int value = values(random);
+
+			window.push_back(value);
+
+			if (window.size() > window_)
+			{
+				window.pop_front();
+			}
+
+			const auto start = chrono::steady_clock::now();
+
+			source << value;
+
+			elapsed += chrono::steady_clock::now() - start;
+		}
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / changes_;
+		row.notifications_per_change = static_cast<double>(notifications) / changes_;
+		row.inconsistent = inconsistent;
+		row.us_per_change = chrono::duration<double, micro> { elapsed }.count() / changes_;
+
+		return row;
+	}
+
+	//
+	//	a collection of size_ items -> the squares -> the odd ones -> their count, one item
+	//	appended and one updated per change, by maps over an rv<vector<int>> or by the
+	//	collection operators over an rv_collection, see rv_builder::map_each
+	//
+	result_row collection(size_t size_, bool delta_, size_t changes_)
+	{
+		muted_output muted;
+
+		rv_context rc;
+
+		auto square = [](int n_) { return n_ * n_; };
+		auto is_odd = [](int n_) { return n_ % 2 != 0; };
+
+		vector<int> items(size_);
+		iota(items.begin(), items.end(), 0);
+
+		stringstream sb;
+		sb << size_ << " items " << (delta_ ? "delta" : "vector");
+
+		result_row row;
+		row.suite = "collection";
+		row.shape = sb.str();
+		row.rvs = 3;
+		row.changes = changes_;
+
+		//	the odd squares of 0..size_ + i, the updated items are odd before and after
+		const auto expected = [&](size_t i_) { return (size_ + i_) / 2; };
+
+		const auto recomputes = graph::recompute_counter().value();
+		auto elapsed = chrono::steady_clock::duration::zero();
+
+		if (delta_)
+		{
+			rv<rv_collection<int>> source = rv_collection<int> { items };
+			rv<rv_collection<int>> squares = rc.map_each(square, source);
+			rv<rv_collection<int>> odd = rc.filter_each(is_odd, squares);
+			rv<size_t> count = rc.count(odd);
+
+			for (size_t i = 1; i <= changes_; ++i)
+			{
+				const auto start = chrono::steady_clock::now();
+
+				auto list = get(source.value());
+				list.push_back(static_cast<int>(size_ + i - 1));
+				list.update(1, static_cast<int>(i * 2 + 1));
+				source = list;
+
+				elapsed += chrono::steady_clock::now() - start;
+
+				row.inconsistent += *count.value() != expected(i) ? 1 : 0;
+			}
+		}
+		else
+		{
+			rv<vector<int>> source = items;
+
+			rv<vector<int>> squares = rc.map([=](const vector<int>& items_)
+			{
+				vector<int> result;
+				result.reserve(items_.size());
+				transform(items_.begin(), items_.end(), back_inserter(result), square);
+				return result;
+			}, source);
+
+			rv<vector<int>> odd = rc.map([=](const vector<int>& items_)
+			{
+				vector<int> result;
+				copy_if(items_.begin(), items_.end(), back_inserter(result), is_odd);
+				return result;
+			}, squares);
+
+			rv<size_t> count = rc.map([](const vector<int>& items_) { return items_.size(); }, odd);
+
+			for (size_t i = 1; i <= changes_; ++i)
+			{
+				const auto start = chrono::steady_clock::now();
+
+				items.push_back(static_cast<int>(size_ + i - 1));
+				items[1] = static_cast<int>(i * 2 + 1);
+				source = items;
+
+				elapsed += chrono::steady_clock::now() - start;
+
+				row.inconsistent += *count.value() != expected(i) ? 1 : 0;
+			}
+		}
+
+		row.recomputes_per_change = static_cast<double>(graph::recompute_counter().value() - recomputes) / changes_;
+		row.us_per_change = chrono::duration<double, micro> { elapsed }.count() / changes_;
+
+		return row;
+	}
+
+	vector<string> split(const string& list_)
+	{
+		vector<string> items;
+
+		istringstream is { list_ };
+
+		for (string item; getline(is, item, ',');)
+		{
+			if (!item.empty())
+			{
+				items.push_back(item);
+			}
+		}
+
+		return items;
+	}
+
+	void print_table(const vector<result_row>& rows_)
+	{
+		cout << left << setw(14) << "suite" << setw(28) << "shape"
+			<< right << setw(10) << "rvs" << setw(10) << "changes" << setw(16) << "recomputes/chg"
+			<< setw(16) << "notified/chg" << setw(14) << "inconsistent" << setw(12) << "us/chg" << setw(14) << "reads/s" << endl;
+
+		for (auto& row : rows_)
+		{
+			cout << left << setw(14) << row.suite << setw(28) << row.shape
+				<< right << setw(10) << row.rvs << setw(10) << row.changes
+				<< fixed << setprecision(1) << setw(16) << row.recomputes_per_change
+				<< setprecision(2) << setw(16) << row.notifications_per_change
+				<< setw(14) << row.inconsistent
+				<< setprecision(1) << setw(12) << row.us_per_change
+				<< setprecision(0) << setw(14);
+
+			if (row.reads_per_s > 0)
+			{
+				cout << row.reads_per_s << endl;
+			}
+			else
+			{
+				cout << "-" << endl;
+			}
+		}
+	}
+}
+
+int reactive_framework8::run_benchmark(const vector<string>& args_)
+{
+	vector<string> suites { "all" };
+	size_t changes = 100;
+
+	try
+	{
+		for (size_t i = 0; i < args_.size(); ++i)
+		{
+			const string& option = args_[i];
+
+			if (i + 1 == args_.size())
+			{
+				throw invalid_argument { "missing value of " + option };
+			}
+
+			const string& value = args_[++i];
+
+			if (option == "--suites") suites = split(value);
+			else if (option == "--changes") changes = stoul(value);
+			else throw invalid_argument { "unknown option " + option };
+		}
+
+		if (changes == 0)
+		{
+			throw invalid_argument { "--changes must be positive" };
+		}
+	}
+	catch (exception& e_)
+	{
+		cerr << e_.what() << endl;
+		cerr << "usage: reactive_framework8 --benchmark [--suites propagation,cutoff,parallel,batch,snapshot,fusion,operator,lazy,rolling,collection|all] [--changes N]" << endl;
+
+		return 2;
+	}
+
+	auto selected = [&](const char* suite_)
+	{
+		return find(suites.begin(), suites.end(), "all") != suites.end() ||
+			find(suites.begin(), suites.end(), suite_) != suites.end();
+	};
+
+	vector<result_row> rows;
+
+	if (selected("propagation"))
+	{
+		for (size_t width : { 16, 256, 4096 })
+		{
+			rows.push_back(wide_diamond(width, changes));
+		}
+
+		for (auto shape : { make_pair(8, 8), make_pair(32, 32), make_pair(16, 256) })
+		{
+			rows.push_back(deep_lattice(shape.first, shape.second, changes));
+		}
+	}
+
+	if (selected("cutoff"))
+	{
+		for (int divisor : { 1, 10, 100 })
+		{
+			auto row = wide_diamond(256, changes, divisor);
+			row.suite = "cutoff";
+
+			rows.push_back(row);
+		}
+	}
+
+	if (selected("parallel"))
+	{
+		for (auto policy : { EXECUTION_POLICY_SEQUENTIAL, EXECUTION_POLICY_PARALLEL })
+		{
+			rows.push_back(deep_lattice(64, 16, changes, policy, 20000));
+		}
+	}
+
+	if (selected("batch"))
+	{
+		for (bool batched : { false, true })
+		{
+			rows.push_back(ingestion(50, batched, changes));
+		}
+	}
+
+	if (selected("fusion"))
+	{
+		for (bool fused : { false, true })
+		{
+			rows.push_back(chain(fused, changes * 100));
+		}
+	}
+
+	if (selected("operator"))
+	{
+		for (bool erased : { true, false })
+		{
+			rows.push_back(map_recompute(256, erased, changes * 10));
+		}
+	}
+
+	if (selected("lazy"))
+	{
+		for (auto evaluation : { EVALUATION_EAGER, EVALUATION_LAZY })
+		{
+			rows.push_back(reporting(256, evaluation, changes));
+		}
+	}
+
+	if (selected("rolling"))
+	{
+		for (size_t window : { 100, 10000 })
+		{
+			for (bool incremental : { false, true })
+			{
+				rows.push_back(rolling(window, incremental, changes * 100));
+			}
+		}
+	}
+
+	if (selected("collection"))
+	{
+		for (size_t size : { 1000, 100000 })
+		{
+			for (bool delta : { false, true })
+			{
+				rows.push_back(collection(size, delta, changes));
+			}
+		}
+	}
+
+	if (selected("snapshot"))
+	{
+		for (bool seqlock : { true, false })
+		{
+			rows.push_back(snapshot_reads(16, seqlock, changes * 100));
+		}
+	}
+
+	print_table(rows);
+
+	return 0;
+}
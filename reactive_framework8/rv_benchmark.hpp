@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+
+namespace reactive_framework8
+{
+	//
+	//	non-interactive benchmarks of the propagation, the results are printed as a table
+	//
+	//	suites:
+	//		propagation		wide diamonds and deep lattices: recomputations and notifications of
+	//						the sink per change of the source, the time of a change
+	//		cutoff			a wide diamond, whose maps only change in every 1st, 10th, 100th change of
+	//						the source, the unchanged values aren't propagated
+	//		parallel		a lattice of expensive rvs by the sequential and the parallel policies
+	//		batch			50 inputs written in every tick, one by one vs. by rv_context::batch
+	//		snapshot		16 threads reading rv::snapshot while the source is changed 100 times per
+	//						--changes, reads/s of all the readers, inconsistent are the torn reads
+	//		fusion			a filter and 4 maps by an rv each vs. by one fused chain, see rv_chain,
+	//						100 changes per --changes
+	//		operator		256 maps of two strings by std::function vs. directly by the callable,
+	//						see graph::direct_map_operator_node, 10 changes per --changes
+	//		lazy			a reporting diamond of 256 maps read once after all the changes, by the
+	//						eager vs. the lazy evaluation, see E_EVALUATION
+	//		rolling			the maximum of the last 100 and 10000 values by rv_builder::rolling_max vs.
+	//						by a map over a copy of the history, 100 changes per --changes
+	//		collection		the odd squares of 1000 and 100000 items and their count by maps of vectors
+	//						vs. by the collection operators, see rv_collection
+	//
+	//	usage: reactive_framework8 --benchmark [options]
+	//			--suites propagation,cutoff,parallel,batch,snapshot,fusion,operator,lazy,rolling,collection|all	default: all
+	//			--changes N																								changes of the source or ticks per shape, default: 100
+	//
+	int run_benchmark(const std::vector<std::string>& args_);
+}
@@ -0,0 +1,215 @@
+#include "stdafx.h"
+#include "rv_clock.hpp"
+
+using namespace reactive_framework8;
+using namespace std;
+
+size_t rv_timer_queue::add(rv_clock::time_point at_, function<void()> task_)
+{
+	const size_t id = _next_id++;
+
+	_tasks.emplace(make_pair(at_, id), move(task_));
+	_times.emplace(id, at_);
+
+	return id;
+}
+
+void rv_timer_queue::remove(size_t id_)
+{
+	auto it = _times.find(id_);
+
+	if (it != _times.end())
+	{
+		_tasks.erase(make_pair(it->second, id_));
+		_times.erase(it);
+	}
+}
+
+bool rv_timer_queue::empty() const
+{
+	return _tasks.empty();
+}
+
+rv_clock::time_point rv_timer_queue::next() const
+{
+	return _tasks.begin()->first.first;
+}
+
+function<void()> rv_timer_queue::pop()
+{
+	auto it = _tasks.begin();
+	auto task = move(it->second);
+
+	_times.erase(it->first.second);
+	_tasks.erase(it);
+
+	return task;
+}
+
+rv_steady_clock::rv_steady_clock()
+	: _thread { _run, _ptr_state }
+{
+}
+
+rv_steady_clock::~rv_steady_clock()
+{
+	{
+		lock_guard<mutex> lock { _ptr_state->mutex };
+
+		_ptr_state->is_stopped = true;
+	}
+
+	_ptr_state->changed.notify_one();
+
+	//	the last owner can be a task
+	if (_thread.get_id() == this_thread::get_id())
+	{
+		_thread.detach();
+	}
+	else
+	{
+		_thread.join();
+	}
+}
+
+shared_ptr<rv_steady_clock> rv_steady_clock::shared()
+{
+	//	it's stopped with its last owner, so its thread isn't joined by the exit of the process
+	static mutex shared_mutex;
+	static weak_ptr<rv_steady_clock> ptr_shared;
+
+	lock_guard<mutex> lock { shared_mutex };
+
+	auto ptr_clock = ptr_shared.lock();
+
+	if (!ptr_clock)
+	{
+		ptr_clock = make_shared<rv_steady_clock>();
+		ptr_shared = ptr_clock;
+	}
+
+	return ptr_clock;
+}
+
+rv_clock::time_point rv_steady_clock::now() const
+{
+	return chrono::steady_clock::now();
+}
+
+size_t rv_steady_clock::schedule(time_point at_, function<void()> task_)
+{
+	size_t id;
+
+	{
+		lock_guard<mutex> lock { _ptr_state->mutex };
+
+		id = _ptr_state->timers.add(at_, move(task_));
+	}
+
+	_ptr_state->changed.notify_one();
+
+	return id;
+}
+
+void rv_steady_clock::cancel(size_t id_)
+{
+	lock_guard<mutex> lock { _ptr_state->mutex };
+
+	_ptr_state->timers.remove(id_);
+}
+
+void rv_steady_clock::_run(shared_ptr<state> ptr_state_)
+{
+	auto& s = *ptr_state_;
+
+	unique_lock<mutex> lock { s.mutex };
+
+	while (!s.is_stopped)
+	{
+		if (s.timers.empty())
+		{
+			s.changed.wait(lock);
+			continue;
+		}
+
+		const auto next = s.timers.next();
+
+		if (next > chrono::steady_clock::now())
+		{
+			s.changed.wait_until(lock, next);
+			continue;
+		}
+
+		auto task = s.timers.pop();
+
+		lock.unlock();
+
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			//	the thread of the clock is kept alive, the task has to handle its errors
+		}
+
+		//	the captures of the task are released without the lock
+		task = nullptr;
+
+		lock.lock();
+	}
+}
+
+rv_manual_clock::rv_manual_clock(time_point start_)
+	: _now { start_ }
+{
+}
+
+rv_clock::time_point rv_manual_clock::now() const
+{
+	lock_guard<mutex> lock { _mutex };
+
+	return _now;
+}
+
+size_t rv_manual_clock::schedule(time_point at_, function<void()> task_)
+{
+	lock_guard<mutex> lock { _mutex };
+
+	return _timers.add(at_, move(task_));
+}
+
+void rv_manual_clock::cancel(size_t id_)
+{
+	lock_guard<mutex> lock { _mutex };
+
+	_timers.remove(id_);
+}
+
+bool rv_manual_clock::is_synchronous() const
+{
+	return true;
+}
+
+void rv_manual_clock::advance(duration duration_)
+{
+	unique_lock<mutex> lock { _mutex };
+
+	const time_point target = _now + duration_;
+
+	while (!_timers.empty() && _timers.next() <= target)
+	{
+		_now = _timers.next();
+
+		auto task = _timers.pop();
+
+		lock.unlock();
+
+		task();
+		task = nullptr;
+
+		lock.lock();
+	}
+
+	_now = target;
+}
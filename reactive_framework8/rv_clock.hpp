@@ -0,0 +1,127 @@
+#pragma once
+#include "stdafx.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace reactive_framework8
+{
+	//
+	//	the time and the timers of the time-based operators, see rv_context::set_clock
+	//	The tasks are called without any lock of the clock held, so they can schedule and
+	//	cancel the timers.
+	//
+	class rv_clock
+	{
+	public:
+		typedef std::chrono::steady_clock::duration duration;
+		typedef std::chrono::steady_clock::time_point time_point;
+
+		virtual ~rv_clock() = default;
+
+		virtual time_point now() const = 0;
+
+		//	task_ is called once at or after at_, the id is never 0
+		virtual size_t schedule(time_point at_, std::function<void()> task_) = 0;
+
+		//	a task can be called even after it's cancelled, if it's being called already
+		virtual void cancel(size_t id_) = 0;
+
+		//
+		//	if the tasks are called by the thread, which moves the time, so the waves of the
+		//	timers are run by them, e.g. rv_manual_clock::advance. Otherwise the thread of the
+		//	clock only posts them to the context, see graph::timer_scope.
+		//
+		virtual bool is_synchronous() const
+		{
+			return false;
+		}
+	};
+
+	//	the timers of a clock in the order of their time
+	class rv_timer_queue
+	{
+	public:
+		size_t add(rv_clock::time_point at_, std::function<void()> task_);
+		void remove(size_t id_);
+
+		bool empty() const;
+		rv_clock::time_point next() const;
+
+		//	the task of the next timer
+		std::function<void()> pop();
+
+	private:
+		size_t _next_id = 1;
+
+		//	(time, id) -> task
+		std::map<std::pair<rv_clock::time_point, size_t>, std::function<void()>> _tasks;
+		std::unordered_map<size_t, rv_clock::time_point> _times;
+	};
+
+	//
+	//	std::chrono::steady_clock, the tasks are called by one thread of the clock, which is
+	//	shared by all the operators using it
+	//
+	class rv_steady_clock : public rv_clock
+	{
+	public:
+		rv_steady_clock();
+		~rv_steady_clock();
+
+		rv_steady_clock(const rv_steady_clock&) = delete;
+		rv_steady_clock& operator=(const rv_steady_clock&) = delete;
+
+		//	the default clock of the contexts, one for all of them
+		static std::shared_ptr<rv_steady_clock> shared();
+
+		time_point now() const override;
+		size_t schedule(time_point at_, std::function<void()> task_) override;
+		void cancel(size_t id_) override;
+
+	private:
+		//	it's shared with the thread, which can outlive the clock if its last owner is a task
+		struct state
+		{
+			std::mutex mutex;
+			std::condition_variable changed;
+			bool is_stopped = false;
+
+			rv_timer_queue timers;
+		};
+
+		std::shared_ptr<state> _ptr_state = std::make_shared<state>();
+		std::thread _thread;
+
+		static void _run(std::shared_ptr<state> ptr_state_);
+	};
+
+	//
+	//	a clock for the tests, its time only moves by advance(), which calls the due tasks on
+	//	the calling thread
+	//
+	class rv_manual_clock : public rv_clock
+	{
+	public:
+		explicit rv_manual_clock(time_point start_ = time_point { });
+
+		time_point now() const override;
+		size_t schedule(time_point at_, std::function<void()> task_) override;
+		void cancel(size_t id_) override;
+
+		bool is_synchronous() const override;
+
+		//	the tasks are called in the order of their time, now() is their time meanwhile
+		void advance(duration duration_);
+
+	private:
+		mutable std::mutex _mutex;
+		time_point _now;
+
+		rv_timer_queue _timers;
+	};
+}
@@ -0,0 +1,452 @@
+#pragma once
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+namespace reactive_framework8
+{
+	enum E_CHANGE
+	{
+		CHANGE_INSERT,
+		CHANGE_REMOVE,
+		CHANGE_UPDATE,
+	};
+
+	//	a change of an rv_collection, the indices are the ones at the time of the change
+	template<class T> struct rv_change
+	{
+		E_CHANGE kind;
+		size_t index;
+
+		//	the inserted or the new value, the removed one of a removal
+		T value;
+
+		//	the value replaced by an update
+		boost::optional<T> previous;
+	};
+
+	//
+	//	the value of a collection rv, which carries the changes of its version, so the
+	//	collection operators apply them instead of processing every item, see
+	//	rv_builder::map_each
+	//
+	//	The versions are immutable: the first change of a value, whose items are shared by a
+	//	copy, e.g. by the value of the rv, starts the next version. The following changes of
+	//	the version are made in place, so the changes are made on a copy of the current value
+	//	and it's assigned to the rv.
+	//
+	//		auto list = get(xs.value());
+	//		list.push_back(4);
+	//		list.update(0, 1);
+	//		xs = list;
+	//
+	//	The items are stored by chunks of about CHUNK_SIZE items, which are shared by the
+	//	versions, so a change copies the list of the chunks and the chunk changed, not all
+	//	the items. A change made by a copy of an older version throws. The versions are never
+	//	changed by the waves, so the values of rv::snapshot can be read by any thread.
+	//
+	template<class T> class rv_collection
+	{
+		typedef std::vector<T> chunk;
+
+		//	the chunks of a version, shared by its copies
+		struct storage
+		{
+			std::vector<std::shared_ptr<chunk>> chunks;
+
+			//	the count of the items up to the end of each chunk
+			std::vector<size_t> ends;
+		};
+
+	public:
+		static const size_t CHUNK_SIZE = 256;
+
+		class const_iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const T* pointer;
+			typedef const T& reference;
+
+			const_iterator(const storage* ptr_store_, size_t chunk_, size_t index_)
+				: _ptr_store { ptr_store_ }
+				, _chunk { chunk_ }
+				, _index { index_ }
+			{
+			}
+
+			const T& operator*() const
+			{
+				return (*_ptr_store->chunks[_chunk])[_index];
+			}
+
+			const T* operator->() const
+			{
+				return &**this;
+			}
+
+			//	the chunks are never empty
+			const_iterator& operator++()
+			{
+				if (++_index == _ptr_store->chunks[_chunk]->size())
+				{
+					++_chunk;
+					_index = 0;
+				}
+
+				return *this;
+			}
+
+			const_iterator operator++(int)
+			{
+				auto result = *this;
+				++*this;
+				return result;
+			}
+
+			bool operator==(const const_iterator& other_) const
+			{
+				return _chunk == other_._chunk && _index == other_._index;
+			}
+
+			bool operator!=(const const_iterator& other_) const
+			{
+				return !(*this == other_);
+			}
+
+		private:
+			const storage* _ptr_store;
+			size_t _chunk;
+			size_t _index;
+		};
+
+		rv_collection()
+			: _ptr_lineage { std::make_shared<lineage>() }
+			, _ptr_store { std::make_shared<storage>() }
+		{
+		}
+
+		explicit rv_collection(std::vector<T> items_)
+			: _ptr_lineage { std::make_shared<lineage>() }
+			, _ptr_store { std::make_shared<storage>() }
+		{
+			_fill(*_ptr_store, std::move(items_));
+		}
+
+		//	a copy of the items
+		std::vector<T> items() const
+		{
+			return std::vector<T>(begin(), end());
+		}
+
+		size_t size() const
+		{
+			return _ptr_store->ends.empty() ? 0 : _ptr_store->ends.back();
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		//	in O(log n)
+		const T& operator[](size_t index_) const
+		{
+			const size_t i = _chunk_of(index_);
+
+			return (*_ptr_store->chunks[i])[index_ - _begin_of(i)];
+		}
+
+		const_iterator begin() const
+		{
+			return { _ptr_store.get(), 0, 0 };
+		}
+
+		const_iterator end() const
+		{
+			return { _ptr_store.get(), _ptr_store->chunks.size(), 0 };
+		}
+
+		size_t version() const
+		{
+			return _version;
+		}
+
+		//	the changes from the previous version, unless it's a reset
+		const std::vector<rv_change<T>>& changes() const
+		{
+			return _changes;
+		}
+
+		//	the items don't follow the previous version by the changes, e.g. the first version
+		bool is_reset() const
+		{
+			return _is_reset;
+		}
+
+		void insert(size_t index_, T value_)
+		{
+			if (index_ > size())
+			{
+				throw std::out_of_range { "rv_collection::insert" };
+			}
+
+			_begin_change();
+
+			auto& store = *_ptr_store;
+
+			if (store.chunks.empty())
+			{
+				store.chunks.push_back(std::make_shared<chunk>());
+				store.ends.push_back(0);
+			}
+
+			//	an item at the end is appended to the last chunk
+			const size_t i = index_ == size() ? store.chunks.size() - 1 : _chunk_of(index_);
+			auto& items = _change_chunk(i);
+
+			items.insert(items.begin() + (index_ - _begin_of(i)), value_);
+			_shift_ends(i, true);
+			_balance(i);
+
+			_changes.push_back({ CHANGE_INSERT, index_, std::move(value_), boost::none });
+		}
+
+		void push_back(T value_)
+		{
+			insert(size(), std::move(value_));
+		}
+
+		void remove(size_t index_)
+		{
+			if (index_ >= size())
+			{
+				throw std::out_of_range { "rv_collection::remove" };
+			}
+
+			_begin_change();
+
+			const size_t i = _chunk_of(index_);
+			auto& items = _change_chunk(i);
+			const auto position = items.begin() + (index_ - _begin_of(i));
+
+			_changes.push_back({ CHANGE_REMOVE, index_, std::move(*position), boost::none });
+
+			items.erase(position);
+			_shift_ends(i, false);
+			_balance(i);
+		}
+
+		void update(size_t index_, T value_)
+		{
+			if (index_ >= size())
+			{
+				throw std::out_of_range { "rv_collection::update" };
+			}
+
+			_begin_change();
+
+			const size_t i = _chunk_of(index_);
+			auto& item = _change_chunk(i)[index_ - _begin_of(i)];
+
+			boost::optional<T> previous { std::move(item) };
+
+			item = value_;
+			_changes.push_back({ CHANGE_UPDATE, index_, std::move(value_), std::move(previous) });
+		}
+
+		//	all the items are replaced by a reset
+		void assign(std::vector<T> items_)
+		{
+			_begin_change();
+
+			*_ptr_store = storage { };
+			_fill(*_ptr_store, std::move(items_));
+
+			_is_reset = true;
+			_changes.clear();
+		}
+
+		//	the version is the next one of the same collection by the changes
+		bool follows(const rv_collection& previous_) const
+		{
+			return !_is_reset && _ptr_lineage == previous_._ptr_lineage && _version == previous_._version + 1;
+		}
+
+		//	the same version of the same collection
+		bool operator==(const rv_collection& other_) const
+		{
+			return _ptr_lineage == other_._ptr_lineage && _version == other_._version;
+		}
+
+		bool operator!=(const rv_collection& other_) const
+		{
+			return !(*this == other_);
+		}
+
+	private:
+		//	shared by the versions of a collection
+		struct lineage
+		{
+			//	the latest version
+			std::atomic<size_t> version { 0 };
+		};
+
+		std::shared_ptr<lineage> _ptr_lineage;
+
+		//	shared by the copies of a version, it's only changed while this value is its only owner
+		std::shared_ptr<storage> _ptr_store;
+
+		size_t _version = 0;
+		bool _is_reset = true;
+		std::vector<rv_change<T>> _changes;
+
+		static void _fill(storage& store_, std::vector<T> items_)
+		{
+			if (items_.size() <= 2 * CHUNK_SIZE)
+			{
+				if (!items_.empty())
+				{
+					store_.ends.push_back(items_.size());
+					store_.chunks.push_back(std::make_shared<chunk>(std::move(items_)));
+				}
+
+				return;
+			}
+
+			for (size_t begin = 0; begin < items_.size(); begin += CHUNK_SIZE)
+			{
+				const size_t end = items_.size() - begin > CHUNK_SIZE ? begin + CHUNK_SIZE : items_.size();
+
+				store_.chunks.push_back(std::make_shared<chunk>(std::make_move_iterator(items_.begin() + begin), std::make_move_iterator(items_.begin() + end)));
+				store_.ends.push_back(end);
+			}
+		}
+
+		//	the chunk of an existing item
+		size_t _chunk_of(size_t index_) const
+		{
+			const auto& ends = _ptr_store->ends;
+
+			return std::upper_bound(ends.begin(), ends.end(), index_) - ends.begin();
+		}
+
+		size_t _begin_of(size_t chunk_) const
+		{
+			return chunk_ == 0 ? 0 : _ptr_store->ends[chunk_ - 1];
+		}
+
+		//	an item is inserted into or removed from the chunk
+		void _shift_ends(size_t chunk_, bool is_inserted_)
+		{
+			auto& ends = _ptr_store->ends;
+
+			for (size_t i = chunk_; i < ends.size(); ++i)
+			{
+				is_inserted_ ? ++ends[i] : --ends[i];
+			}
+		}
+
+		//	the first change of a shared version starts the next version on a copy of the list of the chunks
+		void _begin_change()
+		{
+			if (_version != _ptr_lineage->version)
+			{
+				throw std::logic_error { "change of an old version of an rv_collection" };
+			}
+
+			if (_ptr_store.use_count() > 1)
+			{
+				_ptr_store = std::make_shared<storage>(*_ptr_store);
+
+				_version = ++_ptr_lineage->version;
+				_is_reset = false;
+				_changes.clear();
+			}
+		}
+
+		//	a chunk shared by another version is copied
+		chunk& _change_chunk(size_t chunk_)
+		{
+			auto& ptr_chunk = _ptr_store->chunks[chunk_];
+
+			if (ptr_chunk.use_count() > 1)
+			{
+				ptr_chunk = std::make_shared<chunk>(*ptr_chunk);
+			}
+
+			return *ptr_chunk;
+		}
+
+		//	a chunk is kept between CHUNK_SIZE / 2 and 2 * CHUNK_SIZE items, unless it's the only one
+		void _balance(size_t chunk_)
+		{
+			auto& store = *_ptr_store;
+			const size_t size = store.chunks[chunk_]->size();
+
+			if (size > 2 * CHUNK_SIZE)
+			{
+				_split(chunk_);
+			}
+			else if (size == 0 && store.chunks.size() == 1)
+			{
+				store = { };
+			}
+			else if (size < CHUNK_SIZE / 2 && store.chunks.size() > 1)
+			{
+				const size_t first = chunk_ + 1 < store.chunks.size() ? chunk_ : chunk_ - 1;
+
+				auto& items = _change_chunk(first);
+				const auto& next = *store.chunks[first + 1];
+
+				items.insert(items.end(), next.begin(), next.end());
+
+				store.chunks.erase(store.chunks.begin() + first + 1);
+				store.ends.erase(store.ends.begin() + first);
+
+				if (items.size() > 2 * CHUNK_SIZE)
+				{
+					_split(first);
+				}
+			}
+		}
+
+		void _split(size_t chunk_)
+		{
+			auto& store = *_ptr_store;
+			auto& items = *store.chunks[chunk_];
+			const auto middle = items.begin() + items.size() / 2;
+
+			auto ptr_second = std::make_shared<chunk>(std::make_move_iterator(middle), std::make_move_iterator(items.end()));
+			items.erase(middle, items.end());
+
+			store.ends.insert(store.ends.begin() + chunk_, _begin_of(chunk_) + items.size());
+			store.chunks.insert(store.chunks.begin() + chunk_ + 1, std::move(ptr_second));
+		}
+	};
+
+	//	by the changes, so a collection is printed by the debugger in the time of the changes:
+	//	+index:value, -index:value and ~index:value, or by all the items if it's a reset
+	template<class T> std::ostream& operator<<(std::ostream& os_, const rv_collection<T>& collection_)
+	{
+		using namespace utility;
+
+		if (collection_.is_reset())
+		{
+			return os_ << collection_.items();
+		}
+
+		os_ << "v" << collection_.version();
+
+		for (const auto& change : collection_.changes())
+		{
+			os_ << " " << (change.kind == CHANGE_INSERT ? '+' : change.kind == CHANGE_REMOVE ? '-' : '~') << change.index << ":" << change.value;
+		}
+
+		return os_;
+	}
+}
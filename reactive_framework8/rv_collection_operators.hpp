@@ -0,0 +1,383 @@
+#pragma once
+#include "stdafx.h"
+
+#include "rv_collection.hpp"
+#include "rv_graph.hpp"
+
+namespace reactive_framework8
+{
+	namespace graph
+	{
+		//
+		//	an operator over a collection rv, which applies the changes of the versions of the
+		//	source one by one to its current value, so the items are only recomputed by the
+		//	changes, and a collection output shares the unchanged chunks of its items with the
+		//	previous version, see rv_collection. It's rebuilt from all the items if a version
+		//	is a reset or it doesn't follow the last applied one, e.g. the versions of a batch
+		//	are propagated together.
+		//	T: the type of the items of the source, R: the type of the result
+		//
+		template<class T, class R> class collection_operator_node : public node<R>
+		{
+		public:
+			explicit collection_operator_node(std::shared_ptr<node<rv_collection<T>>> ptr_source_)
+				: _ptr_source { std::move(ptr_source_) }
+			{
+			}
+
+			~collection_operator_node()
+			{
+				release_source(std::move(_ptr_source));
+			}
+
+		private:
+			std::shared_ptr<node<rv_collection<T>>> _ptr_source;
+
+			//	the last version of the source applied
+			boost::optional<rv_collection<T>> _applied;
+
+			virtual void _rebuild(const rv_collection<T>& source_, R& result_) = 0;
+			virtual void _apply(const rv_change<T>& change_, R& result_) = 0;
+
+			boost::optional<R> _re_calc() const override
+			{
+				return const_cast<collection_operator_node*>(this)->_update();
+			}
+
+			boost::optional<R> _update()
+			{
+				const auto& source = _ptr_source->value();
+
+				if (!source)
+				{
+					return { };
+				}
+
+				if (_applied && *source == *_applied)
+				{
+					return { };
+				}
+
+				const auto& current = this->value();
+
+				//	the next version of a collection output starts on a copy of the current one
+				R result = current ? *current : R { };
+
+				if (_applied && current && source->follows(*_applied))
+				{
+					for (const auto& change : source->changes())
+					{
+						_apply(change, result);
+					}
+				}
+				else
+				{
+					_rebuild(*source, result);
+				}
+
+				_applied = *source;
+
+				return result;
+			}
+		};
+
+		//	the collection of func(item) of the items
+		template<class T, class F> class map_each_operator_node
+			: public collection_operator_node<T, rv_collection<std::decay_t<std::result_of_t<F&(const T&)>>>>
+		{
+		public:
+			typedef std::decay_t<std::result_of_t<F&(const T&)>> item_type;
+
+			map_each_operator_node(F func_, std::shared_ptr<node<rv_collection<T>>> ptr_source_)
+				: collection_operator_node<T, rv_collection<item_type>>(std::move(ptr_source_))
+				, _func { std::move(func_) }
+			{
+			}
+
+		private:
+			F _func;
+
+			void _rebuild(const rv_collection<T>& source_, rv_collection<item_type>& result_) override
+			{
+				std::vector<item_type> items;
+				items.reserve(source_.size());
+
+				for (const auto& item : source_)
+				{
+					items.push_back(_func(item));
+				}
+
+				result_.assign(std::move(items));
+			}
+
+			void _apply(const rv_change<T>& change_, rv_collection<item_type>& result_) override
+			{
+				switch (change_.kind)
+				{
+				case CHANGE_INSERT:
+					result_.insert(change_.index, _func(change_.value));
+					break;
+
+				case CHANGE_REMOVE:
+					result_.remove(change_.index);
+					break;
+
+				case CHANGE_UPDATE:
+					result_.update(change_.index, _func(change_.value));
+					break;
+				}
+			}
+		};
+
+		//
+		//	the number of the flags set before an index in O(log n) by a Fenwick tree, a flag is
+		//	set or pushed back in O(log n), the others are changed by a rebuild in O(n)
+		//
+		class rank_tree
+		{
+		public:
+			//	the flags set in [0, index_)
+			size_t rank(size_t index_) const
+			{
+				size_t count = 0;
+
+				for (size_t i = index_; i > 0; i -= i & (0 - i))
+				{
+					count += _tree[i];
+				}
+
+				return count;
+			}
+
+			bool is_set(size_t index_) const
+			{
+				return _flags[index_] != 0;
+			}
+
+			void set(size_t index_, bool is_set_)
+			{
+				if (is_set(index_) == is_set_)
+				{
+					return;
+				}
+
+				_flags[index_] = is_set_;
+
+				for (size_t i = index_ + 1; i < _tree.size(); i += i & (0 - i))
+				{
+					is_set_ ? ++_tree[i] : --_tree[i];
+				}
+			}
+
+			//	the node of the new flag covers (i - lowbit(i), i]
+			void push_back(bool is_set_)
+			{
+				const size_t i = _tree.size();
+
+				_flags.push_back(is_set_);
+				_tree.push_back((is_set_ ? 1 : 0) + rank(i - 1) - rank(i - (i & (0 - i))));
+			}
+
+			void insert(size_t index_, bool is_set_)
+			{
+				if (index_ == _flags.size())
+				{
+					push_back(is_set_);
+					return;
+				}
+
+				_flags.insert(_flags.begin() + index_, is_set_);
+				_build();
+			}
+
+			//	the last flag isn't covered by the nodes of the others
+			void remove(size_t index_)
+			{
+				_flags.erase(_flags.begin() + index_);
+
+				if (index_ == _flags.size())
+				{
+					_tree.pop_back();
+					return;
+				}
+
+				_build();
+			}
+
+			void assign(std::vector<char> flags_)
+			{
+				_flags = std::move(flags_);
+				_build();
+			}
+
+		private:
+			std::vector<char> _flags;
+
+			//	1-based, _tree[0] is unused
+			std::vector<size_t> _tree = std::vector<size_t>(1, 0);
+
+			void _build()
+			{
+				_tree.assign(_flags.size() + 1, 0);
+
+				for (size_t i = 1; i < _tree.size(); ++i)
+				{
+					_tree[i] += _flags[i - 1];
+
+					const size_t parent = i + (i & (0 - i));
+
+					if (parent < _tree.size())
+					{
+						_tree[parent] += _tree[i];
+					}
+				}
+			}
+		};
+
+		//	the items passing pred in the order of the source
+		template<class T, class P> class filter_each_operator_node : public collection_operator_node<T, rv_collection<T>>
+		{
+		public:
+			filter_each_operator_node(P pred_, std::shared_ptr<node<rv_collection<T>>> ptr_source_)
+				: collection_operator_node<T, rv_collection<T>>(std::move(ptr_source_))
+				, _pred { std::move(pred_) }
+			{
+			}
+
+		private:
+			P _pred;
+
+			//	the passing items of the source, an item of the output is at the rank of its index
+			rank_tree _passing;
+
+			void _rebuild(const rv_collection<T>& source_, rv_collection<T>& result_) override
+			{
+				std::vector<T> items;
+				std::vector<char> flags;
+				flags.reserve(source_.size());
+
+				for (const auto& item : source_)
+				{
+					const bool is_passing = _pred(item);
+
+					flags.push_back(is_passing);
+
+					if (is_passing)
+					{
+						items.push_back(item);
+					}
+				}
+
+				_passing.assign(std::move(flags));
+				result_.assign(std::move(items));
+			}
+
+			void _apply(const rv_change<T>& change_, rv_collection<T>& result_) override
+			{
+				const size_t index = change_.index;
+
+				switch (change_.kind)
+				{
+				case CHANGE_INSERT:
+				{
+					const bool is_passing = _pred(change_.value);
+
+					_passing.insert(index, is_passing);
+
+					if (is_passing)
+					{
+						result_.insert(_passing.rank(index), change_.value);
+					}
+
+					break;
+				}
+
+				case CHANGE_REMOVE:
+				{
+					const bool was_passing = _passing.is_set(index);
+					const size_t rank = _passing.rank(index);
+
+					_passing.remove(index);
+
+					if (was_passing)
+					{
+						result_.remove(rank);
+					}
+
+					break;
+				}
+
+				case CHANGE_UPDATE:
+				{
+					const bool was_passing = _passing.is_set(index);
+					const bool is_passing = _pred(change_.value);
+					const size_t rank = _passing.rank(index);
+
+					_passing.set(index, is_passing);
+
+					if (was_passing && is_passing)
+					{
+						result_.update(rank, change_.value);
+					}
+					else if (was_passing)
+					{
+						result_.remove(rank);
+					}
+					else if (is_passing)
+					{
+						result_.insert(rank, change_.value);
+					}
+
+					break;
+				}
+				}
+			}
+		};
+
+		//	the number of the items passing pred
+		template<class T, class P> class count_operator_node : public collection_operator_node<T, size_t>
+		{
+		public:
+			count_operator_node(P pred_, std::shared_ptr<node<rv_collection<T>>> ptr_source_)
+				: collection_operator_node<T, size_t>(std::move(ptr_source_))
+				, _pred { std::move(pred_) }
+			{
+			}
+
+		private:
+			P _pred;
+
+			void _rebuild(const rv_collection<T>& source_, size_t& result_) override
+			{
+				result_ = 0;
+
+				for (const auto& item : source_)
+				{
+					result_ += _pred(item) ? 1 : 0;
+				}
+			}
+
+			void _apply(const rv_change<T>& change_, size_t& result_) override
+			{
+				if (change_.previous && _pred(*change_.previous))
+				{
+					--result_;
+				}
+
+				if (_pred(change_.value))
+				{
+					change_.kind == CHANGE_REMOVE ? --result_ : ++result_;
+				}
+			}
+		};
+
+		//	the predicate of count without one
+		template<class T> struct every_item
+		{
+			bool operator()(const T&) const
+			{
+				return true;
+			}
+		};
+	}
+}
@@ -1,6 +1,13 @@
 #pragma once
 #include "stdafx.h"
 
+#include <utility\stats.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
 namespace reactive_framework8
 {
 	template<class T> class rv;
@@ -8,47 +15,270 @@ namespace reactive_framework8
 
 	namespace graph
 	{
+		//	published as "rv.recomputes", "rv.value_changes" and "rv.unchanged_values", see utility/stats.hpp
+		utility::stats_counter& recompute_counter();
+		utility::stats_counter& value_change_counter();
+		utility::stats_counter& unchanged_value_counter();
+
+		//	published as "rv.nodes": the nodes alive
+		utility::stats_counter& node_counter();
+
+		//	operator== if the type has one, otherwise the values are never equal
+		template<class T> auto default_equals(const T& a_, const T& b_, int) -> decltype(static_cast<bool>(a_ == b_))
+		{
+			return static_cast<bool>(a_ == b_);
+		}
+
+		template<class T> bool default_equals(const T&, const T&, long)
+		{
+			return false;
+		}
+
 		struct inotifiable
 		{
+			inotifiable()
+			{
+				node_counter().add();
+			}
+
+			virtual ~inotifiable()
+			{
+				node_counter().sub();
+			}
+
 			virtual void invalidate() = 0;
+
+			//
+			//	rank in the topological order: a node is higher than its sources, except along
+			//	the edges which close a loop. The changes are propagated from the lowest dirty
+			//	node to the highest one, so a node is recomputed once all of its sources are.
+			//
+			size_t height = 0;
+
+			//	it's waiting in the propagation queue of the rv_context
+			bool is_queued = false;
+
+			//
+			//	a lazy node is only marked dirty by the propagation, it's recomputed when its
+			//	value is read, see rv_context::set_evaluation
+			//
+			bool is_lazy = false;
+
+			//	bumped by every mark of a lazy node, its value is computed up to a version
+			std::atomic<size_t> version { 0 };
+
+			std::vector<std::weak_ptr<inotifiable>> targets;
+
+			//	releases the source of a value node, it breaks a loop, see release_source
+			virtual void detach_source() { }
+		};
+
+		//	the target and the nodes depending on it are raised above the source
+		void add_edge(inotifiable& source_, std::weak_ptr<inotifiable> target_);
+
+		//
+		//	A node holds its sources, the sources only refer to their targets, so a subgraph
+		//	is disposed with the last rv observing it. A disposed node is unlinked from the
+		//	targets of its sources and releases them by this. The released nodes are
+		//	destroyed one by one instead of recursively, so a deep subgraph can't overflow
+		//	the stack. The nodes of a loop hold each other, they aren't disposed.
+		//
+		void release_source(std::shared_ptr<inotifiable> ptr_source_);
+
+		//	if the target is reached from the source by its targets
+		bool reaches(const inotifiable& source_, const inotifiable& target_);
+
+		template<class Tp, size_t... Ns> void release_sources(Tp& sources_, std::index_sequence<Ns...>)
+		{
+			auto released = { (release_source(std::move(std::get<Ns>(sources_))), 0)... };
+			(void)released;
+		}
+
+		//
+		//	the values of a node in the order of their changes, while a node accumulating them
+		//	depends on it, see change_reader, so the changes propagated by one wave, e.g. the
+		//	ones of a batch, are read one by one, not only the last of them
+		//	The sequence of an entry is the version of the value, it's dropped once every
+		//	reader has read it.
+		//
+		template<class T> class change_log
+		{
+		public:
+			void append(const T& value_)
+			{
+				std::lock_guard<std::mutex> lock { _mutex };
+
+				++_sequence;
+
+				if (!_sequences_of_readers.empty())
+				{
+					_entries.emplace_back(_sequence, value_);
+				}
+			}
+
+			//	the reader reads the changes after the current value
+			void add_reader(const void* ptr_reader_)
+			{
+				std::lock_guard<std::mutex> lock { _mutex };
+
+				_sequences_of_readers[ptr_reader_] = _sequence;
+			}
+
+			void remove_reader(const void* ptr_reader_)
+			{
+				std::lock_guard<std::mutex> lock { _mutex };
+
+				_sequences_of_readers.erase(ptr_reader_);
+				_trim();
+			}
+
+			//	the values changed since the last read of the reader, they are copied, so they're read without the lock
+			std::vector<T> read(const void* ptr_reader_)
+			{
+				std::lock_guard<std::mutex> lock { _mutex };
+
+				size_t& sequence = _sequences_of_readers[ptr_reader_];
+
+				std::vector<T> values;
+
+				for (const auto& entry : _entries)
+				{
+					if (entry.first > sequence)
+					{
+						values.push_back(entry.second);
+					}
+				}
+
+				sequence = _sequence;
+				_trim();
+
+				return values;
+			}
+
+			//	the reader skips the changes up to the current value
+			void skip(const void* ptr_reader_)
+			{
+				std::lock_guard<std::mutex> lock { _mutex };
+
+				_sequences_of_readers[ptr_reader_] = _sequence;
+				_trim();
+			}
+
+		private:
+			std::mutex _mutex;
+
+			size_t _sequence = 0;
+
+			//	(sequence, value)
+			std::deque<std::pair<size_t, T>> _entries;
+			std::unordered_map<const void*, size_t> _sequences_of_readers;
+
+			void _trim()
+			{
+				size_t oldest = _sequence;
+
+				for (const auto& reader : _sequences_of_readers)
+				{
+					if (reader.second < oldest)
+					{
+						oldest = reader.second;
+					}
+				}
+
+				while (!_entries.empty() && _entries.front().first <= oldest)
+				{
+					_entries.pop_front();
+				}
+			}
 		};
 
 		template<class T> class node : public inotifiable
 		{
 		public:
+			//	a dirty lazy node is recomputed first, and the dirty lazy nodes it depends on
 			const boost::optional<T>& value() const
 			{
+				if (is_lazy && version != _computed_version)
+				{
+					const_cast<node*>(this)->_pull();
+				}
+
 				return _value;
 			}
 
+			//
+			//	a value equal to the current one is dropped: neither the owners nor the
+			//	targets are notified, so the propagation stops here
+			//
 			void set_value(T value_)
 			{
-				_value = value_;
+				if (!_ptr_rc)
+				{
+					if (!_is_unchanged_by(value_))
+					{
+						_set_value(std::move(value_));
+					}
 
-				notify();
+					return;
+				}
 
-				// debugger
-				if (_ptr_rc)
-				{
-					_ptr_rc->debugger().notify_value_change(*this, _value);
+				_ptr_rc->begin_change();
 
+				bool is_changed = false;
 
-					for (auto& trg : _targets)
+				try
+				{
+					is_changed = !_is_unchanged_by(value_);
+
+					if (is_changed)
 					{
-						auto target = trg.lock();
-						if (target)
-						{
-							_ptr_rc->submit([=]
-							{
-								target->invalidate();
-							});
-						}
+						_set_value(std::move(value_));
+
+						// debugger
+						_ptr_rc->debugger().notify_value_change(*this, _value);
 					}
 				}
+				catch (...)
+				{
+					_ptr_rc->end_change(*this, is_changed);
+					throw;
+				}
+
+				_ptr_rc->end_change(*this, is_changed);
+			}
+
+			//	decides if a new value is equal to the current one instead of operator==
+			void set_comparator(std::function<bool(const T&, const T&)> equal_)
+			{
+				_equal = std::move(equal_);
+				_hash = nullptr;
+			}
+
+			//
+			//	the values are equal if their hashes are, only the hash of the current value
+			//	is compared, so a collision drops a change
+			//
+			void set_hash(std::function<size_t(const T&)> hash_)
+			{
+				_hash = std::move(hash_);
+				_equal = nullptr;
+
+				if (_hash && _value)
+				{
+					_hash_of_value = _hash(*_value);
+				}
 			}
 
 			void invalidate() override final
 			{
+				if (is_lazy && _ptr_rc)
+				{
+					_mark_dirty();
+					return;
+				}
+
+				recompute_counter().add();
+
 				auto new_val = _re_calc();
 				if (new_val)
 				{
@@ -58,7 +288,7 @@ namespace reactive_framework8
 
 			void assign(std::weak_ptr<inotifiable> target_)
 			{
-				_targets.push_back(std::move(target_));
+				add_edge(*this, std::move(target_));
 			}
 
 			void assign(rv_context& rc_)
@@ -66,17 +296,306 @@ namespace reactive_framework8
 				_ptr_rc = &rc_;
 			}
 
+			//	the changes of the value are logged from the first call on, see change_reader
+			std::shared_ptr<change_log<T>> log_changes()
+			{
+				if (!_ptr_change_log)
+				{
+					_ptr_change_log = std::make_shared<change_log<T>>();
+				}
+
+				return _ptr_change_log;
+			}
+
 		protected:
 			virtual void notify() { }
 
+			//	nullptr until the node is assigned to a context
+			rv_context* _context() const
+			{
+				return _ptr_rc;
+			}
+
+			//	an observed lazy node is recomputed as soon as it's marked, see value_node
+			virtual bool _is_observed() const
+			{
+				return false;
+			}
+
 		private:
 			boost::optional<T> _value;
-			std::vector<std::weak_ptr<inotifiable>> _targets;
 			rv_context* _ptr_rc = nullptr;
 
+			//	the version of the value of a lazy node
+			std::atomic<size_t> _computed_version { 0 };
+
+			std::function<bool(const T&, const T&)> _equal;
+			std::function<size_t(const T&)> _hash;
+			size_t _hash_of_value = 0;
+
+			std::shared_ptr<change_log<T>> _ptr_change_log;
+
+			//	the hash of the new value is kept, it's the hash of the current one after the change
+			bool _is_unchanged_by(const T& value_)
+			{
+				if (!_value)
+				{
+					return false;
+				}
+
+				bool is_equal;
+
+				if (_hash)
+				{
+					const size_t hash = _hash(value_);
+
+					is_equal = hash == _hash_of_value;
+					_hash_of_value = hash;
+				}
+				else if (_equal)
+				{
+					is_equal = _equal(*_value, value_);
+				}
+				else
+				{
+					is_equal = default_equals(*_value, value_, 0);
+				}
+
+				if (is_equal)
+				{
+					unchanged_value_counter().add();
+				}
+
+				return is_equal;
+			}
+
+			//	the targets are marked too, but the node is only recomputed by a read
+			void _mark_dirty()
+			{
+				_ptr_rc->begin_change();
+
+				try
+				{
+					_ptr_rc->begin_pull();
+					++version;
+					_ptr_rc->end_pull();
+
+					if (_is_observed())
+					{
+						value();
+					}
+				}
+				catch (...)
+				{
+					_ptr_rc->end_change(*this, true);
+					throw;
+				}
+
+				_ptr_rc->end_change(*this, true);
+			}
+
+			void _pull()
+			{
+				_ptr_rc->begin_pull();
+
+				const size_t computed_version = _computed_version;
+
+				try
+				{
+					if (version != computed_version)
+					{
+						//	the owners read the new value, it's clean by then
+						_computed_version = version.load();
+
+						recompute_counter().add();
+
+						auto new_val = _re_calc();
+
+						if (new_val && !_is_unchanged_by(*new_val))
+						{
+							_set_value(std::move(*new_val));
+
+							// debugger
+							_ptr_rc->debugger().notify_value_change(*this, _value);
+						}
+					}
+				}
+				catch (...)
+				{
+					_computed_version = computed_version;
+					_ptr_rc->end_pull();
+					throw;
+				}
+
+				_ptr_rc->end_pull();
+			}
+
+			void _set_value(T value_)
+			{
+				if (_hash && !_value)
+				{
+					_hash_of_value = _hash(value_);
+				}
+
+				_value = std::move(value_);
+
+				value_change_counter().add();
+
+				if (_ptr_change_log)
+				{
+					_ptr_change_log->append(*_value);
+				}
+
+				notify();
+			}
+
 			virtual boost::optional<T> _re_calc() const = 0;
 		};
 
+		//
+		//	reads every change of a source in order, see change_log. A recomputation without
+		//	a new change of the source reads nothing, so no change is accumulated twice.
+		//
+		template<class T> class change_reader
+		{
+		public:
+			explicit change_reader(node<T>& source_)
+				: _ptr_log { source_.log_changes() }
+			{
+				_ptr_log->add_reader(this);
+			}
+
+			change_reader(const change_reader&) = delete;
+			change_reader& operator=(const change_reader&) = delete;
+
+			~change_reader()
+			{
+				_ptr_log->remove_reader(this);
+			}
+
+			//	the first read is the current value of the source
+			std::vector<T> read(const node<T>& source_)
+			{
+				if (!_is_started)
+				{
+					_is_started = true;
+					_ptr_log->skip(this);
+
+					if (!source_.value())
+					{
+						return { };
+					}
+
+					return { *source_.value() };
+				}
+
+				return _ptr_log->read(this);
+			}
+
+		private:
+			std::shared_ptr<change_log<T>> _ptr_log;
+			bool _is_started = false;
+		};
+
+		//
+		//	the last published value of a node for the readers on other threads
+		//
+		//	The trivially copyable values are published by a seqlock: the writer never waits,
+		//	a reader only retries while a write of the same value is in progress. The other
+		//	ones are published as immutable copies by an atomic swap of a shared_ptr.
+		//
+		template<class T, bool = std::is_trivially_copyable<T>::value> class snapshot_slot
+		{
+		public:
+			void publish(const T& value_)
+			{
+				std::atomic_store_explicit(&_ptr_value, std::shared_ptr<const T> { std::make_shared<T>(value_) }, std::memory_order_release);
+			}
+
+			boost::optional<T> load() const
+			{
+				auto ptr_value = std::atomic_load_explicit(&_ptr_value, std::memory_order_acquire);
+
+				if (!ptr_value)
+				{
+					return { };
+				}
+
+				return *ptr_value;
+			}
+
+		private:
+			std::shared_ptr<const T> _ptr_value;
+		};
+
+		template<class T> class snapshot_slot<T, true>
+		{
+		public:
+			//	there is one writer at a time, the owner of the rv_context
+			void publish(const T& value_)
+			{
+				uint64_t words[COUNT_OF_WORDS] = { };
+				std::memcpy(words, &value_, sizeof(T));
+
+				const unsigned sequence = _sequence.load(std::memory_order_relaxed);
+
+				//	odd while it's written
+				_sequence.store(sequence + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+
+				for (size_t i = 0; i < COUNT_OF_WORDS; ++i)
+				{
+					_words[i].store(words[i], std::memory_order_relaxed);
+				}
+
+				_sequence.store(sequence + 2, std::memory_order_release);
+			}
+
+			boost::optional<T> load() const
+			{
+				uint64_t words[COUNT_OF_WORDS];
+
+				for (;;)
+				{
+					const unsigned before = _sequence.load(std::memory_order_acquire);
+
+					//	it has never been published
+					if (before == 0)
+					{
+						return { };
+					}
+
+					if (before & 1)
+					{
+						continue;
+					}
+
+					for (size_t i = 0; i < COUNT_OF_WORDS; ++i)
+					{
+						words[i] = _words[i].load(std::memory_order_relaxed);
+					}
+
+					std::atomic_thread_fence(std::memory_order_acquire);
+
+					if (_sequence.load(std::memory_order_relaxed) == before)
+					{
+						break;
+					}
+				}
+
+				typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+				std::memcpy(&storage, words, sizeof(T));
+
+				return *reinterpret_cast<const T*>(&storage);
+			}
+
+		private:
+			static const size_t COUNT_OF_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+			std::atomic<unsigned> _sequence { 0 };
+			std::atomic<uint64_t> _words[COUNT_OF_WORDS];
+		};
+
 		template<class T> class value_node final : public node<T>
 		{
 		public:
@@ -87,9 +606,19 @@ namespace reactive_framework8
 
 			value_node(const value_node&) = default;
 
-			void set_source(node<T>& src_node_)
+			~value_node()
 			{
-				_source = &src_node_;
+				release_source(std::move(_ptr_source));
+			}
+
+			void set_source(std::shared_ptr<node<T>> ptr_source_)
+			{
+				_ptr_source = std::move(ptr_source_);
+			}
+
+			void detach_source() override
+			{
+				release_source(std::move(_ptr_source));
 			}
 
 			void add_owner(rv<T>& new_owner_rv_)
@@ -102,22 +631,62 @@ namespace reactive_framework8
 				_host_rvs.erase(&owner_rv_);
 			}
 
+			//
+			//	it can be called by any thread, see snapshot_slot
+			//	The values are only published after the first snapshot, so an rv without readers
+			//	isn't copied by its changes. The first one requests the publication and returns
+			//	right away, it's empty until the next change of the rv has been propagated.
+			//	No snapshot waits for the wave.
+			//
+			boost::optional<T> snapshot() const
+			{
+				if (!_is_snapshot_read.load(std::memory_order_relaxed))
+				{
+					_is_snapshot_read.store(true, std::memory_order_relaxed);
+				}
+
+				return _snapshot.load();
+			}
+
 		private:
-			node<T>* _source = nullptr;
+			std::shared_ptr<node<T>> _ptr_source;
 			std::unordered_set<rv<T>*> _host_rvs;
 
+			snapshot_slot<T> _snapshot;
+
+			//	it's set by the first reader, the next notify() publishes the value
+			mutable std::atomic<bool> _is_snapshot_read { false };
+
 			boost::optional<T> _re_calc() const override
 			{
-				if(_source)
+				if(_ptr_source)
 				{
-					return _source->value();
+					return _ptr_source->value();
 				}
 
 				return value();
 			}
 
+			bool _is_observed() const override
+			{
+				for (auto ptr_host : _host_rvs)
+				{
+					if (!ptr_host->_subscribes.empty())
+					{
+						return true;
+					}
+				}
+
+				return false;
+			}
+
 			void notify() override
 			{
+				if (_is_snapshot_read.load(std::memory_order_relaxed) || !this->_context())
+				{
+					_snapshot.publish(*value());
+				}
+
 				for (auto ptr_host : _host_rvs)
 				{
 					ptr_host->notify();
@@ -131,12 +700,17 @@ namespace reactive_framework8
 			static constexpr std::index_sequence_for<As...> SEQ { };
 		
 		protected:
-			operator_node(std::function<R(As...)> func_, std::tuple<std::weak_ptr<node<As>>...> sources_)
+			operator_node(std::function<R(As...)> func_, std::tuple<std::shared_ptr<node<As>>...> sources_)
 				: _func { std::move(func_) }
 				, _sources { std::move(sources_) }
 			{
 			}
 
+			~operator_node()
+			{
+				release_sources(_sources, SEQ);
+			}
+
 			R call_underlying_func(std::tuple<As...>& args_) const
 			{
 				return _call_impl(args_, SEQ);
@@ -149,21 +723,17 @@ namespace reactive_framework8
 
 		private:
 			std::function<R(As...)> _func;
-			std::tuple<std::weak_ptr<node<As>>...> _sources;
+			std::tuple<std::shared_ptr<node<As>>...> _sources;
 
 			template<size_t... Ns> boost::optional<std::tuple<As...>> _args(std::index_sequence<Ns...>) const
 			{
 				using namespace utility;
 
-				auto locked_inputs = std::make_tuple(std::get<Ns>(_sources).lock() ...);
-
-				bool any_expired = or(std::get<Ns>(locked_inputs) == nullptr...);
-
-				bool all_valid = !any_expired && and(std::get<Ns>(locked_inputs)->value().is_initialized()...);
+				bool all_valid = and(std::get<Ns>(_sources)->value().is_initialized()...);
 
 				if (!all_valid) return { };
 
-				return std::make_tuple(std::get<Ns>(locked_inputs)->value().get()...);
+				return std::make_tuple(std::get<Ns>(_sources)->value().get()...);
 			}
 
 			template<size_t... Ns> R _call_impl(std::tuple<As...>& args_, std::index_sequence<Ns...>) const
@@ -175,7 +745,7 @@ namespace reactive_framework8
 		template<class R, class... As> class map_operator_node : public operator_node<R(As...), R>
 		{
 		public:
-			map_operator_node(std::function<R(As...)> func_, std::tuple<std::weak_ptr<node<As>>...> sources_)
+			map_operator_node(std::function<R(As...)> func_, std::tuple<std::shared_ptr<node<As>>...> sources_)
 				: operator_node { std::move(func_), std::move(sources_) }
 			{
 			}
@@ -195,7 +765,7 @@ namespace reactive_framework8
 		template<class T> class filter_operator_node : public operator_node<bool(T), T>
 		{
 		public:
-			filter_operator_node(std::function<bool(T)> func_, std::weak_ptr<node<T>> source_)
+			filter_operator_node(std::function<bool(T)> func_, std::shared_ptr<node<T>> source_)
 				: operator_node{ std::move(func_), std::make_tuple(source_) }
 			{
 
@@ -213,5 +783,123 @@ namespace reactive_framework8
 				return { };
 			}
 		};
+
+		//
+		//	a map without type erasure: the callable is kept by value, the inputs are passed to
+		//	it by const reference right from the sources, they are held by the operator
+		//
+		template<class F, class R, class... As> class direct_map_operator_node : public node<R>
+		{
+		public:
+			direct_map_operator_node(F func_, std::shared_ptr<node<As>>... sources_)
+				: _func { std::move(func_) }
+				, _sources { std::move(sources_)... }
+			{
+			}
+
+			~direct_map_operator_node()
+			{
+				release_sources(_sources, std::index_sequence_for<As...> { });
+			}
+
+		private:
+			mutable F _func;
+			std::tuple<std::shared_ptr<node<As>>...> _sources;
+
+			boost::optional<R> _re_calc() const override
+			{
+				return _call(std::index_sequence_for<As...> { });
+			}
+
+			template<size_t... Ns> boost::optional<R> _call(std::index_sequence<Ns...>) const
+			{
+				using namespace utility;
+
+				if (!and(std::get<Ns>(_sources)->value().is_initialized()...))
+				{
+					return { };
+				}
+
+				return _func(*std::get<Ns>(_sources)->value()...);
+			}
+		};
+
+		//
+		//	the stages of a fused chain, see rv_chain: a stage maps the value of the source
+		//	to an optional result, an empty one drops the value
+		//
+		template<class T> struct chain_source
+		{
+			boost::optional<T> operator()(const T& value_) const
+			{
+				return value_;
+			}
+		};
+
+		template<class T, class R, class S, class F> struct fused_map
+		{
+			S stage;
+			F func;
+
+			boost::optional<R> operator()(const T& value_) const
+			{
+				auto value = stage(value_);
+
+				if (!value)
+				{
+					return { };
+				}
+
+				return func(std::move(*value));
+			}
+		};
+
+		template<class T, class R, class S, class P> struct fused_filter
+		{
+			S stage;
+			P pred;
+
+			boost::optional<R> operator()(const T& value_) const
+			{
+				auto value = stage(value_);
+
+				if (!value || !pred(*value))
+				{
+					return { };
+				}
+
+				return value;
+			}
+		};
+
+		//	one operator node for all the stages of a chain, they are called without type erasure
+		template<class T, class R, class S> class chain_operator_node : public node<R>
+		{
+		public:
+			chain_operator_node(S stage_, std::shared_ptr<node<T>> ptr_source_)
+				: _stage { std::move(stage_) }
+				, _ptr_source { std::move(ptr_source_) }
+			{
+			}
+
+			~chain_operator_node()
+			{
+				release_source(std::move(_ptr_source));
+			}
+
+		private:
+			S _stage;
+			std::shared_ptr<node<T>> _ptr_source;
+
+			boost::optional<R> _re_calc() const override
+			{
+				if (!_ptr_source->value())
+				{
+					return { };
+				}
+
+				return _stage(*_ptr_source->value());
+			}
+		};
 	}
 }
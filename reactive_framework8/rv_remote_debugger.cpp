@@ -21,7 +21,11 @@ string EMPTY_STRING;
 
 rv_remote_debugger::rv_remote_debugger()
 	: _client { "localhost", desc { "8000" } }
+	, _send_queue { _client, 4 * send_queue::DEFAULT_MAX_QUEUED_BYTES, OVERFLOW_POLICY_DROP_OLDEST }
+	, _writer { _send_queue }
 {
+	// the send queue batches the events, Nagle would only delay them further
+	_client.set_no_delay(true);
 }
 
 rv_remote_debugger::~rv_remote_debugger()
@@ -40,7 +44,7 @@ void rv_remote_debugger::notify_value_change(string rv_name_, string value_)
 
 	pt::json_parser::write_json(json_stream, ptree);
 
-	_client.write(json_stream.str().c_str(), json_stream.str().length());	
+	_send(json_stream.str());	
 }
 
 void rv_remote_debugger::notify_rv_assigned_to(std::string rv_name_)
@@ -57,7 +61,7 @@ void rv_remote_debugger::notify_rv_assigned_to(std::string rv_name_)
 
 		pt::json_parser::write_json(json_stream, ptree);
 
-		_client.write(json_stream.str().c_str(), json_stream.str().length());
+		_send(json_stream.str());
 	}
 }
 
@@ -76,7 +80,7 @@ void rv_remote_debugger::notify_new_operator(std::string op_name_)
 
 		pt::json_parser::write_json(json_stream, ptree);
 
-		_client.write(json_stream.str().c_str(), json_stream.str().length());
+		_send(json_stream.str());
 	}
 }
 
@@ -93,7 +97,7 @@ void rv_remote_debugger::add_edge_from(void* node_ptr_, std::type_index node_typ
 
 	pt::json_parser::write_json(json_stream, ptree);
 
-	_client.write(json_stream.str().c_str(), json_stream.str().length());
+	_send(json_stream.str());
 }
 
 void rv_remote_debugger::add_edge_to(void* operator_ptr_, std::type_index operator_type_, void* node_ptr_, std::type_index node_type_)
@@ -109,5 +113,12 @@ void rv_remote_debugger::add_edge_to(void* operator_ptr_, std::type_index operat
 
 	pt::json_parser::write_json(json_stream, ptree);
 
-	_client.write(json_stream.str().c_str(), json_stream.str().length());
+	_send(json_stream.str());
+}
+
+void rv_remote_debugger::_send(const string& json_)
+{
+	lock_guard<mutex> lock { _mtx_send };
+
+	_writer.write(json_.data(), json_.size());
 }
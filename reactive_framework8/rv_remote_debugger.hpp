@@ -2,6 +2,9 @@
 #include "stdafx.h"
 #include "rv_abstract_debugger.hpp"
 
+#include <utility\framing.hpp>
+#include <utility\send_queue.hpp>
+
 namespace reactive_framework8
 {
 	struct tcp_message;
@@ -22,9 +25,19 @@ namespace reactive_framework8
 	private:
 		utility::client _client;
 
+		//	the graph only queues the events, so a slow viewer can't stall it,
+		//	a burst of them is sent by a few large writes
+		utility::send_queue _send_queue;
+
+		//	every event is sent as a length-prefixed frame, by one thread at a time
+		std::mutex _mtx_send;
+		utility::frame_writer _writer;
+
 		std::unordered_set<std::string> _known_objects;
 
 		void _send_message(tcp_message&);
+
+		void _send(const std::string& json_);
 	};
 
 }
@@ -0,0 +1,405 @@
+#pragma once
+#include "stdafx.h"
+
+#include "rv_clock.hpp"
+#include "rv_graph.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace reactive_framework8
+{
+	//	the edges of a burst of changes passed by rv_builder::debounce
+	enum E_DEBOUNCE
+	{
+		//	the last value, once the source hasn't changed for dt
+		DEBOUNCE_TRAILING,
+
+		//	the first value at once, if the source hadn't changed for dt before it, and the
+		//	last one as well, if there were others
+		DEBOUNCE_LEADING_AND_TRAILING,
+	};
+
+	namespace graph
+	{
+		//
+		//	the timers of the nodes of a context, it's closed by the destructor of the context,
+		//	which waits for the running timers, so no timer changes a node after it
+		//	The waves of the timers are posted to a thread of the scope, which runs them one by
+		//	one, so the thread of a clock shared by the contexts is never blocked by a wave. A
+		//	synchronous clock runs them on its calling thread, see rv_clock::is_synchronous.
+		//
+		class timer_scope : public std::enable_shared_from_this<timer_scope>
+		{
+		public:
+			timer_scope() = default;
+
+			timer_scope(const timer_scope&) = delete;
+			timer_scope& operator=(const timer_scope&) = delete;
+
+			//	it's ignored once the scope is closed
+			void post(std::function<void()> fire_, bool is_synchronous_);
+
+			//	the posted fires are dropped, the running ones are waited for
+			void close();
+
+		private:
+			std::mutex _mutex;
+			std::condition_variable _changed;
+
+			bool _is_open = true;
+			size_t _count_of_running = 0;
+
+			std::deque<std::function<void()>> _fires;
+
+			//	it's started by the first posted fire, and holds the scope until it's closed
+			std::thread _thread;
+
+			void _run();
+			void _end_fire();
+		};
+
+		//
+		//	an operator whose value is changed by the timers of a clock as well, see rv_clock
+		//	A change of the source is handled by _on_change, a timer by _on_timer, they return
+		//	the new value if there's one. A timer is handled in a wave of its own, which is
+		//	posted to the timer_scope, so the state of the node is only touched by one wave at
+		//	a time.
+		//	T: the type of the source, R: the type of the result
+		//
+		template<class T, class R> class timed_operator_node : public node<R>, public std::enable_shared_from_this<timed_operator_node<T, R>>
+		{
+		public:
+			timed_operator_node(std::shared_ptr<rv_clock> ptr_clock_, std::shared_ptr<timer_scope> ptr_scope_
+				, std::shared_ptr<node<T>> ptr_source_)
+				: _ptr_clock { std::move(ptr_clock_) }
+				, _ptr_scope { std::move(ptr_scope_) }
+				, _ptr_source { std::move(ptr_source_) }
+				, _changes { *_ptr_source }
+			{
+			}
+
+			~timed_operator_node()
+			{
+				_cancel();
+
+				release_source(std::move(_ptr_source));
+			}
+
+		protected:
+			std::shared_ptr<rv_clock> _ptr_clock;
+
+			//	the node is changed at at_, instead of the current timer
+			void _schedule(rv_clock::time_point at_)
+			{
+				_cancel();
+
+				const size_t tick = ++_tick;
+				const bool is_synchronous = _ptr_clock->is_synchronous();
+				const auto ptr_scope = _ptr_scope;
+				const std::weak_ptr<timed_operator_node> ptr_self = this->shared_from_this();
+
+				_timer_id = _ptr_clock->schedule(at_, [=]
+				{
+					ptr_scope->post([=]
+					{
+						if (auto ptr_node = ptr_self.lock())
+						{
+							ptr_node->_fire(tick);
+						}
+					}, is_synchronous);
+				});
+			}
+
+			bool _is_scheduled() const
+			{
+				return _timer_id != 0;
+			}
+
+			void _cancel()
+			{
+				if (_timer_id != 0)
+				{
+					_ptr_clock->cancel(_timer_id);
+					_timer_id = 0;
+				}
+
+				++_tick;
+			}
+
+		private:
+			std::shared_ptr<timer_scope> _ptr_scope;
+			std::shared_ptr<node<T>> _ptr_source;
+			mutable change_reader<T> _changes;
+
+			size_t _timer_id = 0;
+
+			//	a cancelled timer can be running already, it's ignored by its tick
+			size_t _tick = 0;
+
+			virtual boost::optional<R> _on_change(const T& value_) = 0;
+			virtual boost::optional<R> _on_timer() = 0;
+
+			void _fire(size_t tick_)
+			{
+				auto ptr_rc = this->_context();
+
+				ptr_rc->begin_change();
+
+				try
+				{
+					if (tick_ == _tick)
+					{
+						_timer_id = 0;
+
+						auto new_val = _on_timer();
+
+						//	it joins the wave
+						if (new_val)
+						{
+							this->set_value(std::move(*new_val));
+						}
+					}
+				}
+				catch (...)
+				{
+					ptr_rc->end_change(*this, false);
+					throw;
+				}
+
+				ptr_rc->end_change(*this, false);
+			}
+
+			//	every change of the source is handled, the ones of a batch too, the last new value is the result
+			boost::optional<R> _re_calc() const override
+			{
+				auto ptr_self = const_cast<timed_operator_node*>(this);
+
+				boost::optional<R> result;
+
+				for (const auto& value : _changes.read(*_ptr_source))
+				{
+					auto new_val = ptr_self->_on_change(value);
+
+					if (new_val)
+					{
+						result = std::move(new_val);
+					}
+				}
+
+				return result;
+			}
+		};
+
+		//	the last value of a burst of changes, once the source hasn't changed for dt, and its
+		//	first one at once by DEBOUNCE_LEADING_AND_TRAILING
+		template<class T> class debounce_operator_node : public timed_operator_node<T, T>
+		{
+		public:
+			debounce_operator_node(std::shared_ptr<rv_clock> ptr_clock_, std::shared_ptr<timer_scope> ptr_scope_
+				, std::shared_ptr<node<T>> ptr_source_, rv_clock::duration dt_, E_DEBOUNCE edges_ = DEBOUNCE_TRAILING)
+				: timed_operator_node<T, T>(std::move(ptr_clock_), std::move(ptr_scope_), std::move(ptr_source_))
+				, _dt { dt_ }
+				, _edges { edges_ }
+			{
+			}
+
+		private:
+			rv_clock::duration _dt;
+			E_DEBOUNCE _edges;
+
+			//	a burst lasts until the source hasn't changed for dt
+			bool _is_in_burst = false;
+			boost::optional<T> _pending;
+
+			boost::optional<T> _on_change(const T& value_) override
+			{
+				this->_schedule(this->_ptr_clock->now() + _dt);
+
+				if (!_is_in_burst && _edges == DEBOUNCE_LEADING_AND_TRAILING)
+				{
+					_is_in_burst = true;
+					return value_;
+				}
+
+				_is_in_burst = true;
+				_pending = value_;
+
+				return { };
+			}
+
+			boost::optional<T> _on_timer() override
+			{
+				auto value = std::move(_pending);
+				_pending = boost::none;
+				_is_in_burst = false;
+
+				return value;
+			}
+		};
+
+		//	at most one value per dt: the first change of a period is passed at once, the last one at its end
+		template<class T> class throttle_operator_node : public timed_operator_node<T, T>
+		{
+		public:
+			throttle_operator_node(std::shared_ptr<rv_clock> ptr_clock_, std::shared_ptr<timer_scope> ptr_scope_
+				, std::shared_ptr<node<T>> ptr_source_, rv_clock::duration dt_)
+				: timed_operator_node<T, T>(std::move(ptr_clock_), std::move(ptr_scope_), std::move(ptr_source_))
+				, _dt { dt_ }
+			{
+			}
+
+		private:
+			rv_clock::duration _dt;
+
+			//	the end of the current period
+			boost::optional<rv_clock::time_point> _end;
+			boost::optional<T> _pending;
+
+			boost::optional<T> _on_change(const T& value_) override
+			{
+				const auto now = this->_ptr_clock->now();
+
+				if (!_end || now >= *_end)
+				{
+					//	the timer of the last period can be late
+					_pending = boost::none;
+					this->_cancel();
+
+					_end = now + _dt;
+					return value_;
+				}
+
+				_pending = value_;
+
+				if (!this->_is_scheduled())
+				{
+					this->_schedule(*_end);
+				}
+
+				return { };
+			}
+
+			boost::optional<T> _on_timer() override
+			{
+				auto value = std::move(_pending);
+				_pending = boost::none;
+
+				//	the trailing value starts a period too
+				_end = this->_ptr_clock->now() + _dt;
+
+				return value;
+			}
+		};
+
+		//
+		//	the value of the source at the ticks of a fixed period, which starts with its first
+		//	value, it's passed at once. The clock isn't ticking while the source is unchanged.
+		//
+		template<class T> class sample_operator_node : public timed_operator_node<T, T>
+		{
+		public:
+			sample_operator_node(std::shared_ptr<rv_clock> ptr_clock_, std::shared_ptr<timer_scope> ptr_scope_
+				, std::shared_ptr<node<T>> ptr_source_, rv_clock::duration period_)
+				: timed_operator_node<T, T>(std::move(ptr_clock_), std::move(ptr_scope_), std::move(ptr_source_))
+				, _period { period_ }
+			{
+			}
+
+		private:
+			rv_clock::duration _period;
+
+			boost::optional<rv_clock::time_point> _start;
+			boost::optional<T> _pending;
+
+			boost::optional<T> _on_change(const T& value_) override
+			{
+				const auto now = this->_ptr_clock->now();
+
+				if (!_start)
+				{
+					_start = now;
+					return value_;
+				}
+
+				_pending = value_;
+
+				if (!this->_is_scheduled())
+				{
+					const auto periods = (now - *_start) / _period + 1;
+
+					this->_schedule(*_start + periods * _period);
+				}
+
+				return { };
+			}
+
+			boost::optional<T> _on_timer() override
+			{
+				auto value = std::move(_pending);
+				_pending = boost::none;
+
+				return value;
+			}
+		};
+
+		//
+		//	the values of the source within the last duration in the order of their change,
+		//	the window is slid by the changes and by the expiry of its oldest value
+		//
+		template<class T> class window_operator_node : public timed_operator_node<T, std::vector<T>>
+		{
+		public:
+			window_operator_node(std::shared_ptr<rv_clock> ptr_clock_, std::shared_ptr<timer_scope> ptr_scope_
+				, std::shared_ptr<node<T>> ptr_source_, rv_clock::duration duration_)
+				: timed_operator_node<T, std::vector<T>>(std::move(ptr_clock_), std::move(ptr_scope_), std::move(ptr_source_))
+				, _duration { duration_ }
+			{
+			}
+
+		private:
+			rv_clock::duration _duration;
+
+			std::deque<std::pair<rv_clock::time_point, T>> _values;
+
+			boost::optional<std::vector<T>> _on_change(const T& value_) override
+			{
+				const auto now = this->_ptr_clock->now();
+
+				_values.emplace_back(now, value_);
+
+				return _slide(now);
+			}
+
+			boost::optional<std::vector<T>> _on_timer() override
+			{
+				return _slide(this->_ptr_clock->now());
+			}
+
+			std::vector<T> _slide(rv_clock::time_point now_)
+			{
+				while (!_values.empty() && _values.front().first + _duration <= now_)
+				{
+					_values.pop_front();
+				}
+
+				if (!_values.empty() && !this->_is_scheduled())
+				{
+					this->_schedule(_values.front().first + _duration);
+				}
+
+				std::vector<T> values;
+				values.reserve(_values.size());
+
+				for (const auto& value : _values)
+				{
+					values.push_back(value.second);
+				}
+
+				return values;
+			}
+		};
+	}
+}
@@ -58,24 +58,24 @@ namespace reactive_framework8_debugger
 			
 			OnConnected?.Invoke(this, new EventArgs());
 
-			TextReader textReader = new StreamReader(network.DataStream, Encoding.ASCII);
-			JsonTextReader jsonTextReader = new JsonTextReader(textReader);
-			jsonTextReader.SupportMultipleContent = true;
-
 			while(!_connectionWorker.CancellationPending)
 			{
 				try
 				{
-					bool hasNext = jsonTextReader.Read(); // probably ignores the next "end token"
-					if (!hasNext)
+					// every message arrives in its own frame
+					var frame = network.ReadFrame();
+					if (frame == null)
 					{
-						continue;
+						break;
 					}
 
-					var msg = _jsonSerializer.Deserialize<Message>(jsonTextReader);
+					using (var jsonTextReader = new JsonTextReader(new StringReader(Encoding.ASCII.GetString(frame))))
+					{
+						var msg = _jsonSerializer.Deserialize<Message>(jsonTextReader);
 
-					//
-					OnHaveNewMessage?.Invoke(this, msg);
+						//
+						OnHaveNewMessage?.Invoke(this, msg);
+					}
 				}
 				catch(Exception e_)
 				{
@@ -86,12 +86,6 @@ namespace reactive_framework8_debugger
 			network.Dispose();
 			network = null;
 
-			textReader.Close();
-			jsonTextReader.Close();
-
-			textReader = null;
-			jsonTextReader = null;
-
 			e.Cancel = true;
 		}
 
@@ -19,6 +19,8 @@ namespace reactive_framework8_debugger
 
 		private NetworkStream _networkStream;
 
+		private const ulong MaxFrameSize = 16 * 1024 * 1024;
+
 		public Network()
 		{
 		}
@@ -89,6 +91,56 @@ namespace reactive_framework8_debugger
 			_networkStream = new NetworkStream(_serverSocket);
 		}
 
+		//
+		//	reads a length-prefixed frame: [varint: size of the payload][payload]
+		//	returns null if the peer has disconnected
+		//
+		public byte[] ReadFrame()
+		{
+			ulong size = 0;
+
+			for (int shift = 0; ; shift += 7)
+			{
+				if (shift >= 64)
+				{
+					throw new InvalidDataException("Too long frame prefix");
+				}
+
+				int b = _networkStream.ReadByte();
+				if (b < 0)
+				{
+					return null;
+				}
+
+				size |= (ulong)(b & 0x7F) << shift;
+
+				if ((b & 0x80) == 0)
+				{
+					break;
+				}
+			}
+
+			if (size > MaxFrameSize)
+			{
+				throw new InvalidDataException("Too large frame: " + size);
+			}
+
+			var frame = new byte[size];
+
+			for (int offset = 0; offset < frame.Length;)
+			{
+				int count = _networkStream.Read(frame, offset, frame.Length - offset);
+				if (count == 0)
+				{
+					return null;
+				}
+
+				offset += count;
+			}
+
+			return frame;
+		}
+
 		public void Dispose()
 		{
 			Disconnect();
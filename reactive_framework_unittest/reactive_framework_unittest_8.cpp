@@ -19,6 +19,14 @@ using namespace std;
 
 #if ENABLE_REACTIVE_FRAMEWORK_7_TEST
 #include <reactive_framework8\rv>
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
 auto a = _1;
 
 namespace reactive_framework8_unittest
@@ -26,6 +34,46 @@ namespace reactive_framework8_unittest
 	using namespace reactive_framework8;
 	using namespace utility;
 
+	//	trivially copyable, its snapshots are published by the seqlock
+	struct pair_of_ints
+	{
+		int n;
+		int twice;
+	};
+
+	ostream& operator<<(ostream& os_, const pair_of_ints& p_)
+	{
+		return os_ << p_.n << ", " << p_.twice;
+	}
+
+	//	counts its copies, it's published as an immutable copy
+	struct counted_copies
+	{
+		static atomic<int> count_of_copies;
+
+		int n;
+
+		counted_copies(int n_)
+			: n { n_ }
+		{
+		}
+
+		counted_copies(const counted_copies& other_)
+			: n { other_.n }
+		{
+			++count_of_copies;
+		}
+
+		counted_copies& operator=(const counted_copies&) = default;
+	};
+
+	atomic<int> counted_copies::count_of_copies { 0 };
+
+	ostream& operator<<(ostream& os_, const counted_copies& c_)
+	{
+		return os_ << c_.n;
+	}
+
 	TEST_CLASS(reactive_framework8_high_level_unittest)
 	{
 	public:
@@ -38,6 +86,43 @@ namespace reactive_framework8_unittest
 			return *opt_;
 		}
 
+		//	count_ rvs over random earlier ones after the sources, the filters keep a history
+		static vector<rv<int>> build_random_graph(rv_context& rc_, unsigned seed_, size_t count_of_sources_, size_t count_, bool with_filters_)
+		{
+			mt19937 random { seed_ };
+
+			vector<rv<int>> rvs;
+			rvs.reserve(count_of_sources_ + count_);
+
+			for (size_t i = 0; i < count_of_sources_; ++i)
+			{
+				rvs.emplace_back(0);
+			}
+
+			for (size_t i = 0; i < count_; ++i)
+			{
+				auto& a = rvs[random() % rvs.size()];
+				auto& b = rvs[random() % rvs.size()];
+
+				switch (random() % (with_filters_ ? 3 : 2))
+				{
+				case 0:
+					rvs.emplace_back(rc_.map([](int a_, int b_) { return (a_ * 31 + b_) % 1000003; }, a, b));
+					break;
+
+				case 1:
+					rvs.emplace_back(rc_.map([](int n_) { return n_ + 7; }, a));
+					break;
+
+				default:
+					rvs.emplace_back(rc_.filter([](int n_) { return n_ % 3 != 0; }, a));
+					break;
+				}
+			}
+
+			return rvs;
+		}
+
 		TEST_METHOD(TestMap)
 		{
 			rv_context rc;
@@ -448,6 +533,1012 @@ namespace reactive_framework8_unittest
 
 			Assert::AreEqual(1, get(b.value()));
 		}
+
+		TEST_METHOD(test_diamond_is_recomputed_once_per_change)
+		{
+			rv_context rc;
+
+			rv<int> a { 1 };
+			rv<int> b = rc.map([](int n_) { return n_ + 1; }, a);
+			rv<int> c = rc.map([](int n_) { return n_ * 2; }, a);
+
+			int count_of_calls = 0;
+
+			rv<int> d = rc.map([&](int b_, int c_)
+			{
+				++count_of_calls;
+				return b_ + c_;
+			}, b, c);
+
+			std::vector<int> values_of_d;
+			d.subscribe([&](int n_) { values_of_d.push_back(n_); });
+
+			count_of_calls = 0;
+
+			a = 2;
+			a = 3;
+
+			//	d never sees the new b with the old c
+			const std::vector<int> expected_values_of_d { 3 + 4, 4 + 6 };
+
+			Assert::AreEqual(expected_values_of_d, values_of_d);
+			Assert::AreEqual(2, count_of_calls);
+		}
+
+		TEST_METHOD(test_batch_propagates_once)
+		{
+			rv_context rc;
+
+			rv<int> a { 0 }, b { 0 };
+
+			int count_of_calls = 0;
+
+			rv<int> c = rc.map([&](int a_, int b_)
+			{
+				++count_of_calls;
+				return a_ + b_;
+			}, a, b);
+
+			count_of_calls = 0;
+
+			rc.batch([&]
+			{
+				a = 1;
+				b = 2;
+				a = 3;
+
+				//	nothing is recomputed before the end of the batch
+				Assert::AreEqual(0, get(c.value()));
+			});
+
+			Assert::AreEqual(5, get(c.value()));
+			Assert::AreEqual(1, count_of_calls);
+		}
+
+		TEST_METHOD(test_nested_transactions_propagate_by_the_outermost)
+		{
+			rv_context rc;
+
+			rv<int> a { 0 }, b { 0 };
+			rv<int> c = rc.map([](int a_, int b_) { return a_ * b_; }, a, b);
+
+			{
+				rv_transaction outer { rc };
+
+				a = 2;
+
+				{
+					rv_transaction inner { rc };
+
+					b = 3;
+
+					inner.commit();
+				}
+
+				Assert::AreEqual(0, get(c.value()));
+
+				outer.commit();
+
+				Assert::AreEqual(6, get(c.value()));
+			}
+
+			//	the destructor commits too
+			{
+				rv_transaction transaction { rc };
+
+				a = 5;
+			}
+
+			Assert::AreEqual(15, get(c.value()));
+		}
+
+		TEST_METHOD(test_change_waits_for_the_transaction_of_another_thread)
+		{
+			rv_context rc;
+
+			rv<int> a { 0 }, b { 0 };
+			rv<int> c = rc.map([](int a_, int b_) { return a_ + b_; }, a, b);
+
+			atomic<bool> is_changed { false };
+			int seen = 0;
+
+			rv_transaction transaction { rc };
+
+			a = 1;
+
+			thread other { [&]
+			{
+				b = 2;
+
+				//	the change returns when it's propagated
+				seen = get(c.value());
+				is_changed = true;
+			} };
+
+			this_thread::sleep_for(chrono::milliseconds { 50 });
+
+			Assert::IsFalse(is_changed.load());
+
+			transaction.commit();
+			other.join();
+
+			Assert::AreEqual(3, seen);
+			Assert::AreEqual(3, get(c.value()));
+		}
+
+		TEST_METHOD(test_transaction_of_a_parallel_subscriber_joins_the_wave)
+		{
+			const int COUNT_OF_BRANCHES = 64;
+
+			rv_context rc { EXECUTION_POLICY_PARALLEL, 4 };
+
+			rv<int> source { 0 };
+
+			vector<rv<int>> branches, outputs, doubled;
+			branches.reserve(COUNT_OF_BRANCHES);
+			outputs.reserve(COUNT_OF_BRANCHES);
+			doubled.reserve(COUNT_OF_BRANCHES);
+
+			for (int i = 0; i < COUNT_OF_BRANCHES; ++i)
+			{
+				outputs.emplace_back(0);
+				doubled.emplace_back(rc.map([](int n_) { return n_ * 2; }, outputs.back()));
+			}
+
+			//	the branches are of the same height, so the subscribers are called on the threads of the pool
+			for (int i = 0; i < COUNT_OF_BRANCHES; ++i)
+			{
+				branches.emplace_back(rc.map([i](int n_) { return n_ + i; }, source));
+
+				auto& output = outputs[i];
+
+				branches.back().subscribe([&rc, &output](int n_)
+				{
+					rc.batch([&] { output = n_; });
+				});
+			}
+
+			for (int round = 1; round <= 200; ++round)
+			{
+				source = round;
+
+				for (int i = 0; i < COUNT_OF_BRANCHES; ++i)
+				{
+					Assert::AreEqual(2 * (round + i), get(doubled[i].value()));
+				}
+			}
+		}
+
+		TEST_METHOD(test_parallel_policy_matches_the_sequential_one)
+		{
+			const unsigned SEED = 20161019;
+			const size_t COUNT_OF_SOURCES = 8;
+
+			rv_context sequential;
+			rv_context parallel { EXECUTION_POLICY_PARALLEL, 4 };
+
+			auto expected = build_random_graph(sequential, SEED, COUNT_OF_SOURCES, 300, true);
+			auto given = build_random_graph(parallel, SEED, COUNT_OF_SOURCES, 300, true);
+
+			mt19937 random { SEED };
+
+			for (int round = 0; round < 200; ++round)
+			{
+				vector<pair<size_t, int>> writes;
+
+				for (size_t i = 1 + random() % 4; i > 0; --i)
+				{
+					writes.emplace_back(random() % COUNT_OF_SOURCES, static_cast<int>(random() % 1000));
+				}
+
+				auto write = [&](vector<rv<int>>& rvs_)
+				{
+					for (auto& w : writes)
+					{
+						rvs_[w.first] << w.second;
+					}
+				};
+
+				if (round % 2)
+				{
+					sequential.batch([&] { write(expected); });
+					parallel.batch([&] { write(given); });
+				}
+				else
+				{
+					write(expected);
+					write(given);
+				}
+
+				for (size_t i = 0; i < expected.size(); ++i)
+				{
+					Assert::IsTrue(expected[i].value() == given[i].value());
+				}
+			}
+		}
+
+		TEST_METHOD(test_parallel_policy_takes_concurrent_changes)
+		{
+			const unsigned SEED = 1337;
+			const size_t COUNT_OF_SOURCES = 8;
+			const size_t COUNT_OF_WRITERS = 4;
+
+			rv_context sequential;
+			rv_context parallel { EXECUTION_POLICY_PARALLEL, 4 };
+
+			auto expected = build_random_graph(sequential, SEED, COUNT_OF_SOURCES, 300, false);
+			auto given = build_random_graph(parallel, SEED, COUNT_OF_SOURCES, 300, false);
+
+			vector<int> last_values(COUNT_OF_SOURCES);
+			vector<thread> writers;
+
+			//	every writer has its own sources
+			for (size_t w = 0; w < COUNT_OF_WRITERS; ++w)
+			{
+				writers.emplace_back([&, w]
+				{
+					mt19937 random { SEED + static_cast<unsigned>(w) };
+
+					for (int i = 0; i < 100; ++i)
+					{
+						const size_t source = w + COUNT_OF_WRITERS * (random() % (COUNT_OF_SOURCES / COUNT_OF_WRITERS));
+						const int value = static_cast<int>(random() % 1000);
+
+						given[source] << value;
+						last_values[source] = value;
+					}
+				});
+			}
+
+			for (auto& t : writers)
+			{
+				t.join();
+			}
+
+			//	without filters the values only depend on the last values of the sources
+			for (size_t i = 0; i < COUNT_OF_SOURCES; ++i)
+			{
+				expected[i] << last_values[i];
+			}
+
+			for (size_t i = 0; i < expected.size(); ++i)
+			{
+				Assert::IsTrue(expected[i].value() == given[i].value());
+			}
+		}
+
+		TEST_METHOD(test_unchanged_value_stops_the_propagation)
+		{
+			rv_context rc;
+
+			rv<int> a { 0 };
+			rv<int> tens = rc.map([](int n_) { return n_ / 10; }, a);
+
+			int count_of_calls = 0;
+			rv<int> b = rc.map([&](int n_) { ++count_of_calls; return n_ * 2; }, tens);
+
+			int count_of_notifications = 0;
+			tens.subscribe([&](int) { ++count_of_notifications; });
+
+			count_of_calls = 0;
+
+			for (int i = 1; i < 10; ++i)
+			{
+				a = i;
+			}
+
+			a = 9;
+
+			Assert::AreEqual(0, count_of_calls);
+			Assert::AreEqual(0, count_of_notifications);
+
+			a = 25;
+
+			Assert::AreEqual(1, count_of_calls);
+			Assert::AreEqual(1, count_of_notifications);
+			Assert::AreEqual(4, get(b.value()));
+		}
+
+		TEST_METHOD(test_comparator_and_hash_decide_the_cutoff)
+		{
+			rv_context rc;
+
+			rv<float> a { 0.f };
+			rv<float> b = rc.map([](float n_) { return n_; }, a);
+			b.set_comparator([](const float& old_, const float& new_) { return fabs(old_ - new_) < 0.5f; });
+
+			int count_of_calls = 0;
+			rv<float> c = rc.map([&](float n_) { ++count_of_calls; return n_; }, b);
+
+			count_of_calls = 0;
+
+			a = 0.25f;
+			Assert::AreEqual(0, count_of_calls);
+			Assert::AreEqual(0.f, get(b.value()));
+
+			a = 1.f;
+			Assert::AreEqual(1, count_of_calls);
+			Assert::AreEqual(1.f, get(c.value()));
+
+			//	the hash of the case insensitive text
+			rv<string> text { string { "Hello" } };
+			text.set_hash([](const string& s_)
+			{
+				string lower;
+				transform(s_.begin(), s_.end(), back_inserter(lower), ::tolower);
+				return hash<string> { }(lower);
+			});
+
+			int count_of_changes = 0;
+			text.subscribe([&](string) { ++count_of_changes; });
+
+			text = string { "HELLO" };
+			Assert::AreEqual(0, count_of_changes);
+			Assert::AreEqual(string { "Hello" }, get(text.value()));
+
+			text = string { "world" };
+			Assert::AreEqual(1, count_of_changes);
+		}
+
+		TEST_METHOD(test_height_follows_the_longest_path)
+		{
+			rv_context rc;
+
+			auto inc = [](int n_) { return n_ + 1; };
+
+			rv<int> a { 0 };
+			rv<int> b = rc.map(inc, a);
+			rv<int> c = rc.map(inc, b);
+
+			//	the short path to d is joined by the long one
+			rv<int> d = rc.map([](int a_, int c_) { return a_ + c_; }, a, c);
+
+			Assert::IsTrue(a._ptr_impl->height < b._ptr_impl->height);
+			Assert::IsTrue(b._ptr_impl->height < c._ptr_impl->height);
+			Assert::IsTrue(c._ptr_impl->height < d._ptr_impl->height);
+
+			const auto recomputes = graph::recompute_counter().value();
+
+			a = 10;
+
+			Assert::AreEqual(22, get(d.value()));
+
+			//	3 operators and 3 value nodes
+			Assert::AreEqual(int64_t { 6 }, graph::recompute_counter().value() - recomputes);
+		}
+
+		TEST_METHOD(test_fused_chain_is_one_operator)
+		{
+			rv_context rc;
+
+			rv<int> a { 1 };
+			rv<string> b = rc.from(a)
+				.filter([](int n_) { return n_ % 2 != 0; })
+				.map([](int n_) { return n_ + 1; })
+				.map([](int n_) { return n_ * 10; })
+				.map([](int n_) { return to_string(n_); });
+
+			Assert::AreEqual(string { "20" }, get(b.value()));
+
+			const auto recomputes = graph::recompute_counter().value();
+
+			a = 3;
+			Assert::AreEqual(string { "40" }, get(b.value()));
+
+			//	1 operator and 1 value node for all the stages
+			Assert::AreEqual(int64_t { 2 }, graph::recompute_counter().value() - recomputes);
+
+			//	dropped by the filter
+			a = 4;
+			Assert::AreEqual(string { "40" }, get(b.value()));
+
+			//	the chain can be continued from any stage
+			auto odd = rc.from(a).filter([](int n_) { return n_ % 2 != 0; });
+
+			rv<int> c = odd.map([](int n_) { return -n_; });
+			rv<int> d = odd.as();
+
+			a = 5;
+			Assert::AreEqual(-5, get(c.value()));
+			Assert::AreEqual(5, get(d.value()));
+			Assert::AreEqual(string { "60" }, get(b.value()));
+		}
+
+		TEST_METHOD(test_lazy_subgraph_is_recomputed_when_read)
+		{
+			rv_context rc;
+
+			rv<int> a { 1 };
+
+			int count_of_calls = 0;
+
+			rc.set_evaluation(EVALUATION_LAZY);
+
+			rv<int> b = rc.map([&](int n_) { ++count_of_calls; return n_ * 2; }, a);
+			rv<int> c = rc.map([&](int n_) { ++count_of_calls; return n_ + 1; }, b);
+
+			rc.set_evaluation(EVALUATION_EAGER);
+
+			//	eager, so it pulls b in every wave
+			rv<int> d = rc.map([](int n_) { return -n_; }, b);
+
+			count_of_calls = 0;
+
+			a = 2;
+			a = 3;
+
+			//	only b is pulled by d
+			Assert::AreEqual(2, count_of_calls);
+			Assert::AreEqual(-6, get(d.value()));
+
+			Assert::AreEqual(7, get(c.value()));
+			Assert::AreEqual(3, count_of_calls);
+
+			//	it's clean until the next change
+			Assert::AreEqual(7, get(c.value()));
+			Assert::AreEqual(3, count_of_calls);
+
+			//	a subscriber is notified by the wave
+			int delivered = 0;
+			c.subscribe([&](int n_) { delivered = n_; });
+
+			a = 4;
+
+			Assert::AreEqual(9, delivered);
+		}
+
+		TEST_METHOD(test_unobserved_subgraph_is_disposed)
+		{
+			rv_context rc;
+
+			rv<int> a { 1 };
+			rv<int> kept = rc.map([](int n_) { return n_ + 1; }, a);
+
+			const auto nodes = graph::node_counter().value();
+
+			{
+				auto inc = [](int n_) { return n_ + 1; };
+
+				rv<int> b = rc.map(inc, a);
+				rv<int> c = rc.map([](int a_, int b_) { return a_ * b_; }, b, kept);
+				rv<int> d = rc.from(c).filter([](int n_) { return n_ > 0; }).map(inc);
+
+				Assert::AreEqual(size_t { 2 }, a._ptr_impl->targets.size());
+				Assert::IsTrue(graph::node_counter().value() > nodes);
+
+				a = 2;
+				Assert::AreEqual(10, get(d.value()));
+			}
+
+			//	the operators are unlinked from a and kept, and every node is freed
+			Assert::AreEqual(size_t { 1 }, a._ptr_impl->targets.size());
+			Assert::AreEqual(size_t { 0 }, kept._ptr_impl->targets.size());
+			Assert::AreEqual(nodes, graph::node_counter().value());
+
+			a = 3;
+			Assert::AreEqual(4, get(kept.value()));
+		}
+
+		TEST_METHOD(test_snapshot_is_consistent_while_propagating)
+		{
+			rv_context rc;
+
+			rv<int> source { 0 };
+			rv<pair_of_ints> pair = rc.map([](int n_) { return pair_of_ints { n_, n_ * 2 }; }, source);
+
+			//	published as immutable copies
+			rv<string> text = rc.map([](int n_) { return string(static_cast<size_t>(n_ % 64), static_cast<char>('a' + n_ % 26)); }, source);
+
+			//	the first reads only request the publication
+			Assert::IsFalse(pair.snapshot().is_initialized());
+			Assert::IsFalse(text.snapshot().is_initialized());
+
+			atomic<bool> is_done { false };
+			atomic<int> torn_reads { 0 };
+			vector<thread> readers;
+
+			for (int i = 0; i < 4; ++i)
+			{
+				readers.emplace_back([&]
+				{
+					while (!is_done)
+					{
+						auto p = pair.snapshot();
+
+						if (p && p->twice != p->n * 2)
+						{
+							++torn_reads;
+						}
+
+						auto t = text.snapshot();
+
+						if (t && t->find_first_not_of(t->empty() ? 'a' : t->front()) != string::npos)
+						{
+							++torn_reads;
+						}
+					}
+				});
+			}
+
+			for (int i = 1; i <= 2000; ++i)
+			{
+				source = i;
+			}
+
+			is_done = true;
+
+			for (auto& t : readers)
+			{
+				t.join();
+			}
+
+			Assert::AreEqual(0, torn_reads.load());
+			Assert::AreEqual(2000, get(pair.snapshot()).n);
+			Assert::AreEqual(get(text.value()), get(text.snapshot()));
+		}
+
+		TEST_METHOD(test_snapshot_is_published_by_the_wave_after_the_first_read)
+		{
+			rv_context rc;
+
+			rv<int> source { 0 };
+			rv<counted_copies> counted = rc.map([](int n_) { return counted_copies { n_ }; }, source);
+
+			auto copies_of_changes = [&]
+			{
+				const int before = counted_copies::count_of_copies;
+
+				for (int i = 0; i < 100; ++i)
+				{
+					source = source.value().get() + 1;
+				}
+
+				return counted_copies::count_of_copies - before;
+			};
+
+			const int copies_without_readers = copies_of_changes();
+
+			//	the first one doesn't wait for a wave, so it's empty
+			const int before_the_first_read = counted_copies::count_of_copies;
+			Assert::IsFalse(counted.snapshot().is_initialized());
+			Assert::AreEqual(before_the_first_read, counted_copies::count_of_copies);
+
+			//	one published copy per change
+			Assert::AreEqual(copies_without_readers + 100, copies_of_changes());
+			Assert::AreEqual(200, get(counted.snapshot()).n);
+		}
+
+		TEST_METHOD(test_time_operators_by_manual_clock)
+		{
+			typedef chrono::milliseconds ms;
+
+			auto ptr_clock = make_shared<rv_manual_clock>();
+
+			rv_context rc;
+			rc.set_clock(ptr_clock);
+
+			rv<int> a { 0 };
+			rv<int> debounced = rc.debounce(ms { 100 }, a);
+			rv<int> throttled = rc.throttle(ms { 100 }, a);
+			rv<int> sampled = rc.sample(ms { 100 }, a);
+
+			//	the first value is passed at once, except by the debounce
+			Assert::IsFalse(debounced.value().is_initialized());
+			Assert::AreEqual(0, get(throttled.value()));
+			Assert::AreEqual(0, get(sampled.value()));
+
+			//	0 ms: the throttle is in the period of its first value
+			a = 1;
+			ptr_clock->advance(ms { 50 });
+			a = 2;
+
+			Assert::IsFalse(debounced.value().is_initialized());
+			Assert::AreEqual(0, get(throttled.value()));
+			Assert::AreEqual(0, get(sampled.value()));
+
+			//	100 ms: the end of the period and the tick
+			ptr_clock->advance(ms { 50 });
+
+			Assert::IsFalse(debounced.value().is_initialized());
+			Assert::AreEqual(2, get(throttled.value()));
+			Assert::AreEqual(2, get(sampled.value()));
+
+			//	150 ms: a has been unchanged for 100 ms
+			ptr_clock->advance(ms { 50 });
+
+			Assert::AreEqual(2, get(debounced.value()));
+
+			//	260 ms: a new period of the throttle, the next tick is at 300 ms
+			ptr_clock->advance(ms { 110 });
+			a = 3;
+
+			Assert::AreEqual(3, get(throttled.value()));
+			Assert::AreEqual(2, get(sampled.value()));
+
+			ptr_clock->advance(ms { 40 });
+
+			Assert::AreEqual(3, get(sampled.value()));
+
+			//	the timers of a disposed operator are cancelled
+			{
+				rv<int> disposed = rc.debounce(ms { 100 }, a);
+				a = 4;
+			}
+
+			ptr_clock->advance(ms { 1000 });
+
+			Assert::AreEqual(4, get(debounced.value()));
+		}
+
+		TEST_METHOD(test_debounce_passes_the_edges_of_a_burst)
+		{
+			typedef chrono::milliseconds ms;
+
+			auto ptr_clock = make_shared<rv_manual_clock>();
+
+			rv_context rc;
+			rc.set_clock(ptr_clock);
+
+			rv<int> a { 0 };
+			rv<int> trailing = rc.debounce(ms { 100 }, a);
+			rv<int> leading = rc.debounce(ms { 100 }, a, DEBOUNCE_LEADING_AND_TRAILING);
+
+			Assert::IsFalse(trailing.value().is_initialized());
+			Assert::AreEqual(0, get(leading.value()));
+
+			vector<int> trailing_values;
+			vector<int> leading_values;
+
+			trailing.subscribe([&](int n_) { trailing_values.push_back(n_); });
+			leading.subscribe([&](int n_) { leading_values.push_back(n_); });
+
+			ptr_clock->advance(ms { 200 });
+
+			//	200 ms: a burst of 1 and 2, the leading edge is passed at once
+			a = 1;
+
+			Assert::AreEqual(0, get(trailing.value()));
+			Assert::AreEqual(1, get(leading.value()));
+
+			ptr_clock->advance(ms { 50 });
+			a = 2;
+			ptr_clock->advance(ms { 50 });
+
+			Assert::AreEqual(0, get(trailing.value()));
+			Assert::AreEqual(1, get(leading.value()));
+
+			//	350 ms: a has been unchanged for 100 ms
+			ptr_clock->advance(ms { 50 });
+
+			Assert::AreEqual(2, get(trailing.value()));
+			Assert::AreEqual(2, get(leading.value()));
+
+			//	a burst of one value is passed once by the leading edge
+			a = 3;
+			ptr_clock->advance(ms { 100 });
+
+			Assert::IsTrue(vector<int> { 0, 2, 3 } == trailing_values);
+			Assert::IsTrue(vector<int> { 1, 2, 3 } == leading_values);
+		}
+
+		TEST_METHOD(test_slow_wave_of_a_timer_doesnt_block_the_clock)
+		{
+			typedef chrono::milliseconds ms;
+
+			//	its tasks only post the waves, like the ones of rv_steady_clock
+			class posting_clock : public rv_manual_clock
+			{
+			public:
+				bool is_synchronous() const override
+				{
+					return false;
+				}
+			};
+
+			mutex mtx;
+			condition_variable changed;
+			bool is_released = false;
+			bool is_fast_changed = false;
+
+			auto ptr_clock = make_shared<posting_clock>();
+
+			rv_context slow_rc;
+			rv_context fast_rc;
+			slow_rc.set_clock(ptr_clock);
+			fast_rc.set_clock(ptr_clock);
+
+			rv<int> a { 0 };
+			rv<int> b { 0 };
+			rv<int> slow_debounced = slow_rc.debounce(ms { 10 }, a);
+			rv<int> fast_debounced = fast_rc.debounce(ms { 10 }, b);
+
+			rv<int> slow = slow_rc.map([&](int n_)
+			{
+				unique_lock<mutex> lock { mtx };
+				changed.wait(lock, [&] { return is_released; });
+
+				return n_;
+			}, slow_debounced);
+
+			rv<int> fast = fast_rc.map([&](int n_)
+			{
+				lock_guard<mutex> lock { mtx };
+				is_fast_changed = true;
+				changed.notify_all();
+
+				return n_;
+			}, fast_debounced);
+
+			//	the timer of the slow one is the first, its wave waits, but it's on the thread of its context
+			ptr_clock->advance(ms { 10 });
+
+			bool is_fast_in_time;
+
+			{
+				unique_lock<mutex> lock { mtx };
+
+				is_fast_in_time = changed.wait_for(lock, chrono::seconds { 10 }, [&] { return is_fast_changed; });
+
+				is_released = true;
+				changed.notify_all();
+			}
+
+			//	they wait for the running waves
+			slow_rc.batch([] { });
+			fast_rc.batch([] { });
+
+			Assert::IsTrue(is_fast_in_time);
+		}
+
+		TEST_METHOD(test_window_slides_with_the_clock)
+		{
+			typedef chrono::milliseconds ms;
+
+			auto ptr_clock = make_shared<rv_manual_clock>();
+
+			rv_context rc;
+			rc.set_clock(ptr_clock);
+
+			rv<int> a { 1 };
+			rv<vector<int>> window = rc.window(ms { 100 }, a);
+
+			vector<size_t> sizes;
+			window.subscribe([&](vector<int> values_) { sizes.push_back(values_.size()); });
+
+			ptr_clock->advance(ms { 40 });
+			a = 2;
+			ptr_clock->advance(ms { 40 });
+			a = 3;
+
+			Assert::IsTrue(vector<int> { 1, 2, 3 } == get(window.value()));
+
+			//	1 expires at 100 ms, 2 at 140 ms, 3 at 180 ms
+			ptr_clock->advance(ms { 30 });
+			Assert::IsTrue(vector<int> { 2, 3 } == get(window.value()));
+
+			ptr_clock->advance(ms { 100 });
+			Assert::IsTrue(get(window.value()).empty());
+
+			Assert::IsTrue(vector<size_t> { 2, 3, 2, 1, 0 } == sizes);
+		}
+
+		TEST_METHOD(test_scan_and_fold_accumulate_the_changes)
+		{
+			rv_context rc;
+
+			rv<int> a { 1 };
+
+			rv<vector<int>> history = rc.scan(vector<int> { }, [](vector<int> values_, int n_) { values_.push_back(n_); return values_; }, a);
+			rv<int> total = rc.fold([](int sum_, int n_) { return sum_ + n_; }, a);
+
+			Assert::IsTrue(vector<int> { 1 } == get(history.value()));
+			Assert::AreEqual(1, get(total.value()));
+
+			a = 2;
+			a = 2;
+			a = 5;
+
+			//	the unchanged value isn't accumulated
+			Assert::IsTrue(vector<int> { 1, 2, 5 } == get(history.value()));
+			Assert::AreEqual(8, get(total.value()));
+
+			//	a batch is one wave, every change of it is accumulated in order
+			rc.batch([&]
+			{
+				a = 6;
+				a = 7;
+				a = 7;
+				a = 3;
+			});
+
+			Assert::IsTrue(vector<int> { 1, 2, 5, 6, 7, 3 } == get(history.value()));
+			Assert::AreEqual(24, get(total.value()));
+
+			//	the accumulators of a disposed scan don't hold the changes
+			{
+				rv<int> disposed = rc.fold([](int sum_, int n_) { return sum_ + n_; }, a);
+			}
+
+			a = 4;
+
+			Assert::IsTrue(vector<int> { 1, 2, 5, 6, 7, 3, 4 } == get(history.value()));
+			Assert::AreEqual(28, get(total.value()));
+		}
+
+		TEST_METHOD(test_rolling_aggregates_of_count_and_time_windows)
+		{
+			typedef chrono::milliseconds ms;
+
+			auto ptr_clock = make_shared<rv_manual_clock>();
+
+			rv_context rc;
+			rc.set_clock(ptr_clock);
+
+			rv<int> a { 5 };
+
+			rv<int> sum = rc.rolling_sum(3, a);
+			rv<double> mean = rc.rolling_mean(3, a);
+			rv<int> min = rc.rolling_min(3, a);
+			rv<int> max = rc.rolling_max(3, a);
+			rv<double> variance = rc.rolling_variance(3, a);
+
+			rv<int> recent_max = rc.rolling_max(ms { 100 }, a);
+
+			//	the windows are 5 1 3, 1 3 4, 3 4 2
+			for (int n : { 1, 3, 4, 2 })
+			{
+				ptr_clock->advance(ms { 40 });
+				a = n;
+			}
+
+			Assert::AreEqual(9, get(sum.value()));
+			Assert::AreEqual(3.0, get(mean.value()));
+			Assert::AreEqual(2, get(min.value()));
+			Assert::AreEqual(4, get(max.value()));
+			Assert::IsTrue(abs(get(variance.value()) - 2.0 / 3) < 1e-9);
+
+			//	160 ms: the changes of 80, 120 and 160 ms are in the window
+			Assert::AreEqual(4, get(recent_max.value()));
+
+			//	4 expires at 220 ms, 2 at 260 ms
+			ptr_clock->advance(ms { 70 });
+			Assert::AreEqual(2, get(recent_max.value()));
+
+			//	the maximum of an expired window is left as it was
+			ptr_clock->advance(ms { 100 });
+			Assert::AreEqual(2, get(recent_max.value()));
+
+			//	every change of a batch enters the windows: 4 9 1
+			rc.batch([&]
+			{
+				a = 7;
+				a = 4;
+				a = 9;
+				a = 1;
+			});
+
+			Assert::AreEqual(14, get(sum.value()));
+			Assert::AreEqual(1, get(min.value()));
+			Assert::AreEqual(9, get(max.value()));
+			Assert::AreEqual(9, get(recent_max.value()));
+		}
+
+		TEST_METHOD(test_collection_operators_apply_the_changes)
+		{
+			rv_context rc;
+
+			rv<rv_collection<int>> xs = rv_collection<int> { { 1, 2, 3, 4 } };
+
+			int count_of_calls = 0;
+
+			rv<rv_collection<int>> squares = rc.map_each([&](int n_) { ++count_of_calls; return n_ * n_; }, xs);
+			rv<rv_collection<int>> odd_squares = rc.filter_each([](int n_) { return n_ % 2 == 1; }, squares);
+			rv<size_t> count = rc.count(odd_squares);
+			rv<size_t> big = rc.count([](int n_) { return n_ > 5; }, xs);
+
+			Assert::IsTrue(vector<int> { 1, 9 } == get(odd_squares.value()).items());
+			Assert::AreEqual(size_t { 0 }, get(big.value()));
+
+			count_of_calls = 0;
+
+			const auto snapshot = get(xs.snapshot());
+
+			auto list = get(xs.value());
+			list.push_back(5);
+			list.update(1, 7);
+			list.remove(0);
+
+			//	the versions are immutable, nothing sees the changes before the assignment
+			Assert::IsTrue(vector<int> { 1, 2, 3, 4 } == get(xs.value()).items());
+			Assert::IsTrue(vector<int> { 1, 2, 3, 4 } == get(xs.snapshot()).items());
+			Assert::IsTrue(vector<int> { 1, 2, 3, 4 } == snapshot.items());
+			Assert::IsTrue(vector<int> { 1, 4, 9, 16 } == get(squares.value()).items());
+
+			xs = list;
+
+			//	3 7 3 4 5 -> 7 3 4 5, only the changed items are mapped
+			Assert::AreEqual(2, count_of_calls);
+			Assert::IsTrue(vector<int> { 49, 9, 16, 25 } == get(squares.value()).items());
+			Assert::IsTrue(vector<int> { 49, 9, 25 } == get(odd_squares.value()).items());
+			Assert::AreEqual(size_t { 3 }, get(count.value()));
+			Assert::AreEqual(size_t { 1 }, get(big.value()));
+
+			//	the versions of a batch are propagated together, so they are rebuilt
+			rc.batch([&]
+			{
+				auto list = get(xs.value());
+				list.insert(0, 6);
+				xs = list;
+
+				list.update(0, 1);
+				xs = list;
+			});
+
+			Assert::IsTrue(vector<int> { 1, 49, 9, 25 } == get(odd_squares.value()).items());
+			Assert::AreEqual(size_t { 4 }, get(count.value()));
+
+			//	list is an old version of the collection
+			bool is_thrown = false;
+
+			try
+			{
+				list.push_back(0);
+			}
+			catch (logic_error&)
+			{
+				is_thrown = true;
+			}
+
+			Assert::IsTrue(is_thrown);
+		}
+
+		TEST_METHOD(test_collection_versions_share_the_unchanged_items)
+		{
+			rv_context rc;
+
+			vector<int> items(2000);
+			iota(items.begin(), items.end(), 0);
+
+			rv<rv_collection<int>> xs = rv_collection<int> { items };
+			rv<rv_collection<int>> doubled = rc.map_each([](int n_) { return n_ * 2; }, xs);
+
+			const auto first = get(xs.value());
+			const auto first_doubled = get(doubled.value());
+
+			//	the items move between the chunks, the first version doesn't change
+			auto list = first;
+
+			for (int i = 0; i < 600; ++i)
+			{
+				list.insert(700, -i);
+				items.insert(items.begin() + 700, -i);
+			}
+
+			for (int i = 0; i < 1500; ++i)
+			{
+				list.remove(100);
+				items.erase(items.begin() + 100);
+			}
+
+			list.update(0, 7);
+			items[0] = 7;
+
+			xs = list;
+
+			Assert::AreEqual(size_t { 2000 }, first.size());
+			Assert::AreEqual(1999, first[1999]);
+			Assert::IsTrue(items == get(xs.value()).items());
+			Assert::AreEqual(items[500], get(xs.value())[500]);
+
+			for (auto& item : items)
+			{
+				item *= 2;
+			}
+
+			//	the changes are applied to the previous version of the output
+			Assert::IsTrue(get(doubled.value()).follows(first_doubled));
+			Assert::IsTrue(items == get(doubled.value()).items());
+		}
 	};
 }
 
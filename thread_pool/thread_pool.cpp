@@ -1,11 +1,29 @@
 #include "stdafx.h"
 #include "thread_pool"
 
+#include <utility\stats.hpp>
+
 
 using namespace std;
 using namespace utility;
 
 
+namespace
+{
+	//	the tasks of every thread_pool of the process, see stats.hpp
+	stats_counter& queue_depth_counter()
+	{
+		static stats_counter counter { "thread_pool.queue_depth" };
+		return counter;
+	}
+
+	stats_counter& completed_tasks_counter()
+	{
+		static stats_counter counter { "thread_pool.tasks_completed" };
+		return counter;
+	}
+}
+
 struct utility::thread_pool_impl
 {
 	thread_pool_impl(size_t count_of_threads_)
@@ -31,6 +49,9 @@ struct utility::thread_pool_impl
 		{
 			th.join();
 		}
+
+		// the tasks left in the queue are dropped
+		queue_depth_counter().sub(_task_queue.size());
 	}
 
 	size_t size() const
@@ -44,6 +65,8 @@ struct utility::thread_pool_impl
 			unique_lock<mutex> l { _mtx_queue_change };
 
 			_task_queue.push(move(task_));
+
+			queue_depth_counter().add();
 		}
 
 		_cv_queue_change.notify_one();
@@ -72,7 +95,11 @@ private:
 				_task_queue.pop();
 			}
 
+			queue_depth_counter().sub();
+
 			task();
+
+			completed_tasks_counter().add();
 		}
 	}
 
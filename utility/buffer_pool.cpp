@@ -0,0 +1,265 @@
+#include "stdafx.h"
+#include "buffer_pool.hpp"
+
+using namespace std;
+using namespace utility;
+
+
+namespace
+{
+	const size_t COUNT_OF_SIZE_CLASSES = 12;		// 512 B .. 1 MB
+
+	size_t index_of(size_t size_class_)
+	{
+		size_t i = 0;
+
+		for (size_t s = buffer_pool::MIN_BLOCK_SIZE; s < size_class_; s <<= 1)
+		{
+			++i;
+		}
+
+		return i;
+	}
+}
+
+struct buffer_pool::state
+{
+	mutex mtx;
+
+	shared_ptr<block_allocator> ptr_allocator;
+
+	vector<char*> free_blocks[COUNT_OF_SIZE_CLASSES];
+
+	size_t cached_bytes = 0;
+	size_t max_cached_bytes;
+
+	buffer_pool_statistics statistics;
+
+	~state()
+	{
+		size_t size_class = MIN_BLOCK_SIZE;
+
+		for (auto& blocks : free_blocks)
+		{
+			for (auto ptr_block : blocks)
+			{
+				free_block(ptr_allocator.get(), ptr_block, size_class);
+			}
+
+			size_class <<= 1;
+		}
+	}
+
+	void release(char* ptr_block_, size_t size_class_)
+	{
+		// oversized blocks aren't cached
+		if (size_class_ <= MAX_BLOCK_SIZE)
+		{
+			lock_guard<mutex> l { mtx };
+
+			if (cached_bytes + size_class_ <= max_cached_bytes)
+			{
+				cached_bytes += size_class_;
+				free_blocks[index_of(size_class_)].push_back(ptr_block_);
+
+				return;
+			}
+		}
+
+		free_block(ptr_allocator.get(), ptr_block_, size_class_);
+	}
+
+	static char* allocate_block(block_allocator* ptr_allocator_, size_t size_class_)
+	{
+		return ptr_allocator_ ? ptr_allocator_->allocate(size_class_) : new char[size_class_];
+	}
+
+	static void free_block(block_allocator* ptr_allocator_, char* ptr_block_, size_t size_class_)
+	{
+		if (ptr_allocator_)
+		{
+			ptr_allocator_->deallocate(ptr_block_, size_class_);
+		}
+		else
+		{
+			delete[] ptr_block_;
+		}
+	}
+};
+
+
+buffer_slice::buffer_slice(shared_ptr<char> ptr_block_, size_t offset_, size_t size_)
+	: _ptr_block { move(ptr_block_) }
+	, _offset { offset_ }
+	, _size { size_ }
+{
+}
+
+const char* buffer_slice::data() const
+{
+	return _ptr_block.get() + _offset;
+}
+
+size_t buffer_slice::size() const
+{
+	return _size;
+}
+
+bool buffer_slice::empty() const
+{
+	return _size == 0;
+}
+
+buffer_slice buffer_slice::slice(size_t offset_, size_t size_) const
+{
+	if (offset_ + size_ > _size)
+	{
+		stringstream sb;
+		sb << "slice [" << offset_ << ", " << offset_ + size_ << ") is out of the range of size " << _size;
+
+		throw out_of_range { sb.str() };
+	}
+
+	return { _ptr_block, _offset + offset_, size_ };
+}
+
+long buffer_slice::use_count() const
+{
+	return _ptr_block.use_count();
+}
+
+
+buffer_pool::buffer_pool(size_t max_cached_bytes_, shared_ptr<block_allocator> ptr_allocator_)
+	: _ptr_state { make_shared<state>() }
+{
+	_ptr_state->max_cached_bytes = max_cached_bytes_;
+	_ptr_state->ptr_allocator = move(ptr_allocator_);
+}
+
+buffer_pool::~buffer_pool()
+{
+}
+
+pair<char*, buffer_slice> buffer_pool::acquire(size_t size_)
+{
+	const auto size_class = size_class_of(size_);
+
+	char* ptr_block = nullptr;
+
+	{
+		lock_guard<mutex> l { _ptr_state->mtx };
+
+		if (size_class <= MAX_BLOCK_SIZE)
+		{
+			auto& free_blocks = _ptr_state->free_blocks[index_of(size_class)];
+
+			if (!free_blocks.empty())
+			{
+				ptr_block = free_blocks.back();
+				free_blocks.pop_back();
+
+				_ptr_state->cached_bytes -= size_class;
+				++_ptr_state->statistics.count_of_reuses;
+			}
+		}
+
+		if (!ptr_block)
+		{
+			++_ptr_state->statistics.count_of_allocations;
+			_ptr_state->statistics.allocated_bytes += size_class;
+		}
+	}
+
+	auto ptr_allocator = _ptr_state->ptr_allocator;
+
+	if (!ptr_block)
+	{
+		ptr_block = state::allocate_block(ptr_allocator.get(), size_class);
+	}
+
+	// the block returns to the pool if it's still alive, otherwise to its allocator
+	weak_ptr<state> ptr_weak_state = _ptr_state;
+
+	shared_ptr<char> ptr_shared_block { ptr_block, [ptr_weak_state, ptr_allocator, size_class](char* ptr_block_)
+	{
+		if (auto ptr_state = ptr_weak_state.lock())
+		{
+			ptr_state->release(ptr_block_, size_class);
+		}
+		else
+		{
+			state::free_block(ptr_allocator.get(), ptr_block_, size_class);
+		}
+	} };
+
+	return { ptr_block, buffer_slice { move(ptr_shared_block), 0, size_class } };
+}
+
+buffer_pool_statistics buffer_pool::statistics() const
+{
+	lock_guard<mutex> l { _ptr_state->mtx };
+
+	return _ptr_state->statistics;
+}
+
+void buffer_pool::count_received(size_t size_)
+{
+	lock_guard<mutex> l { _ptr_state->mtx };
+
+	_ptr_state->statistics.received_bytes += size_;
+}
+
+void buffer_pool::count_copied(size_t size_)
+{
+	lock_guard<mutex> l { _ptr_state->mtx };
+
+	_ptr_state->statistics.copied_bytes += size_;
+}
+
+size_t buffer_pool::size_class_of(size_t size_)
+{
+	size_t size_class = MIN_BLOCK_SIZE;
+
+	while (size_class < size_)
+	{
+		size_class <<= 1;
+	}
+
+	return size_class;
+}
+
+buffer_pool& buffer_pool::for_this_thread()
+{
+	thread_local buffer_pool pool;
+
+	return pool;
+}
+
+
+adaptive_buffer_size::adaptive_buffer_size(size_t initial_size_)
+	: _average { static_cast<double>(initial_size_) }
+	, _next { buffer_pool::size_class_of(initial_size_) }
+{
+}
+
+size_t adaptive_buffer_size::next() const
+{
+	return _next;
+}
+
+void adaptive_buffer_size::observe(size_t size_, size_t capacity_)
+{
+	const double ALPHA = 0.125;
+
+	_average += ALPHA * (static_cast<double>(size_) - _average);
+
+	auto next = buffer_pool::size_class_of(static_cast<size_t>(2 * _average));
+
+	// there may be more, the next read should take it at once
+	if (size_ >= capacity_ && next <= capacity_)
+	{
+		next = buffer_pool::size_class_of(capacity_ + 1);
+	}
+
+	_next = next < buffer_pool::MAX_BLOCK_SIZE ? next : buffer_pool::MAX_BLOCK_SIZE;
+}
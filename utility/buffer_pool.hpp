@@ -0,0 +1,132 @@
+#pragma once
+#include "stdafx.h"
+
+namespace utility
+{
+	class buffer_pool;
+
+	//
+	//	a refcounted view into a pooled block
+	//
+	//	The copies and the sub-slices share the block, which goes back to its pool when the
+	//	last of them is destroyed. So the received data can be handed over to another
+	//	thread (e.g. a thread_pool task) without copying it.
+	//
+	class buffer_slice
+	{
+		friend class buffer_pool;
+	public:
+		buffer_slice() = default;
+
+		const char* data() const;
+		size_t size() const;
+		bool empty() const;
+
+		//	a part of this slice, which shares the block
+		buffer_slice slice(size_t offset_, size_t size_) const;
+
+		//	count of the slices referring to the block
+		long use_count() const;
+
+	private:
+		std::shared_ptr<char> _ptr_block;
+		size_t _offset = 0;
+		size_t _size = 0;
+
+		buffer_slice(std::shared_ptr<char> ptr_block_, size_t offset_, size_t size_);
+	};
+
+	struct buffer_pool_statistics
+	{
+		//	blocks allocated from the heap
+		size_t count_of_allocations = 0;
+
+		//	blocks reused from the pool
+		size_t count_of_reuses = 0;
+
+		//	bytes of the blocks allocated from the heap
+		size_t allocated_bytes = 0;
+
+		//	bytes copied out of the blocks by the framework
+		size_t copied_bytes = 0;
+
+		//	bytes received into the blocks
+		size_t received_bytes = 0;
+	};
+
+	//
+	//	the memory of the blocks of a buffer_pool, e.g. memory registered for an I/O API
+	//	it's called on any thread, it's held until the last block is freed
+	//
+	class block_allocator
+	{
+	public:
+		virtual ~block_allocator() = default;
+
+		virtual char* allocate(size_t size_) = 0;
+		virtual void deallocate(char* ptr_block_, size_t size_) = 0;
+	};
+
+	//
+	//	free lists of blocks by power of two size classes
+	//
+	//	It's thread safe: a block can be returned on any thread. The blocks may outlive the
+	//	pool, in that case they are simply freed.
+	//
+	class buffer_pool
+	{
+	public:
+		static constexpr size_t MIN_BLOCK_SIZE = 512;
+		static constexpr size_t MAX_BLOCK_SIZE = 1024 * 1024;
+		static constexpr size_t DEFAULT_MAX_CACHED_BYTES = 8 * 1024 * 1024;
+
+		//	max_cached_bytes_: the free blocks above it are released instead of kept
+		//	ptr_allocator_: the source of the blocks, null for the heap
+		explicit buffer_pool(size_t max_cached_bytes_ = DEFAULT_MAX_CACHED_BYTES, std::shared_ptr<block_allocator> ptr_allocator_ = nullptr);
+		~buffer_pool();
+
+		buffer_pool(const buffer_pool&) = delete;
+		buffer_pool& operator=(const buffer_pool&) = delete;
+
+		//
+		//	a block of at least size_ bytes, the size is rounded up to the size class
+		//	the returned mutable pointer is valid as long as the slice is
+		//
+		std::pair<char*, buffer_slice> acquire(size_t size_);
+
+		buffer_pool_statistics statistics() const;
+
+		void count_received(size_t size_);
+		void count_copied(size_t size_);
+
+		//	rounds up to the nearest size class
+		static size_t size_class_of(size_t size_);
+
+		//	the pool of the calling thread
+		static buffer_pool& for_this_thread();
+
+	private:
+		struct state;
+
+		std::shared_ptr<state> _ptr_state;
+	};
+
+	//
+	//	follows the observed read sizes: the next buffer is about twice the moving average,
+	//	and it's doubled when a read filled the whole buffer
+	//
+	class adaptive_buffer_size
+	{
+	public:
+		explicit adaptive_buffer_size(size_t initial_size_ = buffer_pool::MIN_BLOCK_SIZE);
+
+		size_t next() const;
+
+		//	a read of size_ bytes into a buffer of capacity_ bytes has completed
+		void observe(size_t size_, size_t capacity_);
+
+	private:
+		double _average;
+		size_t _next;
+	};
+}
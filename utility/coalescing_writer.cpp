@@ -0,0 +1,242 @@
+#include "stdafx.h"
+#include "coalescing_writer.hpp"
+
+using namespace std;
+using namespace utility;
+
+coalescing_writer::coalescing_writer(const end_point& end_point_, size_t flush_size_, chrono::milliseconds flush_delay_)
+	: _end_point { end_point_ }
+	, _flush_size { flush_size_ }
+	, _flush_delay { flush_delay_ }
+{
+	_buffer.reserve(_flush_size);
+	_sending_buffer.reserve(_flush_size);
+
+	_flusher = thread { [this] { _flush_loop(); } };
+}
+
+coalescing_writer::~coalescing_writer()
+{
+	{
+		lock_guard<mutex> lock { _mutex };
+		_stopping = true;
+	}
+
+	_cv.notify_one();
+	_flusher.join();
+
+	// the rest is sent, but there is nobody to report an error to
+	try
+	{
+		unique_lock<mutex> lock { _mutex };
+
+		if (!_error)
+		{
+			_flush_buffer(lock);
+		}
+	}
+	catch (...)
+	{
+	}
+}
+
+void coalescing_writer::write(const char* ptr_data_, size_t size_)
+{
+	const io_buffer buffer { ptr_data_, size_ };
+
+	write_v(&buffer, 1);
+}
+
+void coalescing_writer::write_v(const io_buffer* ptr_buffers_, size_t count_)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < count_; ++i)
+	{
+		size += ptr_buffers_[i].size;
+	}
+
+	unique_lock<mutex> lock { _mutex };
+
+	_rethrow_error();
+
+	if (_buffer.size() + size < _flush_size)
+	{
+		const bool was_empty = _buffer.empty();
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			_buffer.insert(_buffer.end(), ptr_buffers_[i].data, ptr_buffers_[i].data + ptr_buffers_[i].size);
+		}
+
+		if (was_empty && !_buffer.empty())
+		{
+			_oldest_write = chrono::steady_clock::now();
+
+			lock.unlock();
+			_cv.notify_one();
+		}
+
+		return;
+	}
+
+	_send(lock, ptr_buffers_, count_);
+}
+
+void coalescing_writer::write_v(initializer_list<io_buffer> buffers_)
+{
+	write_v(buffers_.begin(), buffers_.size());
+}
+
+void coalescing_writer::flush()
+{
+	unique_lock<mutex> lock { _mutex };
+
+	_rethrow_error();
+	_flush_buffer(lock);
+}
+
+void coalescing_writer::cork()
+{
+	lock_guard<mutex> lock { _mutex };
+
+	_corked = true;
+}
+
+void coalescing_writer::uncork()
+{
+	{
+		unique_lock<mutex> lock { _mutex };
+
+		_corked = false;
+
+		_rethrow_error();
+		_flush_buffer(lock);
+	}
+
+	_cv.notify_one();
+}
+
+size_t coalescing_writer::count_of_sends() const
+{
+	lock_guard<mutex> lock { _mutex };
+
+	return _count_of_sends;
+}
+
+size_t coalescing_writer::count_of_bytes() const
+{
+	lock_guard<mutex> lock { _mutex };
+
+	return _count_of_bytes;
+}
+
+void coalescing_writer::_flush_loop()
+{
+	unique_lock<mutex> lock { _mutex };
+
+	while (!_stopping)
+	{
+		if (_buffer.empty() || _corked || _error)
+		{
+			_cv.wait(lock);
+			continue;
+		}
+
+		const auto deadline = _oldest_write + _flush_delay;
+
+		if (chrono::steady_clock::now() < deadline)
+		{
+			_cv.wait_until(lock, deadline);
+			continue;
+		}
+
+		try
+		{
+			_flush_buffer(lock);
+		}
+		catch (...)
+		{
+			// it's kept by _send for the next call
+		}
+	}
+}
+
+void coalescing_writer::_send(unique_lock<mutex>& lock_, const io_buffer* ptr_buffers_, size_t count_)
+{
+	_sent_cv.wait(lock_, [this] { return !_is_sending; });
+
+	// the previous send may have failed meanwhile
+	_rethrow_error();
+
+	// the buffered bytes go first, then the new ones from their place
+	_sending_buffer.swap(_buffer);
+
+	vector<io_buffer> buffers;
+	buffers.reserve(count_ + 1);
+
+	if (!_sending_buffer.empty())
+	{
+		buffers.push_back({ _sending_buffer.data(), _sending_buffer.size() });
+	}
+
+	buffers.insert(buffers.end(), ptr_buffers_, ptr_buffers_ + count_);
+
+	if (buffers.empty())
+	{
+		return;
+	}
+
+	_is_sending = true;
+	lock_.unlock();
+
+	exception_ptr error;
+
+	try
+	{
+		_end_point.write_v(buffers.data(), buffers.size());
+	}
+	catch (...)
+	{
+		error = current_exception();
+	}
+
+	lock_.lock();
+
+	_is_sending = false;
+	_sending_buffer.clear();
+
+	_sent_cv.notify_all();
+
+	if (error)
+	{
+		// a part of it may have been sent, nothing can be sent after it
+		_error = error;
+		_buffer.clear();
+
+		rethrow_exception(error);
+	}
+
+	++_count_of_sends;
+	for (auto& b : buffers)
+	{
+		_count_of_bytes += b.size;
+	}
+}
+
+void coalescing_writer::_flush_buffer(unique_lock<mutex>& lock_)
+{
+	if (_buffer.empty())
+	{
+		return;
+	}
+
+	_send(lock_, nullptr, 0);
+}
+
+void coalescing_writer::_rethrow_error()
+{
+	if (_error)
+	{
+		rethrow_exception(_error);
+	}
+}
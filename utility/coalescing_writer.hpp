@@ -0,0 +1,86 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+
+namespace utility
+{
+	//
+	//	collects the small writes and sends them together
+	//
+	//	The buffered bytes are sent when
+	//		- they reach flush_size_,
+	//		- the oldest of them has waited for flush_delay_ (by a background thread),
+	//		- flush() or uncork() is called.
+	//	A write which doesn't fit into the buffer is sent right away together with the
+	//	buffered bytes by a single gather write, without copying it.
+	//
+	//	The sends are made one at a time in the order of the writes, but without the lock:
+	//	meanwhile the other threads buffer their writes and the counters can be read.
+	//	A failed send leaves the stream broken, so its error is kept and rethrown by every
+	//	later call, whichever thread sent it.
+	//
+	class coalescing_writer : public byte_sink
+	{
+	public:
+		static constexpr size_t DEFAULT_FLUSH_SIZE = 64 * 1024;
+
+		coalescing_writer(const end_point&, size_t flush_size_ = DEFAULT_FLUSH_SIZE, std::chrono::milliseconds flush_delay_ = std::chrono::milliseconds { 2 });
+		~coalescing_writer();
+
+		coalescing_writer(const coalescing_writer&) = delete;
+		coalescing_writer& operator=(const coalescing_writer&) = delete;
+
+		void write(const char* ptr_data_, size_t size_);
+		void write_v(const io_buffer* ptr_buffers_, size_t count_) override;
+		void write_v(std::initializer_list<io_buffer> buffers_);
+
+		void flush();
+
+		//
+		//	TCP_CORK like behavior, which isn't available on windows: while it's corked
+		//	only the full flush_size_ blocks are sent, the time based flush is suspended
+		//
+		void cork();
+		void uncork();
+
+		//	count of the sends and the bytes so far
+		size_t count_of_sends() const;
+		size_t count_of_bytes() const;
+
+	private:
+		const end_point& _end_point;
+
+		const size_t _flush_size;
+		const std::chrono::milliseconds _flush_delay;
+
+		mutable std::mutex _mutex;
+		std::condition_variable _cv;
+
+		std::vector<char> _buffer;
+		std::chrono::steady_clock::time_point _oldest_write;
+
+		//	the buffered bytes of the send in progress, they are swapped with _buffer
+		std::vector<char> _sending_buffer;
+		bool _is_sending = false;
+		std::condition_variable _sent_cv;
+
+		bool _corked = false;
+		bool _stopping = false;
+
+		std::exception_ptr _error;
+
+		size_t _count_of_sends = 0;
+		size_t _count_of_bytes = 0;
+
+		std::thread _flusher;
+
+		void _flush_loop();
+
+		//	sends the buffered bytes and then the given ones, it releases the lock meanwhile
+		void _send(std::unique_lock<std::mutex>& lock_, const io_buffer* ptr_buffers_, size_t count_);
+		void _flush_buffer(std::unique_lock<std::mutex>& lock_);
+
+		//	the caller holds the lock
+		void _rethrow_error();
+	};
+}
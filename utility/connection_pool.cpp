@@ -0,0 +1,364 @@
+#include "stdafx.h"
+#include "connection_pool.hpp"
+
+using namespace std;
+using namespace utility;
+
+
+namespace
+{
+	struct pool_entry
+	{
+		string address;
+		string port;
+		E_TRANSPORT transport;
+
+		//	the result of getaddrinfo, empty until the first connect or after a failed one
+		shared_ptr<addrinfo> ptr_address;
+
+		deque<unique_ptr<end_point>> idle;
+
+		//	background connects in progress
+		size_t connecting = 0;
+
+		chrono::milliseconds backoff { 0 };
+		chrono::steady_clock::time_point next_attempt;
+	};
+
+	string key_of(const string& address_, const string& port_)
+	{
+		return address_ + "|" + port_;
+	}
+
+	//	the peer may have closed an idle connection since it was returned
+	bool is_alive(const end_point& end_point_)
+	{
+		if (end_point_.transport() == TRANSPORT_SHARED_MEMORY)
+		{
+			return true;
+		}
+
+		WSAPOLLFD fd;
+		fd.fd = end_point_.native_handle();
+		fd.events = POLLRDNORM;
+		fd.revents = 0;
+
+		if (WSAPoll(&fd, 1, 0) == SOCKET_ERROR)
+		{
+			return false;
+		}
+
+		if (fd.revents & (POLLERR | POLLHUP | POLLNVAL))
+		{
+			return false;
+		}
+
+		if (fd.revents & POLLRDNORM)
+		{
+			// zero: the peer has shut the connection down
+			char c;
+			return recv(fd.fd, &c, 1, MSG_PEEK) > 0;
+		}
+
+		return true;
+	}
+}
+
+
+struct utility::connection_pool_state
+{
+	connection_pool_desc desc;
+
+	mutable mutex mtx;
+	condition_variable cv;
+
+	//	the references of the elements are stable, the entries are never erased
+	unordered_map<string, pool_entry> entries;
+
+	connection_pool_statistics statistics;
+
+	bool stopping = false;
+
+	unique_ptr<end_point> open(const pool_entry& entry_, shared_ptr<addrinfo>& ptr_address_)
+	{
+		if (entry_.transport != TRANSPORT_TCP)
+		{
+			return make_unique<end_point>(client { entry_.address, utility::desc { entry_.port, desc.buffer_size } });
+		}
+
+		if (!ptr_address_)
+		{
+			ptr_address_ = resolve_address(entry_.address, entry_.port);
+		}
+
+		return make_unique<end_point>(connect_socket(ptr_address_.get()), desc.buffer_size);
+	}
+
+	void release(const string& key_, unique_ptr<end_point> ptr_end_point_)
+	{
+		lock_guard<mutex> l { mtx };
+
+		auto it = entries.find(key_);
+		if (stopping || it == entries.end() || it->second.idle.size() >= desc.max_idle_connections)
+		{
+			return;
+		}
+
+		it->second.idle.push_back(move(ptr_end_point_));
+	}
+
+	void reconnect_loop()
+	{
+		unique_lock<mutex> l { mtx };
+
+		while (!stopping)
+		{
+			const auto now = chrono::steady_clock::now();
+
+			pool_entry* ptr_due = nullptr;
+
+			bool has_pending = false;
+			chrono::steady_clock::time_point next_wake;
+
+			for (auto& kv : entries)
+			{
+				auto& e = kv.second;
+
+				if (e.idle.size() + e.connecting >= desc.warm_connections)
+				{
+					continue;
+				}
+
+				if (e.next_attempt <= now)
+				{
+					ptr_due = &e;
+					break;
+				}
+
+				if (!has_pending || e.next_attempt < next_wake)
+				{
+					next_wake = e.next_attempt;
+					has_pending = true;
+				}
+			}
+
+			if (ptr_due == nullptr)
+			{
+				if (has_pending)
+				{
+					cv.wait_until(l, next_wake);
+				}
+				else
+				{
+					cv.wait(l);
+				}
+
+				continue;
+			}
+
+			auto& entry = *ptr_due;
+
+			++entry.connecting;
+			auto ptr_address = entry.ptr_address;
+
+			l.unlock();
+
+			unique_ptr<end_point> ptr_end_point;
+
+			try
+			{
+				ptr_end_point = open(entry, ptr_address);
+			}
+			catch (...)
+			{
+			}
+
+			l.lock();
+
+			--entry.connecting;
+
+			if (ptr_end_point)
+			{
+				entry.ptr_address = move(ptr_address);
+				entry.backoff = chrono::milliseconds { 0 };
+				entry.idle.push_back(move(ptr_end_point));
+
+				++statistics.count_of_background_connects;
+			}
+			else
+			{
+				const auto doubled = entry.backoff.count() ? 2 * entry.backoff : desc.initial_backoff;
+
+				entry.backoff = doubled < desc.max_backoff ? doubled : desc.max_backoff;
+				entry.next_attempt = chrono::steady_clock::now() + entry.backoff;
+
+				// the address may have changed
+				entry.ptr_address.reset();
+
+				++statistics.count_of_failed_connects;
+			}
+		}
+	}
+};
+
+
+pooled_connection::pooled_connection(weak_ptr<connection_pool_state> ptr_pool_state_, string key_, unique_ptr<end_point> ptr_end_point_)
+	: _ptr_pool_state { move(ptr_pool_state_) }
+	, _key { move(key_) }
+	, _ptr_end_point { move(ptr_end_point_) }
+{
+}
+
+pooled_connection::~pooled_connection()
+{
+	if (!_ptr_end_point)
+	{
+		return;
+	}
+
+	if (auto ptr_state = _ptr_pool_state.lock())
+	{
+		ptr_state->release(_key, move(_ptr_end_point));
+	}
+}
+
+pooled_connection& pooled_connection::operator=(pooled_connection&& other_)
+{
+	if (this != &other_)
+	{
+		pooled_connection returned { move(*this) };
+
+		_ptr_pool_state = move(other_._ptr_pool_state);
+		_key = move(other_._key);
+		_ptr_end_point = move(other_._ptr_end_point);
+	}
+
+	return *this;
+}
+
+end_point& pooled_connection::operator*() const
+{
+	return *_ptr_end_point;
+}
+
+end_point* pooled_connection::operator->() const
+{
+	return _ptr_end_point.get();
+}
+
+void pooled_connection::discard()
+{
+	_ptr_end_point.reset();
+}
+
+
+connection_pool::connection_pool(connection_pool_desc desc_)
+	: _ptr_state { make_shared<connection_pool_state>() }
+{
+	initialize_network();
+
+	_ptr_state->desc = desc_;
+
+	auto ptr_state = _ptr_state;
+	_reconnector = thread { [ptr_state] { ptr_state->reconnect_loop(); } };
+}
+
+connection_pool::~connection_pool()
+{
+	{
+		lock_guard<mutex> l { _ptr_state->mtx };
+		_ptr_state->stopping = true;
+	}
+
+	_ptr_state->cv.notify_all();
+	_reconnector.join();
+}
+
+pooled_connection connection_pool::acquire(const string& address_, const string& port_)
+{
+	auto key = key_of(address_, port_);
+
+	unique_lock<mutex> l { _ptr_state->mtx };
+
+	auto it = _ptr_state->entries.find(key);
+	if (it == _ptr_state->entries.end())
+	{
+		pool_entry entry;
+		entry.address = address_;
+		entry.port = port_;
+
+		string local_address;
+		entry.transport = transport_of(address_, local_address);
+
+		it = _ptr_state->entries.emplace(key, move(entry)).first;
+	}
+
+	auto& entry = it->second;
+
+	while (!entry.idle.empty())
+	{
+		auto ptr_end_point = move(entry.idle.front());
+		entry.idle.pop_front();
+
+		if (is_alive(*ptr_end_point))
+		{
+			++_ptr_state->statistics.count_of_reuses;
+
+			// it's refilled in the background
+			l.unlock();
+			_ptr_state->cv.notify_all();
+
+			return { _ptr_state, move(key), move(ptr_end_point) };
+		}
+
+		++_ptr_state->statistics.count_of_stale_connections;
+	}
+
+	auto ptr_address = entry.ptr_address;
+
+	l.unlock();
+
+	unique_ptr<end_point> ptr_end_point;
+
+	try
+	{
+		ptr_end_point = _ptr_state->open(entry, ptr_address);
+	}
+	catch (...)
+	{
+		lock_guard<mutex> lock { _ptr_state->mtx };
+
+		++_ptr_state->statistics.count_of_failed_connects;
+		entry.ptr_address.reset();
+
+		throw;
+	}
+
+	l.lock();
+
+	entry.ptr_address = move(ptr_address);
+	++_ptr_state->statistics.count_of_connects;
+
+	l.unlock();
+
+	// a new key or an empty one, the background thread warms it up
+	_ptr_state->cv.notify_all();
+
+	return { _ptr_state, move(key), move(ptr_end_point) };
+}
+
+size_t connection_pool::idle(const string& address_, const string& port_) const
+{
+	lock_guard<mutex> l { _ptr_state->mtx };
+
+	auto it = _ptr_state->entries.find(key_of(address_, port_));
+
+	return it == _ptr_state->entries.end() ? 0 : it->second.idle.size();
+}
+
+connection_pool_statistics connection_pool::statistics() const
+{
+	lock_guard<mutex> l { _ptr_state->mtx };
+
+	return _ptr_state->statistics;
+}
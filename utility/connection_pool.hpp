@@ -0,0 +1,99 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+
+namespace utility
+{
+	struct connection_pool_state;
+
+	struct connection_pool_desc
+	{
+		//	idle connections kept open per address by the background thread
+		size_t warm_connections = 2;
+
+		//	the returned connections above it are closed
+		size_t max_idle_connections = 8;
+
+		//	delay of the reconnect after a failure, it's doubled by every further failure
+		std::chrono::milliseconds initial_backoff { 100 };
+		std::chrono::milliseconds max_backoff { 10 * 1000 };
+
+		size_t buffer_size = 512;
+	};
+
+	struct connection_pool_statistics
+	{
+		//	acquire() got an idle connection
+		size_t count_of_reuses = 0;
+
+		//	acquire() had to connect
+		size_t count_of_connects = 0;
+
+		//	connections opened by the background thread
+		size_t count_of_background_connects = 0;
+
+		size_t count_of_failed_connects = 0;
+
+		//	idle connections found closed by the peer
+		size_t count_of_stale_connections = 0;
+	};
+
+	//
+	//	a connection borrowed from the pool, it's returned when it's destroyed
+	//
+	class pooled_connection
+	{
+		friend class connection_pool;
+	public:
+		pooled_connection(pooled_connection&&) = default;
+		~pooled_connection();
+
+		//	the connection held so far is returned
+		pooled_connection& operator=(pooled_connection&&);
+
+		end_point& operator*() const;
+		end_point* operator->() const;
+
+		//	the connection is broken or its state is unknown, it's closed instead of returned
+		void discard();
+
+	private:
+		std::weak_ptr<connection_pool_state> _ptr_pool_state;
+		std::string _key;
+		std::unique_ptr<end_point> _ptr_end_point;
+
+		pooled_connection(std::weak_ptr<connection_pool_state>, std::string key_, std::unique_ptr<end_point>);
+	};
+
+	//
+	//	keeps warm connections to the addresses it was asked for
+	//
+	//	The addresses are keyed by address and port. The first acquire() of a key resolves
+	//	the address, the later connects reuse the result. A background thread keeps
+	//	connection_pool_desc::warm_connections idle connections for every key, so acquire()
+	//	doesn't pay for getaddrinfo and connect. After a failed connect it retries with
+	//	exponential backoff. The addresses with a scheme (see E_TRANSPORT) are pooled too,
+	//	they just aren't resolved.
+	//
+	class connection_pool
+	{
+	public:
+		connection_pool(connection_pool_desc = { });
+		~connection_pool();
+
+		connection_pool(const connection_pool&) = delete;
+		connection_pool& operator=(const connection_pool&) = delete;
+
+		//	an idle connection or a new one, throws if it's unable to connect
+		pooled_connection acquire(const std::string& address_, const std::string& port_);
+
+		//	count of the idle connections of a key
+		size_t idle(const std::string& address_, const std::string& port_) const;
+
+		connection_pool_statistics statistics() const;
+
+	private:
+		std::shared_ptr<connection_pool_state> _ptr_state;
+		std::thread _reconnector;
+	};
+}
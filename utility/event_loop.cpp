@@ -0,0 +1,1394 @@
+#include "stdafx.h"
+#include "event_loop.hpp"
+
+#include <mswsock.h>
+
+#include <map>
+
+using namespace utility;
+using namespace std;
+
+
+namespace
+{
+	exception_ptr socket_error(const char* operation_, int ec_)
+	{
+		stringstream sb;
+		sb << operation_ << " failed with error: " << ec_;
+
+		return make_exception_ptr(runtime_error { sb.str() });
+	}
+
+	exception_ptr aborted_error()
+	{
+		return make_exception_ptr(runtime_error { "operation aborted: the end_point was detached" });
+	}
+
+	function<void()> bind_handler(io_handler handler_, size_t size_, exception_ptr error_)
+	{
+		return [handler_, size_, error_]
+		{
+			handler_(size_, error_);
+		};
+	}
+
+	//	the block of a slice read or write is held until the handler is called
+	struct pending_read
+	{
+		char* ptr_data;
+		size_t size;
+		io_handler handler;
+		buffer_slice block;
+	};
+
+	struct pending_write
+	{
+		const char* ptr_data;
+		size_t size;
+		size_t sent;
+		io_handler handler;
+		buffer_slice block;
+	};
+
+	struct acceptor_state
+	{
+		size_t buffer_size;
+		accept_handler handler;
+	};
+
+	//
+	//	a worker thread of the event_loop, which serves a shard of the sockets
+	//
+	class io_worker
+	{
+	public:
+		io_worker(thread_pool& completion_pool_)
+			: _completion_pool { completion_pool_ }
+		{
+		}
+
+		virtual ~io_worker() = default;
+
+		virtual void add(SOCKET) = 0;
+		virtual void remove(SOCKET) = 0;
+
+		virtual void read(SOCKET, char* ptr_data_, size_t size_, io_handler, buffer_slice block_) = 0;
+		virtual void write(SOCKET, const char* ptr_data_, size_t size_, io_handler, buffer_slice block_) = 0;
+
+		virtual size_t size() const = 0;
+
+	protected:
+		//	the handlers must not be called while the worker holds its lock
+		void _dispatch(vector<function<void()>>& ready_handlers_)
+		{
+			for (auto& h : ready_handlers_)
+			{
+				_completion_pool.submit(move(h));
+			}
+
+			ready_handlers_.clear();
+		}
+
+	private:
+		thread_pool& _completion_pool;
+	};
+
+	//
+	//	WSAPoll can't wait for anything else but sockets, so the poller is woken up
+	//	by a datagram which is sent to itself
+	//
+	class wake_socket
+	{
+	public:
+		wake_socket()
+		{
+			_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+			if (_socket == INVALID_SOCKET)
+			{
+				stringstream sb;
+				sb << "socket failed with error: " << WSAGetLastError();
+				throw runtime_error { sb.str() };
+			}
+
+			sockaddr_in address;
+			ZeroMemory(&address, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			address.sin_port = 0;
+
+			int address_size = sizeof(address);
+
+			if (::bind(_socket, reinterpret_cast<sockaddr*>(&address), address_size) == SOCKET_ERROR
+				|| getsockname(_socket, reinterpret_cast<sockaddr*>(&address), &address_size) == SOCKET_ERROR
+				|| connect(_socket, reinterpret_cast<sockaddr*>(&address), address_size) == SOCKET_ERROR)
+			{
+				stringstream sb;
+				sb << "unable to set up the wake socket, error: " << WSAGetLastError();
+
+				closesocket(_socket);
+				throw runtime_error { sb.str() };
+			}
+
+			u_long mode = 1;
+			ioctlsocket(_socket, FIONBIO, &mode);
+		}
+
+		~wake_socket()
+		{
+			closesocket(_socket);
+		}
+
+		SOCKET handle() const
+		{
+			return _socket;
+		}
+
+		void notify()
+		{
+			if (!_notified.exchange(true))
+			{
+				char signal = 0;
+				send(_socket, &signal, 1, 0);
+			}
+		}
+
+		void drain()
+		{
+			_notified = false;
+
+			char buffer[64];
+			while (recv(_socket, buffer, sizeof(buffer), 0) > 0)
+			{
+			}
+		}
+
+	private:
+		SOCKET _socket { INVALID_SOCKET };
+		atomic_bool _notified { false };
+	};
+
+	class poll_worker : public io_worker
+	{
+	public:
+		poll_worker(thread_pool& completion_pool_)
+			: io_worker { completion_pool_ }
+		{
+			_thread = thread { &poll_worker::_run, this };
+		}
+
+		~poll_worker()
+		{
+			{
+				lock_guard<mutex> l { _mtx };
+				_terminating = true;
+			}
+
+			_wake.notify();
+			_thread.join();
+		}
+
+		void add(SOCKET socket_) override
+		{
+			lock_guard<mutex> l { _mtx };
+
+			_connections[socket_];
+		}
+
+		void remove(SOCKET socket_) override
+		{
+			vector<function<void()>> ready_handlers;
+			{
+				lock_guard<mutex> l { _mtx };
+
+				auto it = _connections.find(socket_);
+				if (it == _connections.end())
+				{
+					return;
+				}
+
+				for (auto& r : it->second.reads)
+				{
+					ready_handlers.push_back(bind_handler(move(r.handler), 0, aborted_error()));
+				}
+
+				for (auto& w : it->second.writes)
+				{
+					ready_handlers.push_back(bind_handler(move(w.handler), w.sent, aborted_error()));
+				}
+
+				_connections.erase(it);
+				_active.erase(socket_);
+			}
+
+			_dispatch(ready_handlers);
+			_wake.notify();
+		}
+
+		void read(SOCKET socket_, char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_) override
+		{
+			vector<function<void()>> ready_handlers;
+			{
+				lock_guard<mutex> l { _mtx };
+
+				auto& state = _state_of(socket_);
+
+				state.reads.push_back({ ptr_data_, size_, move(handler_), move(block_) });
+
+				// keep the order: try it right away only when nothing waits before it
+				if (state.reads.size() == 1)
+				{
+					_drain_reads(socket_, state, ready_handlers);
+				}
+
+				_update_interest(socket_, state);
+			}
+
+			_dispatch(ready_handlers);
+		}
+
+		void write(SOCKET socket_, const char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_) override
+		{
+			vector<function<void()>> ready_handlers;
+			{
+				lock_guard<mutex> l { _mtx };
+
+				auto& state = _state_of(socket_);
+
+				state.writes.push_back({ ptr_data_, size_, 0, move(handler_), move(block_) });
+
+				if (state.writes.size() == 1)
+				{
+					_drain_writes(socket_, state, ready_handlers);
+				}
+
+				_update_interest(socket_, state);
+			}
+
+			_dispatch(ready_handlers);
+		}
+
+		size_t size() const override
+		{
+			lock_guard<mutex> l { _mtx };
+
+			return _connections.size();
+		}
+
+		//	the listening sockets are polled all the time
+		void start_accepting(SOCKET listen_socket_, size_t buffer_size_, accept_handler handler_)
+		{
+			u_long mode = 1;
+			ioctlsocket(listen_socket_, FIONBIO, &mode);
+
+			{
+				lock_guard<mutex> l { _mtx };
+
+				_acceptors[listen_socket_] = { buffer_size_, move(handler_) };
+			}
+
+			_wake.notify();
+		}
+
+		void stop_accepting(SOCKET listen_socket_)
+		{
+			{
+				lock_guard<mutex> l { _mtx };
+
+				_acceptors.erase(listen_socket_);
+			}
+
+			_wake.notify();
+		}
+
+	private:
+		struct connection_state
+		{
+			deque<pending_read> reads;
+			deque<pending_write> writes;
+
+			//	the events the socket is polled for
+			SHORT interest = 0;
+		};
+
+		mutable mutex _mtx;
+		unordered_map<SOCKET, connection_state> _connections;
+		unordered_map<SOCKET, acceptor_state> _acceptors;
+
+		//	sockets with pending operations, only these are polled
+		unordered_set<SOCKET> _active;
+
+		bool _terminating = false;
+		wake_socket _wake;
+
+		//	the last member: it's started when the others are ready to use
+		thread _thread;
+
+		connection_state& _state_of(SOCKET socket_)
+		{
+			auto it = _connections.find(socket_);
+			if (it == _connections.end())
+			{
+				throw logic_error { "the end_point is not attached to this event_loop" };
+			}
+
+			return it->second;
+		}
+
+		//	the poller is woken up by any change of the events, e.g. a write blocked behind a pending read
+		void _update_interest(SOCKET socket_, connection_state& state_)
+		{
+			SHORT interest = 0;
+			if (!state_.reads.empty()) interest |= POLLRDNORM;
+			if (!state_.writes.empty()) interest |= POLLWRNORM;
+
+			if (interest == state_.interest)
+			{
+				return;
+			}
+
+			state_.interest = interest;
+
+			if (interest == 0)
+			{
+				_active.erase(socket_);
+			}
+			else
+			{
+				_active.insert(socket_);
+				_wake.notify();
+			}
+		}
+
+		void _drain_reads(SOCKET socket_, connection_state& state_, vector<function<void()>>& ready_handlers_)
+		{
+			while (!state_.reads.empty())
+			{
+				auto& r = state_.reads.front();
+
+				auto status_or_size = recv(socket_, r.ptr_data, static_cast<int>(r.size), 0);
+				if (status_or_size == SOCKET_ERROR)
+				{
+					int ec = WSAGetLastError();
+					if (ec == WSAEWOULDBLOCK)
+					{
+						return;
+					}
+
+					ready_handlers_.push_back(bind_handler(move(r.handler), 0, socket_error("recv", ec)));
+				}
+				else
+				{
+					// zero means that the peer has disconnected
+					bytes_received_counter().add(status_or_size);
+					ready_handlers_.push_back(bind_handler(move(r.handler), static_cast<size_t>(status_or_size), nullptr));
+				}
+
+				state_.reads.pop_front();
+			}
+		}
+
+		void _drain_writes(SOCKET socket_, connection_state& state_, vector<function<void()>>& ready_handlers_)
+		{
+			while (!state_.writes.empty())
+			{
+				auto& w = state_.writes.front();
+
+				while (w.sent < w.size)
+				{
+					int i_result = send(socket_, w.ptr_data + w.sent, static_cast<int>(w.size - w.sent), 0);
+					if (i_result == SOCKET_ERROR)
+					{
+						int ec = WSAGetLastError();
+						if (ec == WSAEWOULDBLOCK)
+						{
+							return;
+						}
+
+						ready_handlers_.push_back(bind_handler(move(w.handler), w.sent, socket_error("send", ec)));
+						break;
+					}
+
+					w.sent += i_result;
+					bytes_sent_counter().add(i_result);
+				}
+
+				if (w.sent == w.size)
+				{
+					ready_handlers_.push_back(bind_handler(move(w.handler), w.sent, nullptr));
+				}
+
+				state_.writes.pop_front();
+			}
+		}
+
+		void _drain_accepts(SOCKET listen_socket_, const acceptor_state& acceptor_, vector<function<void()>>& ready_handlers_)
+		{
+			for (;;)
+			{
+				auto new_socket = accept(listen_socket_, NULL, NULL);
+				if (new_socket == INVALID_SOCKET)
+				{
+					int ec = WSAGetLastError();
+					if (ec != WSAEWOULDBLOCK)
+					{
+						auto handler = acceptor_.handler;
+						auto error = socket_error("accept", ec);
+
+						ready_handlers_.push_back([handler, error] { handler(nullptr, error); });
+					}
+
+					return;
+				}
+
+				// the accepted socket inherits the non-blocking mode
+				u_long mode = 0;
+				ioctlsocket(new_socket, FIONBIO, &mode);
+
+				auto handler = acceptor_.handler;
+				auto ptr_end_point = make_shared<end_point>(new_socket, acceptor_.buffer_size);
+
+				ready_handlers_.push_back([handler, ptr_end_point] { handler(ptr_end_point, nullptr); });
+			}
+		}
+
+		void _run()
+		{
+			vector<WSAPOLLFD> fds;
+			vector<function<void()>> ready_handlers;
+
+			for (;;)
+			{
+				fds.clear();
+				fds.push_back({ _wake.handle(), POLLRDNORM, 0 });
+				{
+					lock_guard<mutex> l { _mtx };
+
+					if (_terminating)
+					{
+						return;
+					}
+
+					for (auto& kv : _acceptors)
+					{
+						fds.push_back({ kv.first, POLLRDNORM, 0 });
+					}
+
+					for (auto s : _active)
+					{
+						fds.push_back({ s, _connections[s].interest, 0 });
+					}
+				}
+
+				//	e.g. a socket was closed after its detach, the next round polls the current ones,
+				//	but a persistent error isn't retried in a busy loop
+				if (WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), -1) == SOCKET_ERROR)
+				{
+					this_thread::sleep_for(chrono::milliseconds { 10 });
+					continue;
+				}
+
+				if (fds[0].revents)
+				{
+					_wake.drain();
+				}
+
+				{
+					lock_guard<mutex> l { _mtx };
+
+					for (size_t i = 1; i < fds.size(); ++i)
+					{
+						const auto revents = fds[i].revents;
+						if (revents == 0)
+						{
+							continue;
+						}
+
+						auto it_acceptor = _acceptors.find(fds[i].fd);
+						if (it_acceptor != _acceptors.end())
+						{
+							_drain_accepts(fds[i].fd, it_acceptor->second, ready_handlers);
+							continue;
+						}
+
+						auto it = _connections.find(fds[i].fd);
+						if (it == _connections.end())
+						{
+							// detached in the meantime
+							continue;
+						}
+
+						auto& state = it->second;
+
+						// errors and hang-ups are reported by the next recv/send
+						if (revents & (POLLRDNORM | POLLHUP | POLLERR | POLLNVAL))
+						{
+							_drain_reads(fds[i].fd, state, ready_handlers);
+						}
+
+						if (revents & (POLLWRNORM | POLLHUP | POLLERR | POLLNVAL))
+						{
+							_drain_writes(fds[i].fd, state, ready_handlers);
+						}
+
+						_update_interest(fds[i].fd, state);
+					}
+				}
+
+				_dispatch(ready_handlers);
+			}
+		}
+	};
+
+	RIO_EXTENSION_FUNCTION_TABLE load_registered_io()
+	{
+		initialize_network();
+
+		auto s = open_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+		GUID function_table_id = WSAID_MULTIPLE_RIO;
+		DWORD bytes = 0;
+
+		RIO_EXTENSION_FUNCTION_TABLE rio;
+		ZeroMemory(&rio, sizeof(rio));
+		rio.cbSize = sizeof(rio);
+
+		int i_result = WSAIoctl(s, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER
+			, &function_table_id, sizeof(GUID), &rio, sizeof(rio), &bytes, NULL, NULL);
+
+		int ec = WSAGetLastError();
+		closesocket(s);
+
+		if (i_result == SOCKET_ERROR)
+		{
+			stringstream sb;
+			sb << "registered I/O is not supported, WSAIoctl failed with error: " << ec;
+			throw runtime_error { sb.str() };
+		}
+
+		return rio;
+	}
+
+	//
+	//	the blocks of the buffer_pool of a registered I/O event_loop
+	//
+	//	The blocks are carved out of registered chunks, so a single registration serves many
+	//	blocks, the larger blocks are registered one by one. A freed block is kept for the
+	//	next one of the same size, only the oversized ones are deregistered.
+	//
+	class registered_memory : public block_allocator
+	{
+		static constexpr size_t CHUNK_SIZE = buffer_pool::MAX_BLOCK_SIZE;
+
+	public:
+		explicit registered_memory(const RIO_EXTENSION_FUNCTION_TABLE& rio_)
+			: _rio { rio_ }
+		{
+		}
+
+		~registered_memory()
+		{
+			for (auto& kv : _chunks)
+			{
+				_rio.RIODeregisterBuffer(kv.second.id);
+				VirtualFree(const_cast<char*>(kv.first), 0, MEM_RELEASE);
+			}
+		}
+
+		char* allocate(size_t size_) override
+		{
+			lock_guard<mutex> l { _mtx };
+
+			auto& free_blocks = _free_blocks[size_];
+			if (!free_blocks.empty())
+			{
+				auto ptr_block = free_blocks.back();
+				free_blocks.pop_back();
+
+				return ptr_block;
+			}
+
+			if (size_ >= CHUNK_SIZE)
+			{
+				return _register(size_);
+			}
+
+			if (_free_size < size_)
+			{
+				// the rest of the current chunk is left unused
+				_ptr_free = _register(CHUNK_SIZE);
+				_free_size = CHUNK_SIZE;
+			}
+
+			auto ptr_block = _ptr_free;
+
+			_ptr_free += size_;
+			_free_size -= size_;
+
+			return ptr_block;
+		}
+
+		void deallocate(char* ptr_block_, size_t size_) override
+		{
+			lock_guard<mutex> l { _mtx };
+
+			if (size_ > CHUNK_SIZE)
+			{
+				auto it = _chunks.find(ptr_block_);
+
+				_rio.RIODeregisterBuffer(it->second.id);
+				VirtualFree(ptr_block_, 0, MEM_RELEASE);
+
+				_chunks.erase(it);
+				return;
+			}
+
+			_free_blocks[size_].push_back(ptr_block_);
+		}
+
+		//	false if the data isn't in the registered memory
+		bool find(const char* ptr_data_, size_t size_, RIO_BUF& buffer_) const
+		{
+			lock_guard<mutex> l { _mtx };
+
+			auto it = _chunks.upper_bound(ptr_data_);
+			if (it == _chunks.begin())
+			{
+				return false;
+			}
+
+			--it;
+
+			const auto offset = static_cast<size_t>(ptr_data_ - it->first);
+			if (offset + size_ > it->second.size)
+			{
+				return false;
+			}
+
+			buffer_.BufferId = it->second.id;
+			buffer_.Offset = static_cast<ULONG>(offset);
+			buffer_.Length = static_cast<ULONG>(size_);
+
+			return true;
+		}
+
+	private:
+		struct chunk
+		{
+			RIO_BUFFERID id;
+			size_t size;
+		};
+
+		const RIO_EXTENSION_FUNCTION_TABLE _rio;
+
+		mutable mutex _mtx;
+
+		//	the beginning of the chunk -> its registration
+		map<const char*, chunk> _chunks;
+
+		//	size -> freed blocks
+		unordered_map<size_t, vector<char*>> _free_blocks;
+
+		char* _ptr_free = nullptr;
+		size_t _free_size = 0;
+
+		char* _register(size_t size_)
+		{
+			auto ptr_memory = static_cast<char*>(VirtualAlloc(NULL, size_, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			if (ptr_memory == nullptr)
+			{
+				throw bad_alloc { };
+			}
+
+			auto id = _rio.RIORegisterBuffer(ptr_memory, static_cast<DWORD>(size_));
+			if (id == RIO_INVALID_BUFFERID)
+			{
+				stringstream sb;
+				sb << "RIORegisterBuffer failed with error: " << WSAGetLastError();
+
+				VirtualFree(ptr_memory, 0, MEM_RELEASE);
+				throw runtime_error { sb.str() };
+			}
+
+			_chunks[ptr_memory] = { id, size_ };
+
+			return ptr_memory;
+		}
+	};
+
+	//
+	//	Registered I/O worker
+	//
+	//	The data of the slice reads and writes is received and sent in place, when their block
+	//	is in the registered memory, e.g. it's from event_loop::acquire_buffer(). The other
+	//	buffers are copied through the blocks of the pool: a read into one block of its size,
+	//	a write in pieces of up to buffer_pool::MAX_BLOCK_SIZE.
+	//	The requests are issued with RIO_MSG_DEFER and committed by the worker thread once per
+	//	round, the completions are dequeued in batches. Up to MAX_SENDS_IN_FLIGHT pieces of the
+	//	writes are sent at once.
+	//
+	class registered_io_worker : public io_worker
+	{
+		static constexpr ULONG MAX_SENDS_IN_FLIGHT = 8;
+		static constexpr ULONG MAX_RESULTS_PER_DEQUEUE = 256;
+
+		enum E_REQUEST : size_t { REQUEST_RECEIVE = 1, REQUEST_SEND = 2 };
+
+	public:
+		registered_io_worker(thread_pool& completion_pool_, const RIO_EXTENSION_FUNCTION_TABLE& rio_
+			, buffer_pool& buffer_pool_, const registered_memory& memory_)
+			: io_worker { completion_pool_ }
+			, _rio { rio_ }
+			, _buffer_pool { buffer_pool_ }
+			, _memory { memory_ }
+		{
+			_completion_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+			_wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+			RIO_NOTIFICATION_COMPLETION notification;
+			ZeroMemory(&notification, sizeof(notification));
+			notification.Type = RIO_EVENT_COMPLETION;
+			notification.Event.EventHandle = _completion_event;
+			notification.Event.NotifyReset = TRUE;
+
+			_completion_queue = _rio.RIOCreateCompletionQueue(_completion_queue_size, &notification);
+			if (_completion_queue == RIO_INVALID_CQ)
+			{
+				stringstream sb;
+				sb << "RIOCreateCompletionQueue failed with error: " << WSAGetLastError();
+
+				CloseHandle(_completion_event);
+				CloseHandle(_wake_event);
+
+				throw runtime_error { sb.str() };
+			}
+
+			_rio.RIONotify(_completion_queue);
+
+			_thread = thread { &registered_io_worker::_run, this };
+		}
+
+		~registered_io_worker()
+		{
+			{
+				lock_guard<mutex> l { _mtx };
+				_terminating = true;
+			}
+
+			SetEvent(_wake_event);
+			_thread.join();
+
+			_rio.RIOCloseCompletionQueue(_completion_queue);
+
+			CloseHandle(_completion_event);
+			CloseHandle(_wake_event);
+		}
+
+		void add(SOCKET socket_) override
+		{
+			lock_guard<mutex> l { _mtx };
+
+			// every connection may have one receive and MAX_SENDS_IN_FLIGHT sends in flight
+			const DWORD required_size = (1 + MAX_SENDS_IN_FLIGHT) * static_cast<DWORD>(_connections.size() + _zombies.size() + 1);
+
+			if (_completion_queue_size < required_size)
+			{
+				const DWORD new_size = 2 * _completion_queue_size < required_size ? required_size : 2 * _completion_queue_size;
+
+				if (!_rio.RIOResizeCompletionQueue(_completion_queue, new_size))
+				{
+					stringstream sb;
+					sb << "RIOResizeCompletionQueue failed with error: " << WSAGetLastError();
+					throw runtime_error { sb.str() };
+				}
+
+				_completion_queue_size = new_size;
+			}
+
+			auto ptr_connection = make_unique<connection_state>();
+			ptr_connection->socket = socket_;
+
+			ptr_connection->request_queue = _rio.RIOCreateRequestQueue(socket_, 1, 1, MAX_SENDS_IN_FLIGHT, 1
+				, _completion_queue, _completion_queue, ptr_connection.get());
+
+			if (ptr_connection->request_queue == RIO_INVALID_RQ)
+			{
+				stringstream sb;
+				sb << "RIOCreateRequestQueue failed with error: " << WSAGetLastError()
+					<< " (the socket must be created by utility::open_socket)";
+
+				throw runtime_error { sb.str() };
+			}
+
+			_connections[socket_] = move(ptr_connection);
+		}
+
+		void remove(SOCKET socket_) override
+		{
+			vector<function<void()>> ready_handlers;
+			{
+				lock_guard<mutex> l { _mtx };
+
+				auto it = _connections.find(socket_);
+				if (it == _connections.end())
+				{
+					return;
+				}
+
+				auto& connection = *it->second;
+
+				for (auto& r : connection.reads)
+				{
+					ready_handlers.push_back(bind_handler(move(r.handler), 0, aborted_error()));
+				}
+
+				for (auto& w : connection.writes)
+				{
+					ready_handlers.push_back(bind_handler(move(w.handler), w.sent, aborted_error()));
+				}
+
+				connection.reads.clear();
+				connection.writes.clear();
+
+				_uncommitted.erase(&connection);
+
+				if (connection.receive_in_flight || !connection.sends.empty())
+				{
+					// their blocks are still in use, the requests complete when the socket gets closed
+					connection.detached = true;
+					_zombies.insert(move(it->second));
+				}
+
+				_connections.erase(it);
+			}
+
+			_dispatch(ready_handlers);
+		}
+
+		void read(SOCKET socket_, char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_) override
+		{
+			vector<function<void()>> ready_handlers;
+			{
+				lock_guard<mutex> l { _mtx };
+
+				auto& connection = _state_of(socket_);
+
+				connection.reads.push_back({ ptr_data_, size_, move(handler_), move(block_) });
+
+				_post_receive(connection, ready_handlers);
+			}
+
+			_dispatch(ready_handlers);
+			SetEvent(_wake_event);
+		}
+
+		void write(SOCKET socket_, const char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_) override
+		{
+			vector<function<void()>> ready_handlers;
+			{
+				lock_guard<mutex> l { _mtx };
+
+				auto& connection = _state_of(socket_);
+
+				connection.writes.push_back({ ptr_data_, size_, 0, move(handler_), move(block_), connection.next_write_id++, 0 });
+
+				_post_sends(connection, ready_handlers);
+			}
+
+			_dispatch(ready_handlers);
+			SetEvent(_wake_event);
+		}
+
+		size_t size() const override
+		{
+			lock_guard<mutex> l { _mtx };
+
+			return _connections.size();
+		}
+
+	private:
+		struct outstanding_write
+		{
+			const char* ptr_data;
+			size_t size;
+			size_t sent;
+			io_handler handler;
+			buffer_slice block;
+
+			size_t id;
+
+			//	the bytes handed over to the requests
+			size_t posted;
+		};
+
+		//	a piece of a write in flight, its block is held until it completes
+		struct send_request
+		{
+			size_t write_id;
+			ULONG size;
+			buffer_slice block;
+		};
+
+		struct connection_state
+		{
+			SOCKET socket { INVALID_SOCKET };
+			RIO_RQ request_queue { RIO_INVALID_RQ };
+
+			deque<pending_read> reads;
+			deque<outstanding_write> writes;
+
+			bool receive_in_flight = false;
+
+			//	the block of the receive in flight, it's either the block of the read or a copy
+			buffer_slice receive_block;
+			bool is_received_in_place = false;
+
+			//	in the order of their completion
+			deque<send_request> sends;
+
+			size_t next_write_id = 0;
+
+			bool detached = false;
+		};
+
+		const RIO_EXTENSION_FUNCTION_TABLE _rio;
+
+		buffer_pool& _buffer_pool;
+		const registered_memory& _memory;
+
+		RIO_CQ _completion_queue { RIO_INVALID_CQ };
+		DWORD _completion_queue_size = 1024;
+
+		HANDLE _completion_event { NULL };
+		HANDLE _wake_event { NULL };
+
+		mutable mutex _mtx;
+		unordered_map<SOCKET, unique_ptr<connection_state>> _connections;
+
+		//	detached connections with requests in flight
+		unordered_set<unique_ptr<connection_state>> _zombies;
+
+		//	connections with deferred requests, committed by the worker thread
+		unordered_set<connection_state*> _uncommitted;
+
+		bool _terminating = false;
+
+		//	the last member: it's started when the others are ready to use
+		thread _thread;
+
+		connection_state& _state_of(SOCKET socket_)
+		{
+			auto it = _connections.find(socket_);
+			if (it == _connections.end())
+			{
+				throw logic_error { "the end_point is not attached to this event_loop" };
+			}
+
+			return *it->second;
+		}
+
+		//	the data is copied through a block of the pool
+		buffer_slice _acquire_block(const char* ptr_data_, size_t size_, RIO_BUF& buffer_)
+		{
+			auto block = _buffer_pool.acquire(size_);
+
+			if (ptr_data_)
+			{
+				memcpy(block.first, ptr_data_, size_);
+			}
+
+			_memory.find(block.first, size_, buffer_);
+
+			return move(block.second);
+		}
+
+		void _post_receive(connection_state& connection_, vector<function<void()>>& ready_handlers_)
+		{
+			if (connection_.receive_in_flight || connection_.reads.empty())
+			{
+				return;
+			}
+
+			const auto& r = connection_.reads.front();
+
+			try
+			{
+				RIO_BUF buffer;
+
+				connection_.is_received_in_place = !r.block.empty() && r.size <= MAXLONG && _memory.find(r.ptr_data, r.size, buffer);
+
+				if (connection_.is_received_in_place)
+				{
+					connection_.receive_block = r.block;
+				}
+				else
+				{
+					// it's copied into the buffer of the read at the completion
+					const size_t size = r.size < buffer_pool::MAX_BLOCK_SIZE ? r.size : buffer_pool::MAX_BLOCK_SIZE;
+
+					connection_.receive_block = _acquire_block(nullptr, size, buffer);
+				}
+
+				if (!_rio.RIOReceive(connection_.request_queue, &buffer, 1, RIO_MSG_DEFER, reinterpret_cast<PVOID>(REQUEST_RECEIVE)))
+				{
+					rethrow_exception(socket_error("RIOReceive", WSAGetLastError()));
+				}
+			}
+			catch (...)
+			{
+				connection_.receive_block = { };
+
+				ready_handlers_.push_back(bind_handler(move(connection_.reads.front().handler), 0, current_exception()));
+				connection_.reads.pop_front();
+
+				return;
+			}
+
+			connection_.receive_in_flight = true;
+			_uncommitted.insert(&connection_);
+		}
+
+		void _post_sends(connection_state& connection_, vector<function<void()>>& ready_handlers_)
+		{
+			auto it = connection_.writes.begin();
+
+			while (it != connection_.writes.end() && connection_.sends.size() < MAX_SENDS_IN_FLIGHT)
+			{
+				auto& w = *it;
+
+				if (w.posted == w.size)
+				{
+					++it;
+					continue;
+				}
+
+				try
+				{
+					_post_send(connection_, w);
+				}
+				catch (...)
+				{
+					// its pieces in flight are ignored by their completions
+					ready_handlers_.push_back(bind_handler(move(w.handler), w.sent, current_exception()));
+					it = connection_.writes.erase(it);
+				}
+			}
+		}
+
+		void _post_send(connection_state& connection_, outstanding_write& w_)
+		{
+			const char* ptr_data = w_.ptr_data + w_.posted;
+			const size_t remaining = w_.size - w_.posted;
+
+			RIO_BUF buffer;
+			buffer_slice block;
+
+			if (!w_.block.empty() && remaining <= MAXLONG && _memory.find(ptr_data, remaining, buffer))
+			{
+				block = w_.block;
+			}
+			else
+			{
+				block = _acquire_block(ptr_data, remaining < buffer_pool::MAX_BLOCK_SIZE ? remaining : buffer_pool::MAX_BLOCK_SIZE, buffer);
+			}
+
+			if (!_rio.RIOSend(connection_.request_queue, &buffer, 1, RIO_MSG_DEFER, reinterpret_cast<PVOID>(REQUEST_SEND)))
+			{
+				rethrow_exception(socket_error("RIOSend", WSAGetLastError()));
+			}
+
+			connection_.sends.push_back({ w_.id, buffer.Length, move(block) });
+			w_.posted += buffer.Length;
+
+			_uncommitted.insert(&connection_);
+		}
+
+		//	a single commit call per connection per round, however many requests were deferred
+		void _commit()
+		{
+			for (auto ptr_connection : _uncommitted)
+			{
+				_rio.RIOReceive(ptr_connection->request_queue, NULL, 0, RIO_MSG_COMMIT_ONLY, NULL);
+				_rio.RIOSend(ptr_connection->request_queue, NULL, 0, RIO_MSG_COMMIT_ONLY, NULL);
+			}
+
+			_uncommitted.clear();
+		}
+
+		void _on_completion(const RIORESULT& result_, vector<function<void()>>& ready_handlers_)
+		{
+			auto ptr_connection = reinterpret_cast<connection_state*>(static_cast<ULONG_PTR>(result_.SocketContext));
+			const auto request = static_cast<E_REQUEST>(result_.RequestContext);
+
+			auto& connection = *ptr_connection;
+
+			if (request == REQUEST_RECEIVE)
+			{
+				connection.receive_in_flight = false;
+
+				auto block = move(connection.receive_block);
+
+				if (!connection.reads.empty())
+				{
+					auto r = move(connection.reads.front());
+					connection.reads.pop_front();
+
+					if (result_.Status != NO_ERROR)
+					{
+						ready_handlers_.push_back(bind_handler(move(r.handler), 0, socket_error("RIOReceive", result_.Status)));
+					}
+					else
+					{
+						if (!connection.is_received_in_place)
+						{
+							memcpy(r.ptr_data, block.data(), result_.BytesTransferred);
+						}
+
+						// zero means that the peer has disconnected
+						bytes_received_counter().add(result_.BytesTransferred);
+						ready_handlers_.push_back(bind_handler(move(r.handler), result_.BytesTransferred, nullptr));
+					}
+				}
+			}
+			else
+			{
+				auto piece = move(connection.sends.front());
+				connection.sends.pop_front();
+
+				// the write may have failed already
+				if (!connection.writes.empty() && connection.writes.front().id == piece.write_id)
+				{
+					auto& w = connection.writes.front();
+
+					if (result_.Status != NO_ERROR)
+					{
+						ready_handlers_.push_back(bind_handler(move(w.handler), w.sent, socket_error("RIOSend", result_.Status)));
+						connection.writes.pop_front();
+					}
+					else if (result_.BytesTransferred != piece.size)
+					{
+						// the pieces after it are in flight, the stream can't be continued
+						ready_handlers_.push_back(bind_handler(move(w.handler), w.sent + result_.BytesTransferred
+							, make_exception_ptr(runtime_error { "RIOSend completed only a part of the data" })));
+						connection.writes.pop_front();
+					}
+					else
+					{
+						w.sent += result_.BytesTransferred;
+						bytes_sent_counter().add(result_.BytesTransferred);
+
+						if (w.sent == w.size)
+						{
+							ready_handlers_.push_back(bind_handler(move(w.handler), w.sent, nullptr));
+							connection.writes.pop_front();
+						}
+					}
+				}
+			}
+
+			if (connection.detached)
+			{
+				if (!connection.receive_in_flight && connection.sends.empty())
+				{
+					_zombies.erase(find_if(_zombies.begin(), _zombies.end(), [&](const unique_ptr<connection_state>& ptr_)
+					{
+						return ptr_.get() == ptr_connection;
+					}));
+				}
+
+				return;
+			}
+
+			_post_receive(connection, ready_handlers_);
+			_post_sends(connection, ready_handlers_);
+		}
+
+		void _run()
+		{
+			vector<function<void()>> ready_handlers;
+			vector<RIORESULT> results(MAX_RESULTS_PER_DEQUEUE);
+
+			HANDLE events[] = { _completion_event, _wake_event };
+
+			for (;;)
+			{
+				const auto signaled = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+				{
+					lock_guard<mutex> l { _mtx };
+
+					if (_terminating)
+					{
+						return;
+					}
+
+					_commit();
+
+					if (signaled == WAIT_OBJECT_0)
+					{
+						for (;;)
+						{
+							const auto count = _rio.RIODequeueCompletion(_completion_queue, results.data(), MAX_RESULTS_PER_DEQUEUE);
+							if (count == 0 || count == RIO_CORRUPT_CQ)
+							{
+								break;
+							}
+
+							for (ULONG i = 0; i < count; ++i)
+							{
+								_on_completion(results[i], ready_handlers);
+							}
+						}
+
+						// the follow-up requests of the completions
+						_commit();
+
+						_rio.RIONotify(_completion_queue);
+					}
+				}
+
+				_dispatch(ready_handlers);
+			}
+		}
+	};
+}
+
+
+struct utility::event_loop_impl
+{
+	E_IO_BACKEND backend;
+
+	//	it outlives the workers, which use it
+	unique_ptr<buffer_pool> ptr_buffer_pool;
+
+	vector<unique_ptr<io_worker>> workers;
+
+	//	the listening sockets are served by readiness with either backend
+	poll_worker* ptr_acceptor = nullptr;
+	unique_ptr<poll_worker> dedicated_acceptor;
+
+	io_worker& worker_of(SOCKET socket_)
+	{
+		// the socket handles are multiple of 4
+		return *workers[(socket_ >> 2) % workers.size()];
+	}
+};
+
+
+event_loop::event_loop(thread_pool& completion_pool_, size_t count_of_threads_, E_IO_BACKEND backend_)
+	: _pimpl { make_unique<event_loop_impl>() }
+{
+	initialize_network();
+
+	_pimpl->backend = backend_;
+
+	const size_t count_of_workers = count_of_threads_ > 0 ? count_of_threads_ : 1;
+
+	_pimpl->workers.reserve(count_of_workers);
+
+	if (backend_ == IO_BACKEND_REGISTERED_IO)
+	{
+		const auto rio = load_registered_io();
+
+		// the buffers are registered once for all the workers
+		auto ptr_memory = make_shared<registered_memory>(rio);
+		_pimpl->ptr_buffer_pool = make_unique<buffer_pool>(buffer_pool::DEFAULT_MAX_CACHED_BYTES, ptr_memory);
+
+		for (size_t i = 0; i < count_of_workers; ++i)
+		{
+			_pimpl->workers.push_back(make_unique<registered_io_worker>(completion_pool_, rio, *_pimpl->ptr_buffer_pool, *ptr_memory));
+		}
+	}
+	else
+	{
+		_pimpl->ptr_buffer_pool = make_unique<buffer_pool>();
+
+		for (size_t i = 0; i < count_of_workers; ++i)
+		{
+			_pimpl->workers.push_back(make_unique<poll_worker>(completion_pool_));
+		}
+	}
+
+	if (backend_ == IO_BACKEND_POLL)
+	{
+		// no need for an extra thread
+		_pimpl->ptr_acceptor = static_cast<poll_worker*>(_pimpl->workers.front().get());
+	}
+	else
+	{
+		_pimpl->dedicated_acceptor = make_unique<poll_worker>(completion_pool_);
+		_pimpl->ptr_acceptor = _pimpl->dedicated_acceptor.get();
+	}
+}
+
+event_loop::~event_loop() = default;
+
+void event_loop::attach(end_point& end_point_)
+{
+	if (end_point_._ptr_event_loop)
+	{
+		throw logic_error { "the end_point is already attached to an event_loop" };
+	}
+
+	end_point_.set_non_blocking(true);
+
+	_pimpl->worker_of(end_point_._socket).add(end_point_._socket);
+
+	end_point_._ptr_event_loop = this;
+}
+
+void event_loop::detach(end_point& end_point_)
+{
+	if (end_point_._ptr_event_loop != this)
+	{
+		return;
+	}
+
+	_pimpl->worker_of(end_point_._socket).remove(end_point_._socket);
+
+	end_point_._ptr_event_loop = nullptr;
+
+	// restore the blocking mode for the synchronous read/write, it may be called from a dtor
+	u_long mode = 0;
+	ioctlsocket(end_point_._socket, FIONBIO, &mode);
+}
+
+size_t event_loop::size() const
+{
+	size_t count = 0;
+
+	for (auto& w : _pimpl->workers)
+	{
+		count += w->size();
+	}
+
+	return count;
+}
+
+E_IO_BACKEND event_loop::backend() const
+{
+	return _pimpl->backend;
+}
+
+pair<char*, buffer_slice> event_loop::acquire_buffer(size_t size_)
+{
+	return _pimpl->ptr_buffer_pool->acquire(size_);
+}
+
+void event_loop::_async_read(end_point& end_point_, char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_)
+{
+	_pimpl->worker_of(end_point_._socket).read(end_point_._socket, ptr_data_, size_, move(handler_), move(block_));
+}
+
+void event_loop::_async_write(end_point& end_point_, const char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_)
+{
+	_pimpl->worker_of(end_point_._socket).write(end_point_._socket, ptr_data_, size_, move(handler_), move(block_));
+}
+
+void event_loop::_start_accepting(SOCKET listen_socket_, size_t buffer_size_, accept_handler handler_)
+{
+	_pimpl->ptr_acceptor->start_accepting(listen_socket_, buffer_size_, move(handler_));
+}
+
+void event_loop::_stop_accepting(SOCKET listen_socket_)
+{
+	_pimpl->ptr_acceptor->stop_accepting(listen_socket_);
+}
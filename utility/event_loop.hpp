@@ -0,0 +1,73 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+
+#include <thread_pool\thread_pool>
+
+namespace utility
+{
+	struct event_loop_impl;
+
+	enum E_IO_BACKEND
+	{
+		//	WSAPoll over non-blocking sockets
+		IO_BACKEND_POLL,
+
+		//	Registered I/O: batched, deferred submission into pre-registered buffers.
+		//	The slice reads and writes of acquire_buffer() blocks aren't copied, the other
+		//	buffers are copied through the registered ones.
+		//	The sockets must be created with WSA_FLAG_REGISTERED_IO, as the server and
+		//	the client do when the system supports it
+		IO_BACKEND_REGISTERED_IO,
+	};
+
+	//
+	//	event loop over non-blocking sockets
+	//
+	//	The attached end_points are shared among a few worker threads. An idle connection
+	//	costs only its bookkeeping entry: no thread belongs to it, and with the poll backend
+	//	it's not even polled until an operation is pending on it.
+	//	The poll backend attempts the I/O right away and polls the socket only after it
+	//	returned WSAEWOULDBLOCK (edge triggered style).
+	//	The handlers are called on the completion pool.
+	//
+	class event_loop
+	{
+		friend class end_point;
+		friend class server;
+	public:
+		event_loop(thread_pool& completion_pool_, size_t count_of_threads_ = 1, E_IO_BACKEND backend_ = IO_BACKEND_POLL);
+		~event_loop();
+
+		event_loop(const event_loop&) = delete;
+		event_loop& operator=(const event_loop&) = delete;
+
+		//	switches the end_point into non-blocking mode
+		void attach(end_point&);
+
+		//	the pending operations of the end_point are completed with an error
+		void detach(end_point&);
+
+		//	count of the attached end_points
+		size_t size() const;
+
+		E_IO_BACKEND backend() const;
+
+		//
+		//	a block for end_point::async_write(buffer_slice), it's sent in place by the
+		//	registered I/O backend, the slice reads receive into these blocks as well
+		//	The blocks above buffer_pool::MAX_BLOCK_SIZE are registered one by one.
+		//
+		std::pair<char*, buffer_slice> acquire_buffer(size_t size_);
+
+	private:
+		std::unique_ptr<event_loop_impl> _pimpl;
+
+		//	block_: the data is in it, it's held until the handler is called
+		void _async_read(end_point&, char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_ = { });
+		void _async_write(end_point&, const char* ptr_data_, size_t size_, io_handler handler_, buffer_slice block_ = { });
+
+		void _start_accepting(SOCKET listen_socket_, size_t buffer_size_, accept_handler handler_);
+		void _stop_accepting(SOCKET listen_socket_);
+	};
+}
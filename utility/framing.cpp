@@ -0,0 +1,198 @@
+#include "stdafx.h"
+#include "framing.hpp"
+
+using namespace utility;
+using namespace std;
+
+
+size_t utility::encode_varint(uint64_t value_, char* ptr_out_)
+{
+	size_t size = 0;
+
+	while (value_ >= 0x80)
+	{
+		ptr_out_[size++] = static_cast<char>((value_ & 0x7f) | 0x80);
+		value_ >>= 7;
+	}
+
+	ptr_out_[size++] = static_cast<char>(value_);
+
+	return size;
+}
+
+size_t utility::decode_varint(const char* ptr_data_, size_t size_, uint64_t& value_)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size_ && i < MAX_VARINT_SIZE; ++i)
+	{
+		const auto byte = static_cast<unsigned char>(ptr_data_[i]);
+
+		value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+
+		if ((byte & 0x80) == 0)
+		{
+			value_ = value;
+			return i + 1;
+		}
+	}
+
+	if (size_ >= MAX_VARINT_SIZE)
+	{
+		throw runtime_error { "malformed frame: the size prefix is too long" };
+	}
+
+	return 0;
+}
+
+
+frame_decoder::frame_decoder(size_t max_frame_size_)
+	: _max_frame_size { max_frame_size_ }
+{
+}
+
+pair<char*, size_t> frame_decoder::prepare(size_t min_size_)
+{
+	if (_begin == _end)
+	{
+		_begin = _end = 0;
+	}
+
+	if (_buffer.size() - _end < min_size_)
+	{
+		// move the remainder to the front before growing the buffer
+		if (_begin > 0)
+		{
+			memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+			_end -= _begin;
+			_begin = 0;
+		}
+
+		if (_buffer.size() - _end < min_size_)
+		{
+			const size_t required = _end + min_size_;
+			const size_t doubled = 2 * _buffer.size();
+
+			_buffer.resize(doubled > required ? doubled : required);
+		}
+	}
+
+	return { _buffer.data() + _end, _buffer.size() - _end };
+}
+
+void frame_decoder::commit(size_t size_)
+{
+	_end += size_;
+}
+
+boost::optional<boost::string_ref> frame_decoder::next()
+{
+	uint64_t frame_size = 0;
+
+	const auto prefix_size = decode_varint(_buffer.data() + _begin, _end - _begin, frame_size);
+	if (prefix_size == 0)
+	{
+		return { };
+	}
+
+	if (frame_size > _max_frame_size)
+	{
+		stringstream sb;
+		sb << "malformed frame: size " << frame_size << " exceeds the limit " << _max_frame_size;
+
+		throw runtime_error { sb.str() };
+	}
+
+	if (_end - _begin - prefix_size < frame_size)
+	{
+		return { };
+	}
+
+	boost::string_ref frame { _buffer.data() + _begin + prefix_size, static_cast<size_t>(frame_size) };
+
+	_begin += prefix_size + static_cast<size_t>(frame_size);
+
+	return frame;
+}
+
+size_t frame_decoder::buffered() const
+{
+	return _end - _begin;
+}
+
+size_t frame_decoder::pending_frame_size() const
+{
+	uint64_t frame_size = 0;
+
+	const auto prefix_size = decode_varint(_buffer.data() + _begin, _end - _begin, frame_size);
+
+	return prefix_size ? prefix_size + static_cast<size_t>(frame_size) : 0;
+}
+
+
+frame_reader::frame_reader(const end_point& end_point_, size_t read_size_, size_t max_frame_size_)
+	: _end_point { end_point_ }
+	, _decoder { max_frame_size_ }
+	, _read_size { read_size_ }
+{
+}
+
+boost::optional<boost::string_ref> frame_reader::read()
+{
+	for (;;)
+	{
+		auto frame = _decoder.next();
+		if (frame)
+		{
+			return frame;
+		}
+
+		// a large frame is received with as few calls as possible
+		const auto missing = _decoder.pending_frame_size() > _decoder.buffered()
+			? _decoder.pending_frame_size() - _decoder.buffered()
+			: 0;
+
+		auto space = _decoder.prepare(missing > _read_size ? missing : _read_size);
+
+		const auto size = _end_point.read(space.first, space.second);
+		if (size == 0)
+		{
+			// disconnected
+			return { };
+		}
+
+		_decoder.commit(size);
+	}
+}
+
+
+frame_writer::frame_writer(const end_point& end_point_)
+	: _ptr_end_point { &end_point_ }
+{
+}
+
+frame_writer::frame_writer(byte_sink& sink_)
+	: _ptr_sink { &sink_ }
+{
+}
+
+void frame_writer::write(const char* ptr_data_, size_t size_)
+{
+	const auto prefix_size = encode_varint(size_, _prefix);
+
+	const io_buffer buffers[] = { { _prefix, prefix_size }, { ptr_data_, size_ } };
+
+	if (_ptr_sink)
+	{
+		_ptr_sink->write_v(buffers, 2);
+	}
+	else
+	{
+		_ptr_end_point->write_v(buffers, 2);
+	}
+}
+
+void frame_writer::write(boost::string_ref frame_)
+{
+	write(frame_.data(), frame_.size());
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+
+#include <cstdint>
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace utility
+{
+	//
+	//	length-prefixed framing over a byte stream
+	//
+	//	[varint: size of the payload][payload]
+	//
+	//	the varint is LEB128: 7 bits per byte, least significant group first, the high bit
+	//	is set on every byte but the last one
+	//
+
+	constexpr size_t MAX_VARINT_SIZE = 10;
+
+	//	returns the count of the written bytes, ptr_out_ must have room for MAX_VARINT_SIZE bytes
+	size_t encode_varint(uint64_t value_, char* ptr_out_);
+
+	//	returns the count of the consumed bytes or zero if the varint is incomplete
+	size_t decode_varint(const char* ptr_data_, size_t size_, uint64_t& value_);
+
+	//
+	//	collects the received bytes into a reusable buffer and cuts them into frames
+	//
+	class frame_decoder
+	{
+	public:
+		static constexpr size_t DEFAULT_MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+		explicit frame_decoder(size_t max_frame_size_ = DEFAULT_MAX_FRAME_SIZE);
+
+		//	free space of at least min_size_ bytes after the buffered data,
+		//	it invalidates the frames returned so far
+		std::pair<char*, size_t> prepare(size_t min_size_);
+
+		//	size_ bytes were written into the space given by prepare()
+		void commit(size_t size_);
+
+		//	the next complete frame if any, the view refers into the buffer of the decoder
+		boost::optional<boost::string_ref> next();
+
+		//	count of the bytes, which are not returned as a frame yet
+		size_t buffered() const;
+
+		//	size of the frame which is being received, or zero if its prefix is incomplete too
+		size_t pending_frame_size() const;
+
+	private:
+		std::vector<char> _buffer;
+		size_t _begin = 0;
+		size_t _end = 0;
+		size_t _max_frame_size;
+	};
+
+	class frame_reader
+	{
+	public:
+		frame_reader(const end_point&, size_t read_size_ = 4096, size_t max_frame_size_ = frame_decoder::DEFAULT_MAX_FRAME_SIZE);
+
+		//	blocks until a whole frame has arrived, none when the peer has disconnected
+		//	the view is valid until the next read() call
+		boost::optional<boost::string_ref> read();
+
+	private:
+		const end_point& _end_point;
+		frame_decoder _decoder;
+		size_t _read_size;
+	};
+
+	class frame_writer
+	{
+	public:
+		frame_writer(const end_point&);
+
+		//	the frames are passed to a coalescing_writer or a send_queue as a single write
+		frame_writer(byte_sink&);
+
+		//	the prefix and the payload are sent together by a gather write, the payload isn't copied
+		void write(const char* ptr_data_, size_t size_);
+		void write(boost::string_ref frame_);
+
+	private:
+		const end_point* _ptr_end_point = nullptr;
+		byte_sink* _ptr_sink = nullptr;
+
+		char _prefix[MAX_VARINT_SIZE];
+	};
+}
@@ -1,6 +1,11 @@
 #include "stdafx.h"
 #include "network.hpp"
+#include "event_loop.hpp"
 #include "module_cross_singleton.hpp"
+#include "shm_transport.hpp"
+
+// AF_UNIX, Windows 10 1803 and later
+#include <afunix.h>
 
 using namespace utility;
 using namespace std;
@@ -32,188 +37,264 @@ public:
 };
 
 
-desc::desc(std::string port_, size_t buffer_size_)
-	: port { move(port_) }
-	, buffer_size { buffer_size_ }
+void utility::initialize_network()
 {
+	// WSACleanup() is called by the dtor of WSAInit at the termiantion of this process
+	gl_storage().get_singleton_of<WSAInit>();
 }
 
-
-server::server(desc desc_)
-	: _port { move(desc_.port) }
-	, _buffer_size { desc_.buffer_size }
+SOCKET utility::open_socket(int family_, int type_, int protocol_)
 {
-	// ensure that WSA is initialized
-	// WSACleanup() is called by the dtor of WSAInit at the termiantion of this process
-	gl_storage().get_singleton_of<WSAInit>();
+	auto new_socket = WSASocket(family_, type_, protocol_, NULL, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
 
-	std::tie(_listen_socket, _ptr_server_address) = _create_listen_socket();
+	if (new_socket == INVALID_SOCKET && WSAGetLastError() == WSAEINVAL)
+	{
+		// no registered I/O before Windows 8
+		new_socket = WSASocket(family_, type_, protocol_, NULL, 0, WSA_FLAG_OVERLAPPED);
+	}
+
+	return new_socket;
 }
 
-server::~server()
+
+namespace
 {
-	//
-	if (_ptr_server_address)
+	const char UNIX_SCHEME[] = "unix:";
+	const char SHARED_MEMORY_SCHEME[] = "shm:";
+
+	bool starts_with(const string& text_, const char* prefix_)
 	{
-		freeaddrinfo(_ptr_server_address);
-		_ptr_server_address = nullptr;
+		return text_.compare(0, strlen(prefix_), prefix_) == 0;
 	}
 
-	// No longer need server socket
-	if(_listen_socket != INVALID_SOCKET)
+	sockaddr_un unix_address_of(const string& path_)
 	{
-		closesocket(_listen_socket);
-		_listen_socket = INVALID_SOCKET;
+		sockaddr_un address;
+		ZeroMemory(&address, sizeof(address));
+
+		address.sun_family = AF_UNIX;
+
+		if (path_.size() >= sizeof(address.sun_path))
+		{
+			stringstream sb;
+			sb << "the path of the unix socket is too long: " << path_;
+
+			throw runtime_error { sb.str() };
+		}
+
+		memcpy(address.sun_path, path_.c_str(), path_.size());
+
+		return address;
 	}
 }
 
-std::tuple<SOCKET, addrinfo*> server::_create_listen_socket() const
+namespace
 {
-	addrinfo hints;
-	ZeroMemory(&hints, sizeof(hints));
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
-	hints.ai_flags = AI_PASSIVE;
+	enum E_WAIT_RESULT
+	{
+		WAIT_RESULT_SIGNALED,
+		WAIT_RESULT_DEADLINE,
+		WAIT_RESULT_CANCELLED,
+	};
 
-	addrinfo *ptr_addrinfo { nullptr };
+	//	the overlapped operations of a thread are waited for one by one, they can share an event
+	struct thread_io_event
+	{
+		WSAEVENT handle = WSACreateEvent();
 
-	// Resolve the server address and port
-	int i_result = getaddrinfo(NULL, _port.c_str(), &hints, &ptr_addrinfo);
-	if (i_result != 0)
+		~thread_io_event()
+		{
+			WSACloseEvent(handle);
+		}
+	};
+
+	WSAEVENT io_event_of_this_thread()
 	{
-		stringstream sb;
-		sb << "getaddrinfo failed with error: " << i_result;
+		thread_local thread_io_event e;
 
-		throw runtime_error { sb.str() };
+		WSAResetEvent(e.handle);
+
+		return e.handle;
 	}
 
-	// Create a SOCKET for connecting to server
-	auto listen_socket = socket(ptr_addrinfo->ai_family, ptr_addrinfo->ai_socktype, ptr_addrinfo->ai_protocol);
-	if (listen_socket == INVALID_SOCKET)
+	E_WAIT_RESULT wait_for(WSAEVENT event_, io_deadline deadline_, const cancellation_token& cancellation_)
 	{
-		stringstream sb;
-		sb << "socket failed with error: " << WSAGetLastError();
+		DWORD timeout = WSA_INFINITE;
 
-		freeaddrinfo(ptr_addrinfo);
+		if (deadline_ != io_deadline::max())
+		{
+			const auto now = chrono::steady_clock::now();
+			if (now >= deadline_)
+			{
+				return WAIT_RESULT_DEADLINE;
+			}
 
-		throw runtime_error { sb.str() };
-	}
+			// rounded up, so it doesn't wake up right before the deadline
+			const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline_ - now).count() + 1;
 
-	return make_tuple(listen_socket, ptr_addrinfo);
-}
+			timeout = remaining < 0x7FFFFFFF ? static_cast<DWORD>(remaining) : 0x7FFFFFFF;
+		}
+
+		WSAEVENT events[] = { event_, cancellation_.native_handle() };
+
+		const auto result = WSAWaitForMultipleEvents(events[1] ? 2 : 1, events, FALSE, timeout, FALSE);
+
+		if (result == WSA_WAIT_EVENT_0)
+		{
+			return WAIT_RESULT_SIGNALED;
+		}
+
+		if (result == WSA_WAIT_EVENT_0 + 1)
+		{
+			return WAIT_RESULT_CANCELLED;
+		}
+
+		if (result == WSA_WAIT_TIMEOUT)
+		{
+			return WAIT_RESULT_DEADLINE;
+		}
 
-SOCKET server::_listen()
-{
-	// Setup the TCP listening socket
-	auto i_result = ::bind(_listen_socket, _ptr_server_address->ai_addr, (int)_ptr_server_address->ai_addrlen);
-	if (i_result == SOCKET_ERROR)
-	{
 		stringstream sb;
-		sb << "bind failed with error: " << WSAGetLastError();
-		throw runtime_error{ sb.str() };
-	}
+		sb << "WSAWaitForMultipleEvents failed with error: " << WSAGetLastError();
 
+		throw runtime_error { sb.str() };
+	}
 
-	i_result = listen(_listen_socket, SOMAXCONN);
-	if (i_result == SOCKET_ERROR)
+	[[noreturn]] void throw_interrupted(E_WAIT_RESULT result_, const char* operation_)
 	{
-		stringstream sb;
-		sb << "listen failed with error: " << WSAGetLastError();
-		throw runtime_error{ sb.str() };
+		if (result_ == WAIT_RESULT_CANCELLED)
+		{
+			throw io_cancelled_exception { string { operation_ } + " was cancelled" };
+		}
+
+		throw io_timeout_exception { string { operation_ } + " timed out" };
 	}
 
-	// Accept a client socket
-	auto client_socket = accept(_listen_socket, NULL, NULL);
-	if (client_socket == INVALID_SOCKET)
+	//
+	//	waits for an overlapped operation, which is cancelled at the deadline or by the token
+	//	an operation which has completed meanwhile is still successful
+	//
+	size_t complete_overlapped(SOCKET socket_, WSAOVERLAPPED& overlapped_, io_deadline deadline_, const cancellation_token& cancellation_, const char* operation_)
 	{
-		stringstream sb;
-		sb << "accept failed with error: " << WSAGetLastError();
-		throw runtime_error{ sb.str() };
+		const auto result = wait_for(overlapped_.hEvent, deadline_, cancellation_);
+
+		if (result != WAIT_RESULT_SIGNALED)
+		{
+			CancelIoEx(reinterpret_cast<HANDLE>(socket_), &overlapped_);
+		}
+
+		DWORD transferred = 0;
+		DWORD flags = 0;
+
+		if (!WSAGetOverlappedResult(socket_, &overlapped_, &transferred, TRUE, &flags))
+		{
+			const int ec = WSAGetLastError();
+			if (ec == WSA_OPERATION_ABORTED && result != WAIT_RESULT_SIGNALED)
+			{
+				throw_interrupted(result, operation_);
+			}
+
+			stringstream sb;
+			sb << operation_ << " failed with error: " << ec;
+
+			throw runtime_error { sb.str() };
+		}
+
+		return transferred;
 	}
 
-	return client_socket;
+	void throw_if_cancelled(const cancellation_token& cancellation_, const char* operation_)
+	{
+		if (cancellation_.is_cancelled())
+		{
+			throw io_cancelled_exception { string { operation_ } + " was cancelled" };
+		}
+	}
 }
 
-end_point server::listening()
+
+io_timeout_exception::io_timeout_exception(string msg_)
+	: runtime_error { move(msg_) }
 {
-	return { _listen(), _buffer_size };
 }
 
-
-end_point::end_point(SOCKET socket_, size_t buffer_size_)
-	: _socket { socket_ }
-	, _buffer_size { buffer_size_ }
+io_cancelled_exception::io_cancelled_exception(string msg_)
+	: runtime_error { move(msg_) }
 {
 }
 
-end_point::~end_point()
+
+struct cancellation_token::state
 {
-	// shutdown the connection since we're done
-	int i_result = shutdown(_socket, SD_SEND);
-	if (i_result == SOCKET_ERROR)
-	{
-		stringstream sb;
-		sb << "shutdown failed with error: " << WSAGetLastError();
+	WSAEVENT event = WSACreateEvent();
 
-		// what to do here?
+	~state()
+	{
+		WSACloseEvent(event);
 	}
+};
 
-	closesocket(_socket);
-	_socket = INVALID_SOCKET;
-}
-
-size_t end_point::read(char* ptr_data_, size_t size_) const
+cancellation_token::cancellation_token()
+	: _ptr_state { make_shared<state>() }
 {
-	// recv won't return with zero (*), it rather waits
-	// if data.size == buffer.size then on the next call it blocks
-	//
-	//	so it's not possible to make difference whenever no more data will be sent or
-	//	the size of the current batch is exactly the size of the buffer
-	//
-	// (*) only when it disconnected
-	auto status_or_size = recv(_socket, ptr_data_, size_, 0);
-
-	if (status_or_size == SOCKET_ERROR)
+	if (_ptr_state->event == WSA_INVALID_EVENT)
 	{
-		int ec = WSAGetLastError();
-
-		char msg_buffer[1024];
-		FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, NULL, ec, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), msg_buffer, 1024, NULL);
-
 		stringstream sb;
-		sb << "I/O error: " << msg_buffer << " (" << ec << ")";
-			
+		sb << "WSACreateEvent failed with error: " << WSAGetLastError();
+
 		throw runtime_error { sb.str() };
 	}
+}
 
-	return status_or_size;
+cancellation_token::cancellation_token(nullptr_t)
+{
 }
 
-void end_point::write(const char* ptr_data_, size_t size_) const
+void cancellation_token::cancel() const
 {
-	int i_result = send(_socket, ptr_data_, size_, 0);
-	if (i_result == SOCKET_ERROR)
+	if (_ptr_state)
 	{
-		stringstream sb;
-		sb << "send failed with error: " << WSAGetLastError();
-
-		throw runtime_error	{ sb.str() };
+		WSASetEvent(_ptr_state->event);
 	}
 }
 
+bool cancellation_token::is_cancelled() const
+{
+	return _ptr_state && WaitForSingleObject(_ptr_state->event, 0) == WAIT_OBJECT_0;
+}
 
-client::client(string address_, desc desc_)
-	: end_point { _create_socket(move(address_), desc_.port), desc_.buffer_size }
-	, _port { move(desc_.port) }
+HANDLE cancellation_token::native_handle() const
 {
+	return _ptr_state ? _ptr_state->event : NULL;
 }
 
-client::~client()
+const cancellation_token& cancellation_token::none()
 {
+	static const cancellation_token never_cancelled { nullptr };
+
+	return never_cancelled;
 }
 
-SOCKET client::_create_socket(string address_, string port_)
+
+E_TRANSPORT utility::transport_of(const string& address_, string& rest_)
+{
+	if (starts_with(address_, UNIX_SCHEME))
+	{
+		rest_ = address_.substr(strlen(UNIX_SCHEME));
+		return TRANSPORT_UNIX;
+	}
+
+	if (starts_with(address_, SHARED_MEMORY_SCHEME))
+	{
+		rest_ = address_.substr(strlen(SHARED_MEMORY_SCHEME));
+		return TRANSPORT_SHARED_MEMORY;
+	}
+
+	rest_ = address_;
+	return TRANSPORT_TCP;
+}
+
+shared_ptr<addrinfo> utility::resolve_address(const string& address_, const string& port_)
 {
 	// ensure that WSA is initialized
 	// WSACleanup() is called by the dtor of WSAInit at the termiantion of this process
@@ -235,13 +316,18 @@ SOCKET client::_create_socket(string address_, string port_)
 		throw runtime_error{ sb.str() };
 	}
 
+	return { result, freeaddrinfo };
+}
+
+SOCKET utility::connect_socket(const addrinfo* ptr_address_)
+{
 	SOCKET new_sckt { INVALID_SOCKET };
 
 	// Attempt to connect to an address until one succeeds
-	for (addrinfo* ptr = result; ptr != NULL; ptr = ptr->ai_next)
+	for (auto ptr = ptr_address_; ptr != NULL; ptr = ptr->ai_next)
 	{
 		// Create a SOCKET for connecting to server
-		new_sckt = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+		new_sckt = open_socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
 		if (new_sckt == INVALID_SOCKET)
 		{
 			stringstream sb;
@@ -251,7 +337,7 @@ SOCKET client::_create_socket(string address_, string port_)
 		}
 
 		// Connect to server.
-		i_result = connect(new_sckt, ptr->ai_addr, (int)ptr->ai_addrlen);
+		auto i_result = connect(new_sckt, ptr->ai_addr, (int)ptr->ai_addrlen);
 		if (i_result == SOCKET_ERROR)
 		{
 			closesocket(new_sckt);
@@ -261,8 +347,6 @@ SOCKET client::_create_socket(string address_, string port_)
 
 		break;
 	}
-	
-	freeaddrinfo(result);
 
 	if (new_sckt == INVALID_SOCKET)
 	{
@@ -273,3 +357,787 @@ SOCKET client::_create_socket(string address_, string port_)
 }
 
 
+desc::desc(std::string port_, size_t buffer_size_)
+	: port { move(port_) }
+	, buffer_size { buffer_size_ }
+{
+}
+
+
+server::server(desc desc_)
+	: _port { move(desc_.port) }
+	, _buffer_size { desc_.buffer_size }
+{
+	// ensure that WSA is initialized
+	// WSACleanup() is called by the dtor of WSAInit at the termiantion of this process
+	gl_storage().get_singleton_of<WSAInit>();
+
+	_transport = transport_of(_port, _local_address);
+
+	if (_transport == TRANSPORT_SHARED_MEMORY)
+	{
+		_ptr_shm_acceptor = make_unique<shm_acceptor>(_local_address);
+		return;
+	}
+
+	// the clients may connect as soon as the ctor returned, before any listening() call
+	if (_transport == TRANSPORT_UNIX)
+	{
+		_listen_unix();
+		return;
+	}
+
+	std::tie(_listen_socket, _ptr_server_address) = _create_listen_socket();
+
+	_listen();
+}
+
+server::~server()
+{
+	if (_ptr_event_loop)
+	{
+		_ptr_event_loop->_stop_accepting(_listen_socket);
+		_ptr_event_loop = nullptr;
+	}
+
+	//
+	if (_ptr_server_address)
+	{
+		freeaddrinfo(_ptr_server_address);
+		_ptr_server_address = nullptr;
+	}
+
+	// No longer need server socket
+	if(_listen_socket != INVALID_SOCKET)
+	{
+		closesocket(_listen_socket);
+		_listen_socket = INVALID_SOCKET;
+	}
+
+	// the socket file isn't removed by the system
+	if (_transport == TRANSPORT_UNIX)
+	{
+		DeleteFileA(_local_address.c_str());
+	}
+}
+
+std::tuple<SOCKET, addrinfo*> server::_create_listen_socket() const
+{
+	addrinfo hints;
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_PASSIVE;
+
+	addrinfo *ptr_addrinfo { nullptr };
+
+	// Resolve the server address and port
+	int i_result = getaddrinfo(NULL, _port.c_str(), &hints, &ptr_addrinfo);
+	if (i_result != 0)
+	{
+		stringstream sb;
+		sb << "getaddrinfo failed with error: " << i_result;
+
+		throw runtime_error { sb.str() };
+	}
+
+	// Create a SOCKET for connecting to server
+	auto listen_socket = open_socket(ptr_addrinfo->ai_family, ptr_addrinfo->ai_socktype, ptr_addrinfo->ai_protocol);
+	if (listen_socket == INVALID_SOCKET)
+	{
+		stringstream sb;
+		sb << "socket failed with error: " << WSAGetLastError();
+
+		freeaddrinfo(ptr_addrinfo);
+
+		throw runtime_error { sb.str() };
+	}
+
+	return make_tuple(listen_socket, ptr_addrinfo);
+}
+
+void server::_listen()
+{
+	// Setup the TCP listening socket
+	auto i_result = ::bind(_listen_socket, _ptr_server_address->ai_addr, (int)_ptr_server_address->ai_addrlen);
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "bind failed with error: " << WSAGetLastError();
+		throw runtime_error{ sb.str() };
+	}
+
+
+	i_result = listen(_listen_socket, SOMAXCONN);
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "listen failed with error: " << WSAGetLastError();
+		throw runtime_error{ sb.str() };
+	}
+}
+
+void server::_listen_unix()
+{
+	const auto address = unix_address_of(_local_address);
+
+	// a stale socket file of a previous server would fail the bind
+	DeleteFileA(_local_address.c_str());
+
+	_listen_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_listen_socket == INVALID_SOCKET)
+	{
+		stringstream sb;
+		sb << "socket failed with error: " << WSAGetLastError();
+		throw runtime_error { sb.str() };
+	}
+
+	const char* failed_operation = nullptr;
+
+	if (::bind(_listen_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+	{
+		failed_operation = "bind";
+	}
+	else if (listen(_listen_socket, SOMAXCONN) == SOCKET_ERROR)
+	{
+		failed_operation = "listen";
+	}
+
+	if (failed_operation)
+	{
+		stringstream sb;
+		sb << failed_operation << " failed with error: " << WSAGetLastError();
+
+		// the dtor isn't called by a throwing ctor
+		closesocket(_listen_socket);
+		_listen_socket = INVALID_SOCKET;
+
+		throw runtime_error { sb.str() };
+	}
+}
+
+SOCKET server::_accept()
+{
+	// the same way as with a deadline, so it never takes a connection another thread was woken up for
+	return _accept(io_deadline::max(), cancellation_token::none());
+}
+
+end_point server::listening(io_deadline deadline_, const cancellation_token& cancellation_)
+{
+	if (_ptr_shm_acceptor)
+	{
+		return { _ptr_shm_acceptor->accept(deadline_, cancellation_), _buffer_size };
+	}
+
+	return { _accept(deadline_, cancellation_), _buffer_size };
+}
+
+end_point server::listening()
+{
+	if (_ptr_shm_acceptor)
+	{
+		return { _ptr_shm_acceptor->accept(), _buffer_size };
+	}
+
+	return { _accept(), _buffer_size };
+}
+
+SOCKET server::_accept(io_deadline deadline_, const cancellation_token& cancellation_)
+{
+	if (_ptr_event_loop)
+	{
+		throw logic_error { "the server is accepting on an event_loop" };
+	}
+
+	//	the listening socket is polled, its mode isn't changed, as other threads may accept on it
+	//	meanwhile. The cancellation can't wake up the poll, it's checked between shorter polls.
+	const INT CANCELLATION_CHECK_INTERVAL = 20;
+
+	WSAPOLLFD listening_fd = { _listen_socket, POLLRDNORM, 0 };
+
+	for (;;)
+	{
+		throw_if_cancelled(cancellation_, "accept");
+
+		INT timeout = -1;
+
+		if (deadline_ != io_deadline::max())
+		{
+			const auto now = chrono::steady_clock::now();
+			if (now >= deadline_)
+			{
+				throw_interrupted(WAIT_RESULT_DEADLINE, "accept");
+			}
+
+			// rounded up, so it doesn't wake up right before the deadline
+			const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline_ - now).count() + 1;
+
+			timeout = remaining < 0x7FFFFFFF ? static_cast<INT>(remaining) : 0x7FFFFFFF;
+		}
+
+		if (cancellation_.native_handle() && (timeout < 0 || timeout > CANCELLATION_CHECK_INTERVAL))
+		{
+			timeout = CANCELLATION_CHECK_INTERVAL;
+		}
+
+		listening_fd.revents = 0;
+
+		const int count_of_ready = WSAPoll(&listening_fd, 1, timeout);
+		if (count_of_ready == SOCKET_ERROR)
+		{
+			stringstream sb;
+			sb << "WSAPoll failed with error: " << WSAGetLastError();
+			throw runtime_error { sb.str() };
+		}
+
+		if (count_of_ready == 0)
+		{
+			continue;
+		}
+
+		// the connection may have been taken by another thread since, the blocking accept
+		// is called only if it's still there
+		lock_guard<mutex> lock { _accept_mutex };
+
+		listening_fd.revents = 0;
+
+		if (WSAPoll(&listening_fd, 1, 0) != 1)
+		{
+			continue;
+		}
+
+		auto client_socket = accept(_listen_socket, NULL, NULL);
+		if (client_socket == INVALID_SOCKET)
+		{
+			stringstream sb;
+			sb << "accept failed with error: " << WSAGetLastError();
+			throw runtime_error { sb.str() };
+		}
+
+		return client_socket;
+	}
+}
+
+void server::async_accept(event_loop& event_loop_, accept_handler handler_)
+{
+	if (_ptr_event_loop)
+	{
+		throw logic_error { "the server is already accepting on an event_loop" };
+	}
+
+	if (_transport == TRANSPORT_SHARED_MEMORY)
+	{
+		throw logic_error { "the shared memory transport doesn't support the event_loop" };
+	}
+
+	event_loop_._start_accepting(_listen_socket, _buffer_size, move(handler_));
+
+	_ptr_event_loop = &event_loop_;
+}
+
+
+end_point::end_point(SOCKET socket_, size_t buffer_size_)
+	: _socket { socket_ }
+	, _buffer_size { buffer_size_ }
+	, _receive_size { buffer_size_ }
+{
+}
+
+end_point::end_point(shared_ptr<shm_channel> ptr_shm_channel_, size_t buffer_size_)
+	: _buffer_size { buffer_size_ }
+	, _ptr_shm_channel { move(ptr_shm_channel_) }
+	, _receive_size { buffer_size_ }
+{
+}
+
+end_point::end_point(end_point&& other_)
+	: _socket { other_._socket }
+	, _buffer_size { other_._buffer_size }
+	, _ptr_event_loop { other_._ptr_event_loop }
+	, _ptr_shm_channel { move(other_._ptr_shm_channel) }
+	, _ptr_buffer_pool { other_._ptr_buffer_pool }
+	, _receive_size { other_._receive_size }
+	, _receive_block { move(other_._receive_block) }
+	, _ptr_receive_block { other_._ptr_receive_block }
+	, _receive_offset { other_._receive_offset }
+{
+	// the event_loop knows the socket only, so the pending operations aren't affected
+	other_._ptr_event_loop = nullptr;
+	other_._socket = INVALID_SOCKET;
+}
+
+end_point::~end_point()
+{
+	if (_ptr_event_loop)
+	{
+		_ptr_event_loop->detach(*this);
+	}
+
+	if (_ptr_shm_channel)
+	{
+		_ptr_shm_channel->close();
+	}
+
+	if (_socket == INVALID_SOCKET)
+	{
+		return;
+	}
+
+	// shutdown the connection since we're done
+	int i_result = shutdown(_socket, SD_SEND);
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "shutdown failed with error: " << WSAGetLastError();
+
+		// what to do here?
+	}
+
+	closesocket(_socket);
+	_socket = INVALID_SOCKET;
+}
+
+stats_counter& utility::bytes_received_counter()
+{
+	static stats_counter counter { "network.bytes_received" };
+	return counter;
+}
+
+stats_counter& utility::bytes_sent_counter()
+{
+	static stats_counter counter { "network.bytes_sent" };
+	return counter;
+}
+
+size_t end_point::read(char* ptr_data_, size_t size_) const
+{
+	// recv won't return with zero (*), it rather waits
+	// if data.size == buffer.size then on the next call it blocks
+	//
+	//	so it's not possible to make difference whenever no more data will be sent or
+	//	the size of the current batch is exactly the size of the buffer
+	//
+	// (*) only when it disconnected
+	if (_ptr_shm_channel)
+	{
+		const auto size = _ptr_shm_channel->read(ptr_data_, size_);
+		bytes_received_counter().add(size);
+
+		return size;
+	}
+
+	auto status_or_size = recv(_socket, ptr_data_, size_, 0);
+
+	if (status_or_size == SOCKET_ERROR)
+	{
+		int ec = WSAGetLastError();
+
+		char msg_buffer[1024];
+		FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, NULL, ec, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), msg_buffer, 1024, NULL);
+
+		stringstream sb;
+		sb << "I/O error: " << msg_buffer << " (" << ec << ")";
+			
+		throw runtime_error { sb.str() };
+	}
+
+	bytes_received_counter().add(status_or_size);
+
+	return status_or_size;
+}
+
+buffer_slice end_point::read_slice()
+{
+	auto& pool = _ptr_buffer_pool ? *_ptr_buffer_pool : buffer_pool::for_this_thread();
+
+	// nobody else refers to the block, it can be filled from the beginning
+	if (_receive_block.use_count() == 1)
+	{
+		_receive_offset = 0;
+	}
+
+	if (_receive_block.size() - _receive_offset < _receive_size.next())
+	{
+		auto block = pool.acquire(_receive_size.next());
+
+		_ptr_receive_block = block.first;
+		_receive_block = move(block.second);
+		_receive_offset = 0;
+	}
+
+	const auto capacity = _receive_block.size() - _receive_offset;
+
+	const auto size = read(_ptr_receive_block + _receive_offset, capacity);
+
+	pool.count_received(size);
+	_receive_size.observe(size, capacity);
+
+	auto received = _receive_block.slice(_receive_offset, size);
+	_receive_offset += size;
+
+	return received;
+}
+
+void end_point::set_buffer_pool(buffer_pool& buffer_pool_)
+{
+	_ptr_buffer_pool = &buffer_pool_;
+}
+
+size_t end_point::read(char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_) const
+{
+	if (_ptr_shm_channel)
+	{
+		const auto size = _ptr_shm_channel->read(ptr_data_, size_, deadline_, cancellation_);
+		bytes_received_counter().add(size);
+
+		return size;
+	}
+
+	throw_if_cancelled(cancellation_, "read");
+
+	// an overlapped receive, so it can be cancelled without touching the mode of the socket
+	WSABUF buffer;
+	buffer.buf = ptr_data_;
+	buffer.len = static_cast<ULONG>(size_);
+
+	WSAOVERLAPPED overlapped;
+	ZeroMemory(&overlapped, sizeof(overlapped));
+	overlapped.hEvent = io_event_of_this_thread();
+
+	DWORD flags = 0;
+
+	if (WSARecv(_socket, &buffer, 1, NULL, &flags, &overlapped, NULL) == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
+	{
+		stringstream sb;
+		sb << "I/O error: WSARecv failed with error: " << WSAGetLastError();
+
+		throw runtime_error { sb.str() };
+	}
+
+	const auto size = complete_overlapped(_socket, overlapped, deadline_, cancellation_, "read");
+	bytes_received_counter().add(size);
+
+	return size;
+}
+
+void end_point::write(const char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_) const
+{
+	if (_ptr_shm_channel)
+	{
+		_ptr_shm_channel->write(ptr_data_, size_, deadline_, cancellation_);
+		bytes_sent_counter().add(size_);
+
+		return;
+	}
+
+	throw_if_cancelled(cancellation_, "write");
+
+	WSABUF buffer;
+	buffer.buf = const_cast<char*>(ptr_data_);
+	buffer.len = static_cast<ULONG>(size_);
+
+	WSAOVERLAPPED overlapped;
+	ZeroMemory(&overlapped, sizeof(overlapped));
+	overlapped.hEvent = io_event_of_this_thread();
+
+	if (WSASend(_socket, &buffer, 1, NULL, 0, &overlapped, NULL) == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
+	{
+		stringstream sb;
+		sb << "WSASend failed with error: " << WSAGetLastError();
+
+		throw runtime_error { sb.str() };
+	}
+
+	bytes_sent_counter().add(complete_overlapped(_socket, overlapped, deadline_, cancellation_, "write"));
+}
+
+void end_point::write(const char* ptr_data_, size_t size_) const
+{
+	if (_ptr_shm_channel)
+	{
+		_ptr_shm_channel->write(ptr_data_, size_);
+		bytes_sent_counter().add(size_);
+
+		return;
+	}
+
+	int i_result = send(_socket, ptr_data_, size_, 0);
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "send failed with error: " << WSAGetLastError();
+
+		throw runtime_error	{ sb.str() };
+	}
+
+	bytes_sent_counter().add(i_result);
+}
+
+void end_point::write_v(const io_buffer* ptr_buffers_, size_t count_) const
+{
+	if (_ptr_shm_channel)
+	{
+		_ptr_shm_channel->write_v(ptr_buffers_, count_);
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			bytes_sent_counter().add(ptr_buffers_[i].size);
+		}
+
+		return;
+	}
+
+	// the usual case fits on the stack
+	const size_t STACK_BUFFERS = 16;
+
+	WSABUF stack_buffers[STACK_BUFFERS];
+	vector<WSABUF> heap_buffers;
+
+	WSABUF* ptr_wsa_buffers = stack_buffers;
+	if (count_ > STACK_BUFFERS)
+	{
+		heap_buffers.resize(count_);
+		ptr_wsa_buffers = heap_buffers.data();
+	}
+
+	for (size_t i = 0; i < count_; ++i)
+	{
+		ptr_wsa_buffers[i].buf = const_cast<char*>(ptr_buffers_[i].data);
+		ptr_wsa_buffers[i].len = static_cast<ULONG>(ptr_buffers_[i].size);
+	}
+
+	DWORD count_of_sent_bytes = 0;
+
+	int i_result = WSASend(_socket, ptr_wsa_buffers, static_cast<DWORD>(count_), &count_of_sent_bytes, 0, nullptr, nullptr);
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "WSASend failed with error: " << WSAGetLastError();
+
+		throw runtime_error { sb.str() };
+	}
+
+	bytes_sent_counter().add(count_of_sent_bytes);
+}
+
+void end_point::write_v(initializer_list<io_buffer> buffers_) const
+{
+	write_v(buffers_.begin(), buffers_.size());
+}
+
+void end_point::async_read(char* ptr_data_, size_t size_, io_handler handler_)
+{
+	if (_ptr_event_loop == nullptr)
+	{
+		throw logic_error { "async_read: the end_point is not attached to any event_loop" };
+	}
+
+	_ptr_event_loop->_async_read(*this, ptr_data_, size_, move(handler_));
+}
+
+void end_point::async_write(const char* ptr_data_, size_t size_, io_handler handler_)
+{
+	if (_ptr_event_loop == nullptr)
+	{
+		throw logic_error { "async_write: the end_point is not attached to any event_loop" };
+	}
+
+	_ptr_event_loop->_async_write(*this, ptr_data_, size_, move(handler_));
+}
+
+void end_point::async_read_slice(slice_handler handler_)
+{
+	if (_ptr_event_loop == nullptr)
+	{
+		throw logic_error { "async_read_slice: the end_point is not attached to any event_loop" };
+	}
+
+	auto block = _ptr_event_loop->acquire_buffer(_buffer_size);
+
+	auto received_block = block.second;
+
+	_ptr_event_loop->_async_read(*this, block.first, block.second.size(), [received_block, handler_](size_t size_, exception_ptr error_)
+	{
+		if (error_)
+		{
+			handler_({ }, error_);
+		}
+		else
+		{
+			handler_(received_block.slice(0, size_), nullptr);
+		}
+	}, move(block.second));
+}
+
+void end_point::async_write(buffer_slice slice_, io_handler handler_)
+{
+	if (_ptr_event_loop == nullptr)
+	{
+		throw logic_error { "async_write: the end_point is not attached to any event_loop" };
+	}
+
+	const auto ptr_data = slice_.data();
+	const auto size = slice_.size();
+
+	_ptr_event_loop->_async_write(*this, ptr_data, size, move(handler_), move(slice_));
+}
+
+// the promise is shared because std::function requires copyable targets
+static io_handler _as_promise_handler(shared_ptr<promise<size_t>> ptr_promise_)
+{
+	return [ptr_promise_](size_t size_, exception_ptr error_)
+	{
+		if (error_)
+		{
+			ptr_promise_->set_exception(error_);
+		}
+		else
+		{
+			ptr_promise_->set_value(size_);
+		}
+	};
+}
+
+future<size_t> end_point::async_read(char* ptr_data_, size_t size_)
+{
+	auto ptr_promise = make_shared<promise<size_t>>();
+	auto fut = ptr_promise->get_future();
+
+	async_read(ptr_data_, size_, _as_promise_handler(move(ptr_promise)));
+
+	return fut;
+}
+
+future<size_t> end_point::async_write(const char* ptr_data_, size_t size_)
+{
+	auto ptr_promise = make_shared<promise<size_t>>();
+	auto fut = ptr_promise->get_future();
+
+	async_write(ptr_data_, size_, _as_promise_handler(move(ptr_promise)));
+
+	return fut;
+}
+
+void end_point::set_non_blocking(bool non_blocking_)
+{
+	if (_ptr_shm_channel)
+	{
+		throw logic_error { "the shared memory transport has no non-blocking mode" };
+	}
+
+	u_long mode = non_blocking_ ? 1 : 0;
+
+	int i_result = ioctlsocket(_socket, FIONBIO, &mode);
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "ioctlsocket failed with error: " << WSAGetLastError();
+
+		throw runtime_error { sb.str() };
+	}
+}
+
+void end_point::set_no_delay(bool no_delay_)
+{
+	if (transport() != TRANSPORT_TCP)
+	{
+		return;
+	}
+
+	BOOL value = no_delay_ ? TRUE : FALSE;
+
+	int i_result = setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&value), sizeof(value));
+	if (i_result == SOCKET_ERROR)
+	{
+		stringstream sb;
+		sb << "setsockopt(TCP_NODELAY) failed with error: " << WSAGetLastError();
+
+		throw runtime_error { sb.str() };
+	}
+}
+
+SOCKET end_point::native_handle() const
+{
+	return _socket;
+}
+
+E_TRANSPORT end_point::transport() const
+{
+	if (_ptr_shm_channel)
+	{
+		return TRANSPORT_SHARED_MEMORY;
+	}
+
+	sockaddr_storage address;
+	int size = sizeof(address);
+
+	if (getsockname(_socket, reinterpret_cast<sockaddr*>(&address), &size) == 0 && address.ss_family == AF_UNIX)
+	{
+		return TRANSPORT_UNIX;
+	}
+
+	return TRANSPORT_TCP;
+}
+
+
+client::client(string address_, desc desc_)
+	: end_point { _connect(move(address_), desc_) }
+	, _port { move(desc_.port) }
+{
+}
+
+client::~client()
+{
+}
+
+end_point client::_connect(string address_, const desc& desc_)
+{
+	string local_address;
+
+	switch (transport_of(address_, local_address))
+	{
+	case TRANSPORT_UNIX:
+		return { _create_unix_socket(local_address), desc_.buffer_size };
+
+	case TRANSPORT_SHARED_MEMORY:
+		return { shm_connect(local_address), desc_.buffer_size };
+
+	default:
+		return { _create_socket(move(address_), desc_.port), desc_.buffer_size };
+	}
+}
+
+SOCKET client::_create_unix_socket(const string& path_)
+{
+	gl_storage().get_singleton_of<WSAInit>();
+
+	const auto address = unix_address_of(path_);
+
+	auto new_sckt = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (new_sckt == INVALID_SOCKET)
+	{
+		stringstream sb;
+		sb << "socket failed with error: " << WSAGetLastError();
+
+		throw runtime_error { sb.str() };
+	}
+
+	if (connect(new_sckt, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+	{
+		closesocket(new_sckt);
+
+		throw runtime_error { "Unable to connect to server!" };
+	}
+
+	return new_sckt;
+}
+
+SOCKET client::_create_socket(string address_, string port_)
+{
+	auto ptr_address = resolve_address(address_, port_);
+
+	return connect_socket(ptr_address.get());
+}
+
+
@@ -1,10 +1,119 @@
 #pragma once
 #include "stdafx.h"
 
+#include "buffer_pool.hpp"
+#include "stats.hpp"
+
 #undef UNICODE
 
 namespace utility
 {
+	class event_loop;
+	class shm_channel;
+	class shm_acceptor;
+
+	//
+	//	the transport is selected by the scheme of the address:
+	//		"host" + port			TCP
+	//		"unix:<path>"			AF_UNIX stream socket, the port is ignored
+	//		"shm:<name>"			shared memory rings, the port is ignored, see shm_channel
+	//	the server takes the scheme in the place of the port: desc { "unix:<path>" }
+	//
+	enum E_TRANSPORT
+	{
+		TRANSPORT_TCP,
+		TRANSPORT_UNIX,
+		TRANSPORT_SHARED_MEMORY,
+	};
+
+	//	strips the scheme from the address
+	E_TRANSPORT transport_of(const std::string& address_, std::string& rest_);
+
+	//
+	//	completion callback of the asynchronous operations
+	//	size_: count of the transferred bytes, error_: null on success
+	//
+	typedef std::function<void(size_t size_, std::exception_ptr error_)> io_handler;
+
+	//	completion callback of the slice reads, an empty slice means that the peer has disconnected
+	typedef std::function<void(buffer_slice slice_, std::exception_ptr error_)> slice_handler;
+
+	class end_point;
+
+	//
+	//	an operation with a deadline didn't complete in time
+	//	a write may have sent a part of the data, the connection should be closed
+	//
+	class io_timeout_exception : public std::runtime_error
+	{
+	public:
+		io_timeout_exception(std::string msg_);
+	};
+
+	//
+	//	an operation was cancelled by its cancellation_token
+	//
+	class io_cancelled_exception : public std::runtime_error
+	{
+	public:
+		io_cancelled_exception(std::string msg_);
+	};
+
+	typedef std::chrono::steady_clock::time_point io_deadline;
+
+	//
+	//	cancels the blocking operations, which were started with it, from any thread
+	//
+	//	The copies share the state. Once it's cancelled it stays so: every later operation
+	//	with it fails right away.
+	//
+	class cancellation_token
+	{
+	public:
+		cancellation_token();
+
+		void cancel() const;
+		bool is_cancelled() const;
+
+		//	a manual reset event, which is set by cancel(), NULL for none()
+		HANDLE native_handle() const;
+
+		//	it's never cancelled
+		static const cancellation_token& none();
+
+	private:
+		struct state;
+
+		std::shared_ptr<state> _ptr_state;
+
+		explicit cancellation_token(std::nullptr_t);
+	};
+
+	//
+	//	one piece of a scatter/gather write
+	//
+	struct io_buffer
+	{
+		const char* data;
+		size_t size;
+	};
+
+	//
+	//	a buffering destination of gather writes in front of an end_point
+	//
+	class byte_sink
+	{
+	public:
+		virtual ~byte_sink() = default;
+
+		virtual void write_v(const io_buffer* ptr_buffers_, size_t count_) = 0;
+	};
+
+	//
+	//	called once per accepted connection, the end_point is in blocking mode
+	//
+	typedef std::function<void(std::shared_ptr<end_point> end_point_, std::exception_ptr error_)> accept_handler;
+
 	struct desc
 	{
 		size_t buffer_size;
@@ -13,20 +122,117 @@ namespace utility
 		desc(std::string, size_t = 512);
 	};
 
+	//
+	//	makes sure that the socket library is initialized, it's called implicitly by
+	//	the ctors of the server and the client
+	//
+	void initialize_network();
+
+	//
+	//	creates a stream socket, which is usable by the registered I/O as well if it's
+	//	supported by the system
+	//
+	SOCKET open_socket(int family_, int type_, int protocol_);
+
+	//	getaddrinfo of a TCP peer, the result can be reused by any count of connect_socket() calls
+	std::shared_ptr<addrinfo> resolve_address(const std::string& address_, const std::string& port_);
+
+	//	connects to the first reachable one of the addresses
+	SOCKET connect_socket(const addrinfo* ptr_address_);
+
+	//
+	//	bytes received and sent by the end_points of the process, synchronous and
+	//	asynchronous I/O alike, published as "network.bytes_received" and "network.bytes_sent"
+	//
+	stats_counter& bytes_received_counter();
+	stats_counter& bytes_sent_counter();
+
 	class end_point
 	{
+		friend class event_loop;
 	public:
 		end_point(SOCKET, size_t buffer_size_);
+
+		//	the shared memory transport can't be attached to an event_loop
+		end_point(std::shared_ptr<shm_channel>, size_t buffer_size_);
+
+		//	an attached end_point stays attached, its pending operations go on
+		end_point(end_point&&);
+		end_point(const end_point&) = delete;
 		~end_point();
 
+		end_point& operator=(const end_point&) = delete;
+
 		size_t read(char* ptr_date_, size_t size_) const;
 		void write(const char* ptr_data_, size_t size_) const;
 
+		//
+		//	the deadline and the cancellation are checked while it's blocked,
+		//	they throw io_timeout_exception and io_cancelled_exception
+		//
+		size_t read(char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_ = cancellation_token::none()) const;
+		void write(const char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_ = cancellation_token::none()) const;
+
+		//	gather write: the buffers are sent in order by a single call
+		void write_v(const io_buffer* ptr_buffers_, size_t count_) const;
+		void write_v(std::initializer_list<io_buffer> buffers_) const;
+
+		//
+		//	blocks and receives into a pooled block, an empty slice means that the peer
+		//	has disconnected
+		//	The size of the blocks follows the size of the received chunks, starting from
+		//	desc::buffer_size. The unused tail of a block is used by the next read.
+		//
+		buffer_slice read_slice();
+
+		//	by default the pool of the reading thread is used
+		void set_buffer_pool(buffer_pool&);
+
+		//
+		//	asynchronous I/O, the end_point must be attached to an event_loop before
+		//	the handler is called on the completion pool of the event_loop
+		//
+		void async_read(char* ptr_data_, size_t size_, io_handler handler_);
+		void async_write(const char* ptr_data_, size_t size_, io_handler handler_);
+
+		std::future<size_t> async_read(char* ptr_data_, size_t size_);
+		std::future<size_t> async_write(const char* ptr_data_, size_t size_);
+
+		//
+		//	asynchronous I/O without a copy by the registered I/O backend: the read receives
+		//	into a block of event_loop::acquire_buffer(), the write holds its slice until the
+		//	handler is called, and sends it in place if it's in such a block
+		//
+		void async_read_slice(slice_handler handler_);
+		void async_write(buffer_slice slice_, io_handler handler_);
+
+		void set_non_blocking(bool);
+
+		//	TCP_NODELAY: the small segments are sent without waiting for the ack of the previous one
+		//	it's ignored by the local transports
+		void set_no_delay(bool);
+
+		//	INVALID_SOCKET for the shared memory transport
+		SOCKET native_handle() const;
+
+		E_TRANSPORT transport() const;
+
 	protected:
 		SOCKET _socket{ INVALID_SOCKET };
 		size_t _buffer_size;
 
 	private:
+		event_loop* _ptr_event_loop = nullptr;
+
+		std::shared_ptr<shm_channel> _ptr_shm_channel;
+
+		buffer_pool* _ptr_buffer_pool = nullptr;
+		adaptive_buffer_size _receive_size;
+
+		//	the block of the last read_slice() and the beginning of its unused part
+		buffer_slice _receive_block;
+		char* _ptr_receive_block = nullptr;
+		size_t _receive_offset = 0;
 	};
 
 	class server
@@ -40,16 +246,39 @@ namespace utility
 		*/
 		end_point listening();
 
+		//	throws io_timeout_exception and io_cancelled_exception
+		end_point listening(io_deadline deadline_, const cancellation_token& cancellation_ = cancellation_token::none());
+
+		//
+		//	multishot accept: the handler is called for every connection accepted by the
+		//	event_loop until the server is destroyed
+		//
+		void async_accept(event_loop&, accept_handler handler_);
+
 	private:
 		SOCKET _listen_socket { INVALID_SOCKET };
+		event_loop* _ptr_event_loop = nullptr;
 
-		addrinfo* _ptr_server_address;
+		addrinfo* _ptr_server_address = nullptr;
 
 		std::string _port;
 		size_t _buffer_size;
 
+		E_TRANSPORT _transport;
+
+		//	the path of the unix socket or the name of the shared memory
+		std::string _local_address;
+
+		std::unique_ptr<shm_acceptor> _ptr_shm_acceptor;
+
+		//	the threads accept one by one, once the poll found a connection
+		std::mutex _accept_mutex;
+
 		std::tuple<SOCKET, addrinfo*> _create_listen_socket() const;
-		SOCKET _listen();
+		void _listen();
+		void _listen_unix();
+		SOCKET _accept();
+		SOCKET _accept(io_deadline deadline_, const cancellation_token& cancellation_);
 	};
 
 	class client : public end_point
@@ -61,7 +290,9 @@ namespace utility
 	private:
 		std::string _port;
 
+		static end_point _connect(std::string address_, const desc&);
 		static SOCKET _create_socket(std::string address_, std::string port_);
+		static SOCKET _create_unix_socket(const std::string& path_);
 	};
 
 }
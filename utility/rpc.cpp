@@ -0,0 +1,714 @@
+#include "stdafx.h"
+#include "rpc.hpp"
+
+using namespace std;
+using namespace utility;
+
+namespace
+{
+	void put_varint(string& out_, uint64_t value_)
+	{
+		char buffer[MAX_VARINT_SIZE];
+		out_.append(buffer, encode_varint(value_, buffer));
+	}
+
+	void put_string(string& out_, boost::string_ref value_)
+	{
+		put_varint(out_, value_.size());
+		out_.append(value_.data(), value_.size());
+	}
+
+	//
+	//	reads the fields of a message, a truncated message throws rpc_exception
+	//
+	class message_reader
+	{
+	public:
+		message_reader(const char* ptr_data_, size_t size_)
+			: _ptr { ptr_data_ }
+			, _ptr_end { ptr_data_ + size_ }
+		{
+		}
+
+		bool empty() const
+		{
+			return _ptr == _ptr_end;
+		}
+
+		char byte()
+		{
+			return bytes(1)[0];
+		}
+
+		uint64_t varint()
+		{
+			uint64_t value;
+			const auto size = decode_varint(_ptr, _ptr_end - _ptr, value);
+
+			if (size == 0)
+			{
+				throw rpc_exception { "malformed message" };
+			}
+
+			_ptr += size;
+			return value;
+		}
+
+		boost::string_ref bytes(uint64_t size_)
+		{
+			if (size_ > static_cast<uint64_t>(_ptr_end - _ptr))
+			{
+				throw rpc_exception { "malformed message" };
+			}
+
+			boost::string_ref value { _ptr, static_cast<size_t>(size_) };
+			_ptr += size_;
+
+			return value;
+		}
+
+		boost::string_ref text()
+		{
+			return bytes(varint());
+		}
+
+	private:
+		const char* _ptr;
+		const char* _ptr_end;
+	};
+
+	//
+	//	the types which are encoded without metadata
+	//
+	struct builtin_type
+	{
+		type_index type;
+		const char* name;
+		void(*encode)(const object_ref&, string&);
+		object_ref(*decode)(message_reader&);
+	};
+
+	template<class T> void encode_unsigned(const object_ref& value_, string& out_)
+	{
+		put_varint(out_, static_cast<uint64_t>(value_.as<T>()));
+	}
+
+	template<class T> object_ref decode_unsigned(message_reader& reader_)
+	{
+		return object_ref { static_cast<T>(reader_.varint()) };
+	}
+
+	//	zigzag: the small negative values are small varints too
+	template<class T> void encode_signed(const object_ref& value_, string& out_)
+	{
+		const auto value = static_cast<int64_t>(value_.as<T>());
+		put_varint(out_, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+	}
+
+	template<class T> object_ref decode_signed(message_reader& reader_)
+	{
+		const auto value = reader_.varint();
+		return object_ref { static_cast<T>(static_cast<int64_t>((value >> 1) ^ (0 - (value & 1)))) };
+	}
+
+	template<class T> void encode_raw(const object_ref& value_, string& out_)
+	{
+		const T value = value_.as<T>();
+		out_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<class T> object_ref decode_raw(message_reader& reader_)
+	{
+		T value;
+		memcpy(&value, reader_.bytes(sizeof(T)).data(), sizeof(T));
+
+		return object_ref { move(value) };
+	}
+
+	void encode_bool(const object_ref& value_, string& out_)
+	{
+		out_ += value_.as<bool>() ? '\1' : '\0';
+	}
+
+	object_ref decode_bool(message_reader& reader_)
+	{
+		return object_ref { reader_.byte() != 0 };
+	}
+
+	void encode_string(const object_ref& value_, string& out_)
+	{
+		put_string(out_, value_.as<string>());
+	}
+
+	object_ref decode_string(message_reader& reader_)
+	{
+		return object_ref { reader_.text().to_string() };
+	}
+
+	const builtin_type BUILTINS[] =
+	{
+		{ typeid(bool), "bool", &encode_bool, &decode_bool },
+		{ typeid(char), "char", &encode_raw<char>, &decode_raw<char> },
+		{ typeid(int), "int", &encode_signed<int>, &decode_signed<int> },
+		{ typeid(long), "long", &encode_signed<long>, &decode_signed<long> },
+		{ typeid(long long), "long long", &encode_signed<long long>, &decode_signed<long long> },
+		{ typeid(unsigned int), "unsigned int", &encode_unsigned<unsigned int>, &decode_unsigned<unsigned int> },
+		{ typeid(unsigned long), "unsigned long", &encode_unsigned<unsigned long>, &decode_unsigned<unsigned long> },
+		{ typeid(unsigned long long), "unsigned long long", &encode_unsigned<unsigned long long>, &decode_unsigned<unsigned long long> },
+		{ typeid(float), "float", &encode_raw<float>, &decode_raw<float> },
+		{ typeid(double), "double", &encode_raw<double>, &decode_raw<double> },
+		{ typeid(string), "string", &encode_string, &decode_string },
+	};
+
+	const builtin_type* find_builtin(type_index type_)
+	{
+		for (auto& b : BUILTINS)
+		{
+			if (b.type == type_)
+			{
+				return &b;
+			}
+		}
+
+		return nullptr;
+	}
+
+	const builtin_type* find_builtin(const string& name_)
+	{
+		for (auto& b : BUILTINS)
+		{
+			if (name_ == b.name)
+			{
+				return &b;
+			}
+		}
+
+		return nullptr;
+	}
+
+	const char* const VOID_TYPE_NAME = "void";
+
+	const char REQUEST = 'Q';
+	const char RESULT = 'R';
+	const char ERROR_RESULT = 'E';
+
+	//	the size of a read of the connections
+	const size_t READ_SIZE = 64 * 1024;
+}
+
+rpc_exception::rpc_exception(std::string msg_) : runtime_error { msg_ }
+{
+}
+
+//
+//	rpc_codec
+//
+
+rpc_codec::rpc_codec(const base_runtime_database& runtime_) : _runtime { runtime_ }
+{
+}
+
+void rpc_codec::encode(const object_ref& value_, string& out_) const
+{
+	if (!value_)
+	{
+		return;
+	}
+
+	if (auto ptr_builtin = find_builtin(value_.type()))
+	{
+		ptr_builtin->encode(value_, out_);
+		return;
+	}
+
+	_encode_class(_runtime.get_class(value_.type()), value_, out_);
+}
+
+object_ref rpc_codec::decode(type_index type_, const char* ptr_data_, size_t size_) const
+{
+	if (type_ == typeid(void))
+	{
+		return { };
+	}
+
+	if (auto ptr_builtin = find_builtin(type_))
+	{
+		message_reader reader { ptr_data_, size_ };
+		auto value = ptr_builtin->decode(reader);
+
+		if (!reader.empty())
+		{
+			throw rpc_exception { "malformed value of " + string { ptr_builtin->name } };
+		}
+
+		return value;
+	}
+
+	return _decode_class(_runtime.get_class(type_), ptr_data_, size_);
+}
+
+string rpc_codec::type_name(type_index type_) const
+{
+	if (type_ == typeid(void))
+	{
+		return VOID_TYPE_NAME;
+	}
+
+	if (auto ptr_builtin = find_builtin(type_))
+	{
+		return ptr_builtin->name;
+	}
+
+	return _runtime.get_class(type_).name();
+}
+
+type_index rpc_codec::type_of_name(const string& name_) const
+{
+	if (name_ == VOID_TYPE_NAME)
+	{
+		return typeid(void);
+	}
+
+	if (auto ptr_builtin = find_builtin(name_))
+	{
+		return ptr_builtin->type;
+	}
+
+	return _runtime.get_class(name_).type();
+}
+
+void rpc_codec::_encode_class(const class_t& class_, const object_ref& value_, string& out_) const
+{
+	auto fields = class_.fields();
+
+	fields.erase(remove_if(fields.begin(), fields.end(), [](const field_t& f_)
+	{
+		return f_.is_static();
+	}), fields.end());
+
+	//	the order doesn't depend on the hash table of the class
+	sort(fields.begin(), fields.end(), [](const field_t& a_, const field_t& b_)
+	{
+		return a_.name() < b_.name();
+	});
+
+	put_varint(out_, fields.size());
+
+	string value;
+
+	for (auto& f : fields)
+	{
+		value.clear();
+		encode(f.value(value_), value);
+
+		put_string(out_, f.name());
+		put_string(out_, value);
+	}
+}
+
+object_ref rpc_codec::_decode_class(const class_t& class_, const char* ptr_data_, size_t size_) const
+{
+	auto obj = class_.ctor(detail::cpp_ctor_key_t { vector<type_index> { } }).create();
+
+	message_reader reader { ptr_data_, size_ };
+
+	for (auto count = reader.varint(); count > 0; --count)
+	{
+		const auto name = reader.text().to_string();
+		const auto value = reader.text();
+
+		const field_t* ptr_field = nullptr;
+
+		try
+		{
+			ptr_field = &class_.field(detail::cpp_field_key_t { name });
+		}
+		catch (member_not_found_exception&)
+		{
+			//	a field of a newer peer
+			continue;
+		}
+
+		if (!ptr_field->is_static())
+		{
+			ptr_field->set_value(obj, decode(ptr_field->held_type(), value.data(), value.size()));
+		}
+	}
+
+	if (!reader.empty())
+	{
+		throw rpc_exception { "malformed value of " + class_.name() };
+	}
+
+	return obj;
+}
+
+//
+//	rpc_server
+//
+
+struct rpc_server::connection
+{
+	end_point peer;
+	std::thread thread;
+	atomic<bool> finished { false };
+
+	connection(end_point peer_) : peer { move(peer_) }
+	{
+	}
+};
+
+rpc_server::rpc_server(const base_runtime_database& runtime_, desc desc_)
+	: _runtime { runtime_ }
+	, _codec { runtime_ }
+	, _server { move(desc_) }
+	, _accepting { [this] { _accept(); } }
+{
+}
+
+rpc_server::~rpc_server()
+{
+	_cancellation.cancel();
+	_accepting.join();
+
+	for (auto& c : _connections)
+	{
+		c->thread.join();
+	}
+}
+
+void rpc_server::bind(string name_, object_ref object_)
+{
+	lock_guard<mutex> lock { _mutex };
+	_objects[move(name_)] = move(object_);
+}
+
+size_t rpc_server::count_of_calls() const
+{
+	return _count_of_calls;
+}
+
+void rpc_server::_accept()
+{
+	while (!_cancellation.is_cancelled())
+	{
+		try
+		{
+			auto peer = _server.listening(io_deadline::max(), _cancellation);
+
+			lock_guard<mutex> lock { _mutex };
+
+			//	the threads of the closed connections are joined here instead of by the destructor
+			for (auto it = _connections.begin(); it != _connections.end();)
+			{
+				if ((*it)->finished)
+				{
+					(*it)->thread.join();
+					it = _connections.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			_connections.push_back(make_unique<connection>(move(peer)));
+
+			auto& c = *_connections.back();
+			c.thread = std::thread { [this, &c] { _serve(c); } };
+		}
+		catch (exception&)
+		{
+			//	cancelled, or the connection was reset before it was accepted
+		}
+	}
+}
+
+void rpc_server::_serve(connection& connection_)
+{
+	frame_decoder decoder;
+	string responses;
+
+	try
+	{
+		for (;;)
+		{
+			auto space = decoder.prepare(READ_SIZE);
+			const auto size = connection_.peer.read(space.first, space.second, io_deadline::max(), _cancellation);
+
+			if (size == 0)
+			{
+				break;
+			}
+
+			decoder.commit(size);
+
+			responses.clear();
+
+			while (auto request = decoder.next())
+			{
+				_respond(*request, responses);
+			}
+
+			if (!responses.empty())
+			{
+				connection_.peer.write(responses.data(), responses.size(), io_deadline::max(), _cancellation);
+			}
+		}
+	}
+	catch (exception&)
+	{
+		//	cancelled, or the connection is broken: it's dropped
+	}
+
+	connection_.finished = true;
+}
+
+void rpc_server::_respond(boost::string_ref request_, string& out_)
+{
+	message_reader reader { request_.data(), request_.size() };
+
+	string response;
+	uint64_t id = 0;
+
+	try
+	{
+		if (reader.byte() != REQUEST)
+		{
+			throw rpc_exception { "malformed message" };
+		}
+
+		id = reader.varint();
+
+		const auto object_name = reader.text().to_string();
+		const auto method_name = reader.text().to_string();
+
+		vector<object_ref> args;
+		vector<type_index> signature;
+
+		for (auto count = reader.varint(); count > 0; --count)
+		{
+			const auto type = _codec.type_of_name(reader.text().to_string());
+			const auto value = reader.text();
+
+			args.push_back(_codec.decode(type, value.data(), value.size()));
+			signature.push_back(type);
+		}
+
+		auto obj = _object(object_name);
+		auto& method = _runtime.get_class(obj.type()).method(detail::cpp_method_key_t { method_name, move(signature) });
+
+		auto result = method.is_static() ? method.invoke_static(move(args)) : method.invoke(obj, move(args));
+
+		++_count_of_calls;
+
+		response += RESULT;
+		put_varint(response, id);
+		put_string(response, result ? _codec.type_name(result.type()) : VOID_TYPE_NAME);
+
+		string value;
+		_codec.encode(result, value);
+
+		put_string(response, value);
+	}
+	catch (exception& e_)
+	{
+		response.clear();
+		response += ERROR_RESULT;
+		put_varint(response, id);
+		put_string(response, e_.what());
+	}
+
+	put_string(out_, response);
+}
+
+object_ref rpc_server::_object(const string& name_) const
+{
+	lock_guard<mutex> lock { _mutex };
+
+	auto it = _objects.find(name_);
+
+	if (it == _objects.end())
+	{
+		throw rpc_exception { "unknown object: " + name_ };
+	}
+
+	return it->second;
+}
+
+//
+//	rpc_client
+//
+
+rpc_client::rpc_client(const base_runtime_database& runtime_, string address_, desc desc_)
+	: _codec { runtime_ }
+	, _client { move(address_), move(desc_) }
+	, _writer { _client }
+	, _reading { [this] { _read(); } }
+{
+}
+
+rpc_client::~rpc_client()
+{
+	_cancellation.cancel();
+	_reading.join();
+}
+
+future<object_ref> rpc_client::call(const string& object_, const string& method_, vector<object_ref> args_)
+{
+	//	an argument of an unknown type throws here, before anything is sent
+	string args;
+	string value;
+
+	put_varint(args, args_.size());
+
+	for (auto& a : args_)
+	{
+		value.clear();
+		_codec.encode(a, value);
+
+		put_string(args, _codec.type_name(a.type()));
+		put_string(args, value);
+	}
+
+	promise<object_ref> result;
+	auto future_result = result.get_future();
+
+	uint64_t id;
+
+	{
+		lock_guard<mutex> lock { _mutex };
+
+		if (!_error.empty())
+		{
+			result.set_exception(make_exception_ptr(rpc_exception { _error }));
+			return future_result;
+		}
+
+		id = _next_id++;
+		_calls.emplace(id, move(result));
+	}
+
+	string request;
+	request += REQUEST;
+	put_varint(request, id);
+	put_string(request, object_);
+	put_string(request, method_);
+	request += args;
+
+	try
+	{
+		lock_guard<mutex> lock { _write_mutex };
+		_writer.write(request);
+	}
+	catch (exception& e_)
+	{
+		_fail_all(e_.what());
+	}
+
+	return future_result;
+}
+
+size_t rpc_client::count_of_calls_in_flight() const
+{
+	lock_guard<mutex> lock { _mutex };
+	return _calls.size();
+}
+
+void rpc_client::_read()
+{
+	frame_decoder decoder;
+	string error = "the connection was closed";
+
+	try
+	{
+		for (;;)
+		{
+			auto space = decoder.prepare(READ_SIZE);
+			const auto size = _client.read(space.first, space.second, io_deadline::max(), _cancellation);
+
+			if (size == 0)
+			{
+				break;
+			}
+
+			decoder.commit(size);
+
+			while (auto response = decoder.next())
+			{
+				_complete(*response);
+			}
+		}
+	}
+	catch (exception& e_)
+	{
+		if (!_cancellation.is_cancelled())
+		{
+			error = e_.what();
+		}
+	}
+
+	_fail_all(error);
+}
+
+void rpc_client::_complete(boost::string_ref response_)
+{
+	message_reader reader { response_.data(), response_.size() };
+
+	const auto kind = reader.byte();
+	const auto id = reader.varint();
+
+	promise<object_ref> result;
+
+	{
+		lock_guard<mutex> lock { _mutex };
+
+		auto it = _calls.find(id);
+
+		if (it == _calls.end())
+		{
+			return;
+		}
+
+		result = move(it->second);
+		_calls.erase(it);
+	}
+
+	try
+	{
+		if (kind == ERROR_RESULT)
+		{
+			throw rpc_exception { reader.text().to_string() };
+		}
+
+		const auto type = _codec.type_of_name(reader.text().to_string());
+		const auto value = reader.text();
+
+		result.set_value(_codec.decode(type, value.data(), value.size()));
+	}
+	catch (exception&)
+	{
+		result.set_exception(current_exception());
+	}
+}
+
+void rpc_client::_fail_all(const string& error_)
+{
+	unordered_map<uint64_t, promise<object_ref>> calls;
+
+	{
+		lock_guard<mutex> lock { _mutex };
+
+		if (_error.empty())
+		{
+			_error = error_;
+		}
+
+		calls.swap(_calls);
+	}
+
+	for (auto& c : calls)
+	{
+		c.second.set_exception(make_exception_ptr(rpc_exception { error_ }));
+	}
+}
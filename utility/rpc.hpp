@@ -0,0 +1,146 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+#include "framing.hpp"
+#include "mirror.h"
+
+#include <list>
+
+namespace utility
+{
+	//
+	//	the remote call failed: the object, the method or a type isn't known by the peer,
+	//	the method has thrown, or the connection was closed before the result arrived
+	//
+	class rpc_exception : public std::runtime_error
+	{
+	public:
+		rpc_exception(std::string msg_);
+	};
+
+	//
+	//	binary encoding of the values by their registered metadata
+	//
+	//	The built-in types (bool, char, the integers, float, double, std::string) are
+	//	encoded as varints, zigzag varints, raw IEEE values and length-prefixed bytes.
+	//	A class registered in the runtime database is encoded by its fields:
+	//		[varint: count][name, varint: size, value]...
+	//	The fields are matched by name, the unknown ones are skipped. A class is decoded
+	//	into an instance created by its default constructor, so it must be registered.
+	//
+	class rpc_codec
+	{
+	public:
+		explicit rpc_codec(const base_runtime_database&);
+
+		void encode(const object_ref& value_, std::string& out_) const;
+
+		//	the whole range must be consumed by the value
+		object_ref decode(std::type_index type_, const char* ptr_data_, size_t size_) const;
+
+		//	"void" for the empty object_ref
+		std::string type_name(std::type_index) const;
+		std::type_index type_of_name(const std::string&) const;
+
+	private:
+		const base_runtime_database& _runtime;
+
+		void _encode_class(const class_t&, const object_ref& value_, std::string& out_) const;
+		object_ref _decode_class(const class_t&, const char* ptr_data_, size_t size_) const;
+	};
+
+	//
+	//	serves the methods of the bound objects over framed connections
+	//
+	//	request:	['Q'][varint: id][object][method][varint: count][type, varint: size, value]...
+	//	response:	['R'][varint: id][type, varint: size, value] or ['E'][varint: id][message]
+	//	the strings are length-prefixed, the frames are varint-prefixed, see framing.hpp
+	//
+	//	Each connection is served by its own thread in the order of the requests, the
+	//	responses of the requests received by one read are sent by one write.
+	//
+	class rpc_server
+	{
+	public:
+		rpc_server(const base_runtime_database&, desc);
+
+		//	the connections are closed, the pending requests aren't answered
+		~rpc_server();
+
+		rpc_server(const rpc_server&) = delete;
+		rpc_server& operator=(const rpc_server&) = delete;
+
+		//	the methods of the object become callable by name, it's kept alive by the server
+		void bind(std::string name_, object_ref object_);
+
+		size_t count_of_calls() const;
+
+	private:
+		struct connection;
+
+		const base_runtime_database& _runtime;
+		rpc_codec _codec;
+		server _server;
+
+		cancellation_token _cancellation;
+
+		mutable std::mutex _mutex;
+		std::unordered_map<std::string, object_ref> _objects;
+		std::list<std::unique_ptr<connection>> _connections;
+
+		std::atomic<size_t> _count_of_calls { 0 };
+
+		std::thread _accepting;
+
+		void _accept();
+		void _serve(connection&);
+		void _respond(boost::string_ref request_, std::string& out_);
+		object_ref _object(const std::string& name_) const;
+	};
+
+	//
+	//	calls the methods of the objects of an rpc_server
+	//
+	//	Any count of calls can be in flight from any threads, the responses are matched to
+	//	them by the request id on a reader thread.
+	//
+	class rpc_client
+	{
+	public:
+		rpc_client(const base_runtime_database&, std::string address_, desc);
+
+		//	the calls in flight fail with rpc_exception
+		~rpc_client();
+
+		rpc_client(const rpc_client&) = delete;
+		rpc_client& operator=(const rpc_client&) = delete;
+
+		//	the method is selected by the types of the arguments, as by cpp_method_key_t
+		std::future<object_ref> call(const std::string& object_, const std::string& method_, std::vector<object_ref> args_ = { });
+
+		size_t count_of_calls_in_flight() const;
+
+	private:
+		rpc_codec _codec;
+		client _client;
+
+		cancellation_token _cancellation;
+
+		mutable std::mutex _mutex;
+		std::unordered_map<uint64_t, std::promise<object_ref>> _calls;
+		uint64_t _next_id = 1;
+
+		//	set when the connection is closed, the later calls fail right away
+		std::string _error;
+
+		//	the requests are written by the calling threads one by one
+		std::mutex _write_mutex;
+		frame_writer _writer;
+
+		std::thread _reading;
+
+		void _read();
+		void _complete(boost::string_ref response_);
+		void _fail_all(const std::string& error_);
+	};
+}
@@ -0,0 +1,220 @@
+#include "stdafx.h"
+#include "send_queue.hpp"
+
+using namespace std;
+using namespace utility;
+
+
+namespace
+{
+	// count of the messages per gather write
+	const size_t MAX_BUFFERS_PER_SEND = 64;
+}
+
+send_queue::send_queue(const end_point& end_point_, size_t max_queued_bytes_, E_OVERFLOW_POLICY policy_)
+	: _end_point { end_point_ }
+	, _max_queued_bytes { max_queued_bytes_ }
+	, _policy { policy_ }
+{
+	_sender = thread { [this] { _send_loop(); } };
+}
+
+send_queue::~send_queue()
+{
+	{
+		lock_guard<mutex> lock { _mutex };
+		_stopping = true;
+	}
+
+	_cv_has_message.notify_one();
+	_sender.join();
+}
+
+bool send_queue::enqueue(string message_)
+{
+	const auto size = message_.size();
+
+	unique_lock<mutex> lock { _mutex };
+
+	_rethrow_error();
+
+	auto fits = [&] { return _queue.empty() || _queued_bytes + size <= _max_queued_bytes; };
+
+	if (!fits())
+	{
+		switch (_policy)
+		{
+		case OVERFLOW_POLICY_BLOCK:
+			_cv_has_room.wait(lock, [&] { return fits() || _error; });
+			_rethrow_error();
+			break;
+
+		case OVERFLOW_POLICY_DROP_OLDEST:
+			while (!fits())
+			{
+				_queued_bytes -= _queue.front().size();
+				_dropped_bytes += _queue.front().size();
+				++_count_of_dropped_messages;
+
+				_queue.pop_front();
+			}
+			break;
+
+		case OVERFLOW_POLICY_DROP_NEWEST:
+			_dropped_bytes += size;
+			++_count_of_dropped_messages;
+			return false;
+		}
+	}
+
+	const bool was_empty = _queue.empty();
+
+	_queued_bytes += size;
+	_queue.push_back(move(message_));
+
+	lock.unlock();
+
+	if (was_empty)
+	{
+		_cv_has_message.notify_one();
+	}
+
+	return true;
+}
+
+bool send_queue::enqueue(const char* ptr_data_, size_t size_)
+{
+	return enqueue(string { ptr_data_, size_ });
+}
+
+void send_queue::write_v(const io_buffer* ptr_buffers_, size_t count_)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < count_; ++i)
+	{
+		size += ptr_buffers_[i].size;
+	}
+
+	string message;
+	message.reserve(size);
+
+	for (size_t i = 0; i < count_; ++i)
+	{
+		message.append(ptr_buffers_[i].data, ptr_buffers_[i].size);
+	}
+
+	enqueue(move(message));
+}
+
+void send_queue::flush()
+{
+	unique_lock<mutex> lock { _mutex };
+
+	_cv_has_room.wait(lock, [&] { return (_queue.empty() && !_sending) || _error; });
+
+	_rethrow_error();
+}
+
+size_t send_queue::queued_bytes() const
+{
+	lock_guard<mutex> lock { _mutex };
+
+	return _queued_bytes;
+}
+
+size_t send_queue::dropped_bytes() const
+{
+	return _dropped_bytes;
+}
+
+size_t send_queue::count_of_dropped_messages() const
+{
+	return _count_of_dropped_messages;
+}
+
+size_t send_queue::sent_bytes() const
+{
+	return _sent_bytes;
+}
+
+void send_queue::_send_loop()
+{
+	deque<string> batch;
+
+	unique_lock<mutex> lock { _mutex };
+
+	for (;;)
+	{
+		_cv_has_message.wait(lock, [&] { return !_queue.empty() || _stopping; });
+
+		if (_queue.empty())
+		{
+			// stopping and everything has been sent
+			break;
+		}
+
+		batch.swap(_queue);
+		_queued_bytes = 0;
+		_sending = true;
+
+		lock.unlock();
+
+		// there is room for the producers while the batch is being sent
+		_cv_has_room.notify_all();
+
+		exception_ptr error;
+
+		try
+		{
+			_send(batch);
+		}
+		catch (...)
+		{
+			error = current_exception();
+		}
+
+		batch.clear();
+
+		lock.lock();
+
+		_sending = false;
+		_error = error;
+
+		_cv_has_room.notify_all();
+
+		if (_error)
+		{
+			break;
+		}
+	}
+}
+
+void send_queue::_send(deque<string>& batch_)
+{
+	vector<io_buffer> buffers;
+	buffers.reserve(batch_.size() < MAX_BUFFERS_PER_SEND ? batch_.size() : MAX_BUFFERS_PER_SEND);
+
+	for (auto it = batch_.begin(); it != batch_.end(); )
+	{
+		buffers.clear();
+		size_t size = 0;
+
+		for (; it != batch_.end() && buffers.size() < MAX_BUFFERS_PER_SEND; ++it)
+		{
+			buffers.push_back({ it->data(), it->size() });
+			size += it->size();
+		}
+
+		_end_point.write_v(buffers.data(), buffers.size());
+
+		_sent_bytes += size;
+	}
+}
+
+void send_queue::_rethrow_error()
+{
+	if (_error)
+	{
+		rethrow_exception(_error);
+	}
+}
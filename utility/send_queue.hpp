@@ -0,0 +1,91 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+
+namespace utility
+{
+	enum E_OVERFLOW_POLICY
+	{
+		//	the producer waits until there is enough room
+		OVERFLOW_POLICY_BLOCK,
+
+		//	the oldest queued messages are dropped to make room for the new one
+		OVERFLOW_POLICY_DROP_OLDEST,
+
+		//	the new message is dropped
+		OVERFLOW_POLICY_DROP_NEWEST,
+	};
+
+	//
+	//	asynchronous, bounded send queue of an end_point
+	//
+	//	The producer only appends the message to the queue, a sender thread sends the
+	//	queued messages by gather writes, as many at once as are queued. A message is either
+	//	sent or dropped as a whole, so it's safe to queue frames.
+	//	The bound applies to the waiting messages, the batch which is being sent doesn't
+	//	count. A message larger than the bound is accepted into an empty queue.
+	//
+	//	An error of the sender is rethrown by the next call.
+	//
+	class send_queue : public byte_sink
+	{
+	public:
+		static constexpr size_t DEFAULT_MAX_QUEUED_BYTES = 1024 * 1024;
+
+		send_queue(const end_point&, size_t max_queued_bytes_ = DEFAULT_MAX_QUEUED_BYTES, E_OVERFLOW_POLICY policy_ = OVERFLOW_POLICY_DROP_OLDEST);
+
+		//	the queued messages are still sent
+		~send_queue();
+
+		send_queue(const send_queue&) = delete;
+		send_queue& operator=(const send_queue&) = delete;
+
+		//	returns false if the message was dropped by OVERFLOW_POLICY_DROP_NEWEST
+		bool enqueue(std::string message_);
+		bool enqueue(const char* ptr_data_, size_t size_);
+
+		//	the buffers are queued as one message
+		void write_v(const io_buffer* ptr_buffers_, size_t count_) override;
+
+		//	blocks until every queued message has been sent
+		void flush();
+
+		//	bytes waiting in the queue
+		size_t queued_bytes() const;
+
+		size_t dropped_bytes() const;
+		size_t count_of_dropped_messages() const;
+
+		size_t sent_bytes() const;
+
+	private:
+		const end_point& _end_point;
+
+		const size_t _max_queued_bytes;
+		const E_OVERFLOW_POLICY _policy;
+
+		mutable std::mutex _mutex;
+		std::condition_variable _cv_has_message;
+		std::condition_variable _cv_has_room;
+
+		std::deque<std::string> _queue;
+		size_t _queued_bytes = 0;
+
+		bool _sending = false;
+		bool _stopping = false;
+
+		std::exception_ptr _error;
+
+		std::atomic<size_t> _dropped_bytes { 0 };
+		std::atomic<size_t> _count_of_dropped_messages { 0 };
+		std::atomic<size_t> _sent_bytes { 0 };
+
+		std::thread _sender;
+
+		void _send_loop();
+		void _send(std::deque<std::string>& batch_);
+
+		//	the caller holds the lock
+		void _rethrow_error();
+	};
+}
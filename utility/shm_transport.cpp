@@ -0,0 +1,556 @@
+#include "stdafx.h"
+#include "shm_transport.hpp"
+
+using namespace std;
+using namespace utility;
+
+
+//
+//	the shared memory is zero initialized by the system, which is a valid initial state
+//	for every field below
+//
+struct utility::shm_ring_header
+{
+	alignas(64) atomic<uint64_t> write_position;
+	alignas(64) atomic<uint64_t> read_position;
+
+	alignas(64) atomic<uint32_t> reader_waiting;
+	atomic<uint32_t> writer_waiting;
+
+	atomic<uint32_t> writer_closed;
+	atomic<uint32_t> reader_closed;
+};
+
+struct utility::shm_connection_header
+{
+	atomic<uint32_t> accepted;
+
+	//	[0]: client -> server, [1]: server -> client
+	shm_ring_header rings[2];
+};
+
+
+namespace
+{
+	struct control_block
+	{
+		//	the connections announced to the acceptor, it's changed under the connect mutex
+		atomic<uint32_t> count_of_connections;
+	};
+
+	// busy waiting before sleeping on the event
+	const int SPIN_COUNT = 4096;
+
+	// the waits are periodically repeated, so a lost wake up can't block forever
+	const DWORD WAIT_INTERVAL_MS = 50;
+
+	const DWORD CONNECT_TIMEOUT_MS = 5000;
+
+	const size_t RING_MASK = shm_channel::RING_CAPACITY - 1;
+
+	string object_name(const string& name_)
+	{
+		return "Local\\utility_shm_" + name_;
+	}
+
+	string object_name(const string& name_, uint32_t id_, const char* suffix_)
+	{
+		stringstream sb;
+		sb << object_name(name_) << "." << id_ << suffix_;
+
+		return sb.str();
+	}
+
+	runtime_error win32_error(const char* operation_)
+	{
+		stringstream sb;
+		sb << operation_ << " failed with error: " << GetLastError();
+
+		return runtime_error { sb.str() };
+	}
+
+	//
+	//	waits for the event for at most WAIT_INTERVAL_MS
+	//	throws when the deadline has passed or the operation was cancelled
+	//
+	void wait_for(HANDLE event_, io_deadline deadline_, const cancellation_token& cancellation_, const char* operation_)
+	{
+		DWORD timeout = WAIT_INTERVAL_MS;
+
+		if (deadline_ != io_deadline::max())
+		{
+			const auto now = chrono::steady_clock::now();
+			if (now >= deadline_)
+			{
+				throw io_timeout_exception { string { operation_ } + " timed out" };
+			}
+
+			const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline_ - now).count() + 1;
+			if (remaining < timeout)
+			{
+				timeout = static_cast<DWORD>(remaining);
+			}
+		}
+
+		HANDLE handles[] = { event_, cancellation_.native_handle() };
+
+		const auto result = WaitForMultipleObjects(handles[1] ? 2 : 1, handles, FALSE, timeout);
+
+		if (result == WAIT_OBJECT_0 + 1 || cancellation_.is_cancelled())
+		{
+			throw io_cancelled_exception { string { operation_ } + " was cancelled" };
+		}
+	}
+
+	HANDLE create_event(const string& name_)
+	{
+		auto handle = CreateEventA(NULL, FALSE, FALSE, name_.c_str());
+		if (handle == NULL)
+		{
+			throw win32_error("CreateEvent");
+		}
+
+		return handle;
+	}
+}
+
+
+shm_channel::shm_channel(const string& name_, uint32_t id_, bool server_side_)
+{
+	const size_t size = sizeof(shm_connection_header) + 2 * RING_CAPACITY;
+
+	// both sides create it, the second one opens the existing mapping
+	_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(size), object_name(name_, id_, "").c_str());
+	if (_mapping == NULL)
+	{
+		throw win32_error("CreateFileMapping");
+	}
+
+	_ptr_header = static_cast<shm_connection_header*>(MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+	if (_ptr_header == nullptr)
+	{
+		auto error = win32_error("MapViewOfFile");
+		CloseHandle(_mapping);
+
+		throw error;
+	}
+
+	auto ptr_data = reinterpret_cast<char*>(_ptr_header + 1);
+
+	HANDLE events[4] = { };
+
+	try
+	{
+		events[0] = create_event(object_name(name_, id_, ".0.data"));
+		events[1] = create_event(object_name(name_, id_, ".0.space"));
+		events[2] = create_event(object_name(name_, id_, ".1.data"));
+		events[3] = create_event(object_name(name_, id_, ".1.space"));
+
+		_accepted_event = create_event(object_name(name_, id_, ".accepted"));
+	}
+	catch (...)
+	{
+		for (auto e : events)
+		{
+			if (e)
+			{
+				CloseHandle(e);
+			}
+		}
+
+		UnmapViewOfFile(_ptr_header);
+		CloseHandle(_mapping);
+
+		throw;
+	}
+
+	const int in = server_side_ ? 0 : 1;
+	const int out = 1 - in;
+
+	_ptr_in = &_ptr_header->rings[in];
+	_ptr_in_data = ptr_data + in * RING_CAPACITY;
+	_in_data_event = events[2 * in];
+	_in_space_event = events[2 * in + 1];
+
+	_ptr_out = &_ptr_header->rings[out];
+	_ptr_out_data = ptr_data + out * RING_CAPACITY;
+	_out_data_event = events[2 * out];
+	_out_space_event = events[2 * out + 1];
+}
+
+shm_channel::~shm_channel()
+{
+	close();
+
+	for (auto e : { _in_data_event, _in_space_event, _out_data_event, _out_space_event, _accepted_event })
+	{
+		CloseHandle(e);
+	}
+
+	UnmapViewOfFile(_ptr_header);
+	CloseHandle(_mapping);
+}
+
+size_t shm_channel::read(char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_)
+{
+	auto& ring = *_ptr_in;
+
+	for (int spins = 0; ; )
+	{
+		const auto w = ring.write_position.load(memory_order_acquire);
+		const auto r = ring.read_position.load(memory_order_relaxed);
+
+		if (w != r)
+		{
+			const size_t available = static_cast<size_t>(w - r);
+			const size_t size = available < size_ ? available : size_;
+
+			const size_t offset = static_cast<size_t>(r & RING_MASK);
+			const size_t first = RING_CAPACITY - offset < size ? RING_CAPACITY - offset : size;
+
+			memcpy(ptr_data_, _ptr_in_data + offset, first);
+			memcpy(ptr_data_ + first, _ptr_in_data, size - first);
+
+			ring.read_position.store(r + size);
+
+			if (ring.writer_waiting.exchange(0))
+			{
+				SetEvent(_in_space_event);
+			}
+
+			return size;
+		}
+
+		if (ring.writer_closed.load() || _closed)
+		{
+			return 0;
+		}
+
+		if (++spins < SPIN_COUNT)
+		{
+			YieldProcessor();
+			continue;
+		}
+
+		// the writer checks the flag after it published the data, so either it sees
+		// the flag or this thread sees the data
+		ring.reader_waiting.store(1);
+
+		try
+		{
+			if (ring.write_position.load() == r && !ring.writer_closed.load())
+			{
+				wait_for(_in_data_event, deadline_, cancellation_, "read");
+			}
+		}
+		catch (...)
+		{
+			ring.reader_waiting.store(0);
+			throw;
+		}
+
+		ring.reader_waiting.store(0);
+		spins = 0;
+	}
+}
+
+void shm_channel::write(const char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_)
+{
+	_write(ptr_data_, size_, deadline_, cancellation_);
+	_notify_reader();
+}
+
+void shm_channel::write_v(const io_buffer* ptr_buffers_, size_t count_)
+{
+	// the reader is woken up once
+	for (size_t i = 0; i < count_; ++i)
+	{
+		_write(ptr_buffers_[i].data, ptr_buffers_[i].size, io_deadline::max(), cancellation_token::none());
+	}
+
+	_notify_reader();
+}
+
+void shm_channel::close()
+{
+	if (_closed.exchange(true))
+	{
+		return;
+	}
+
+	_ptr_out->writer_closed.store(1);
+	_ptr_in->reader_closed.store(1);
+
+	SetEvent(_out_data_event);
+	SetEvent(_in_space_event);
+}
+
+bool shm_channel::wait_for_accept(unsigned long timeout_ms_)
+{
+	const auto deadline = GetTickCount64() + timeout_ms_;
+
+	while (!_ptr_header->accepted.load())
+	{
+		const auto now = GetTickCount64();
+		if (now >= deadline)
+		{
+			return false;
+		}
+
+		WaitForSingleObject(_accepted_event, static_cast<DWORD>(deadline - now < WAIT_INTERVAL_MS ? deadline - now : WAIT_INTERVAL_MS));
+	}
+
+	return true;
+}
+
+void shm_channel::accept()
+{
+	_ptr_header->accepted.store(1);
+
+	SetEvent(_accepted_event);
+}
+
+void shm_channel::_write(const char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_)
+{
+	auto& ring = *_ptr_out;
+
+	for (int spins = 0; size_ > 0; )
+	{
+		if (ring.reader_closed.load() || _closed)
+		{
+			throw runtime_error { "I/O error: the peer has closed the shared memory connection" };
+		}
+
+		const auto r = ring.read_position.load(memory_order_acquire);
+		const auto w = ring.write_position.load(memory_order_relaxed);
+
+		const size_t room = RING_CAPACITY - static_cast<size_t>(w - r);
+
+		if (room > 0)
+		{
+			const size_t size = room < size_ ? room : size_;
+
+			const size_t offset = static_cast<size_t>(w & RING_MASK);
+			const size_t first = RING_CAPACITY - offset < size ? RING_CAPACITY - offset : size;
+
+			memcpy(_ptr_out_data + offset, ptr_data_, first);
+			memcpy(_ptr_out_data, ptr_data_ + first, size - first);
+
+			ring.write_position.store(w + size);
+
+			ptr_data_ += size;
+			size_ -= size;
+
+			spins = 0;
+			continue;
+		}
+
+		// the ring is full, the reader has to be woken up before this thread waits for it
+		_notify_reader();
+
+		if (++spins < SPIN_COUNT)
+		{
+			YieldProcessor();
+			continue;
+		}
+
+		ring.writer_waiting.store(1);
+
+		try
+		{
+			if (ring.read_position.load() == r && !ring.reader_closed.load())
+			{
+				wait_for(_out_space_event, deadline_, cancellation_, "write");
+			}
+		}
+		catch (...)
+		{
+			ring.writer_waiting.store(0);
+			throw;
+		}
+
+		ring.writer_waiting.store(0);
+		spins = 0;
+	}
+}
+
+void shm_channel::_notify_reader()
+{
+	if (_ptr_out->reader_waiting.exchange(0))
+	{
+		SetEvent(_out_data_event);
+	}
+}
+
+
+shm_acceptor::shm_acceptor(const string& name_)
+	: _name { name_ }
+{
+	_control_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(control_block), object_name(_name).c_str());
+	if (_control_mapping == NULL)
+	{
+		throw win32_error("CreateFileMapping");
+	}
+
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		CloseHandle(_control_mapping);
+
+		stringstream sb;
+		sb << "the shared memory address \"" << _name << "\" is already in use";
+
+		throw runtime_error { sb.str() };
+	}
+
+	_ptr_control = MapViewOfFile(_control_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(control_block));
+	_connect_semaphore = CreateSemaphoreA(NULL, 0, LONG_MAX, (object_name(_name) + ".connect").c_str());
+	_connect_mutex = CreateMutexA(NULL, FALSE, (object_name(_name) + ".connect_mutex").c_str());
+	_stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	if (_ptr_control == nullptr || _connect_semaphore == NULL || _connect_mutex == NULL || _stop_event == NULL)
+	{
+		auto error = win32_error("shm_acceptor");
+
+		if (_ptr_control)
+		{
+			UnmapViewOfFile(_ptr_control);
+		}
+
+		for (auto h : { _connect_semaphore, _connect_mutex, _stop_event, _control_mapping })
+		{
+			if (h)
+			{
+				CloseHandle(h);
+			}
+		}
+
+		throw error;
+	}
+}
+
+shm_acceptor::~shm_acceptor()
+{
+	SetEvent(_stop_event);
+
+	UnmapViewOfFile(_ptr_control);
+
+	CloseHandle(_connect_semaphore);
+	CloseHandle(_connect_mutex);
+	CloseHandle(_stop_event);
+	CloseHandle(_control_mapping);
+}
+
+shared_ptr<shm_channel> shm_acceptor::accept(io_deadline deadline_, const cancellation_token& cancellation_)
+{
+	HANDLE handles[] = { _connect_semaphore, _stop_event, cancellation_.native_handle() };
+
+	DWORD timeout = INFINITE;
+	if (deadline_ != io_deadline::max())
+	{
+		const auto now = chrono::steady_clock::now();
+
+		timeout = deadline_ > now ? static_cast<DWORD>(chrono::duration_cast<chrono::milliseconds>(deadline_ - now).count() + 1) : 0;
+	}
+
+	const auto result = WaitForMultipleObjects(handles[2] ? 3 : 2, handles, FALSE, timeout);
+
+	if (result == WAIT_TIMEOUT)
+	{
+		throw io_timeout_exception { "accept timed out" };
+	}
+
+	if (result == WAIT_OBJECT_0 + 2)
+	{
+		throw io_cancelled_exception { "accept was cancelled" };
+	}
+
+	if (result != WAIT_OBJECT_0)
+	{
+		throw runtime_error { "accept failed: the shm_acceptor has been closed" };
+	}
+
+	// the ids are announced in order, the client has created the connection already
+	auto ptr_channel = make_shared<shm_channel>(_name, ++_count_of_accepted, true);
+	ptr_channel->accept();
+
+	return ptr_channel;
+}
+
+
+shared_ptr<shm_channel> utility::shm_connect(const string& name_)
+{
+	auto control_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, object_name(name_).c_str());
+	if (control_mapping == NULL)
+	{
+		throw runtime_error { "Unable to connect to server!" };
+	}
+
+	auto ptr_control = static_cast<control_block*>(MapViewOfFile(control_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(control_block)));
+	auto connect_semaphore = OpenSemaphoreA(SEMAPHORE_MODIFY_STATE | SYNCHRONIZE, FALSE, (object_name(name_) + ".connect").c_str());
+	auto connect_mutex = OpenMutexA(SYNCHRONIZE, FALSE, (object_name(name_) + ".connect_mutex").c_str());
+
+	auto release = [&]
+	{
+		if (ptr_control)
+		{
+			UnmapViewOfFile(ptr_control);
+		}
+
+		for (auto h : { connect_semaphore, connect_mutex, control_mapping })
+		{
+			if (h)
+			{
+				CloseHandle(h);
+			}
+		}
+	};
+
+	if (ptr_control == nullptr || connect_semaphore == NULL || connect_mutex == NULL)
+	{
+		release();
+
+		throw runtime_error { "Unable to connect to server!" };
+	}
+
+	//
+	//	the id is announced by the semaphore only if the connection is created, so a failed
+	//	client doesn't take an id from the acceptor, the next one connects by the same id.
+	//	An abandoned mutex is owned as well, its client hasn't announced anything.
+	//
+	const auto wait_result = WaitForSingleObject(connect_mutex, CONNECT_TIMEOUT_MS);
+	if (wait_result != WAIT_OBJECT_0 && wait_result != WAIT_ABANDONED)
+	{
+		release();
+
+		throw runtime_error { "Unable to connect to server: the connect mutex wasn't acquired in time" };
+	}
+
+	shared_ptr<shm_channel> ptr_channel;
+
+	try
+	{
+		const auto id = ptr_control->count_of_connections.load() + 1;
+
+		ptr_channel = make_shared<shm_channel>(name_, id, false);
+
+		ptr_control->count_of_connections.store(id);
+		ReleaseSemaphore(connect_semaphore, 1, NULL);
+	}
+	catch (...)
+	{
+		ReleaseMutex(connect_mutex);
+		release();
+
+		throw;
+	}
+
+	ReleaseMutex(connect_mutex);
+	release();
+
+	if (!ptr_channel->wait_for_accept(CONNECT_TIMEOUT_MS))
+	{
+		throw runtime_error { "Unable to connect to server: the connection wasn't accepted in time" };
+	}
+
+	return ptr_channel;
+}
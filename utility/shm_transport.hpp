@@ -0,0 +1,97 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+
+namespace utility
+{
+	struct shm_connection_header;
+	struct shm_ring_header;
+
+	//
+	//	one end of a shared memory connection between two processes of the same host
+	//
+	//	Each direction is a single producer, single consumer byte ring. The data is copied
+	//	into the ring and out of it, no system call is made while both sides are busy. An
+	//	idle side spins a bit, then sleeps on an event, which the other side sets only when
+	//	it sees that it's sleeping.
+	//
+	class shm_channel
+	{
+	public:
+		static constexpr size_t RING_CAPACITY = 1024 * 1024;
+
+		shm_channel(const std::string& name_, uint32_t id_, bool server_side_);
+		~shm_channel();
+
+		shm_channel(const shm_channel&) = delete;
+		shm_channel& operator=(const shm_channel&) = delete;
+
+		//	blocks until some data has arrived, returns zero when the peer has closed the connection
+		size_t read(char* ptr_data_, size_t size_, io_deadline deadline_ = io_deadline::max(), const cancellation_token& cancellation_ = cancellation_token::none());
+
+		//	blocks until everything has been copied into the ring
+		void write(const char* ptr_data_, size_t size_, io_deadline deadline_ = io_deadline::max(), const cancellation_token& cancellation_ = cancellation_token::none());
+		void write_v(const io_buffer* ptr_buffers_, size_t count_);
+
+		//	the reads of the peer return zero, its writes fail
+		void close();
+
+		//	the server has accepted the connection
+		bool wait_for_accept(unsigned long timeout_ms_);
+		void accept();
+
+	private:
+		HANDLE _mapping = NULL;
+		shm_connection_header* _ptr_header = nullptr;
+
+		shm_ring_header* _ptr_in;
+		char* _ptr_in_data;
+		HANDLE _in_data_event;
+		HANDLE _in_space_event;
+
+		shm_ring_header* _ptr_out;
+		char* _ptr_out_data;
+		HANDLE _out_data_event;
+		HANDLE _out_space_event;
+
+		HANDLE _accepted_event;
+
+		std::atomic<bool> _closed { false };
+
+		void _write(const char* ptr_data_, size_t size_, io_deadline deadline_, const cancellation_token& cancellation_);
+		void _notify_reader();
+	};
+
+	//
+	//	the listening side of the shared memory transport
+	//
+	class shm_acceptor
+	{
+	public:
+		shm_acceptor(const std::string& name_);
+		~shm_acceptor();
+
+		shm_acceptor(const shm_acceptor&) = delete;
+		shm_acceptor& operator=(const shm_acceptor&) = delete;
+
+		//	blocks until a client connects
+		std::shared_ptr<shm_channel> accept(io_deadline deadline_ = io_deadline::max(), const cancellation_token& cancellation_ = cancellation_token::none());
+
+	private:
+		std::string _name;
+
+		HANDLE _control_mapping = NULL;
+		void* _ptr_control = nullptr;
+
+		HANDLE _connect_semaphore = NULL;
+
+		//	held by a client while it creates its connection and announces it
+		HANDLE _connect_mutex = NULL;
+		HANDLE _stop_event = NULL;
+
+		uint32_t _count_of_accepted = 0;
+	};
+
+	//	connects to the shm_acceptor of the same name
+	std::shared_ptr<shm_channel> shm_connect(const std::string& name_);
+}
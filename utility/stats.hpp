@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace utility
+{
+	class stats_counter;
+
+	typedef std::vector<std::pair<std::string, int64_t>> stats_snapshot;
+
+	//
+	//	the counters of the process by name, it's read by the stats_server
+	//
+	//	The counters register themselves for their lifetime. The counters of the same name
+	//	are summed in the snapshot, so every instance of a class can have its own.
+	//
+	class stats_registry
+	{
+	public:
+		stats_registry() = default;
+		stats_registry(const stats_registry&) = delete;
+		stats_registry& operator=(const stats_registry&) = delete;
+
+		static stats_registry& global()
+		{
+			static stats_registry registry;
+			return registry;
+		}
+
+		void add(const stats_counter& counter_)
+		{
+			std::lock_guard<std::mutex> lock { _mutex };
+			_counters.push_back(&counter_);
+		}
+
+		void remove(const stats_counter& counter_)
+		{
+			std::lock_guard<std::mutex> lock { _mutex };
+			_counters.erase(std::remove(_counters.begin(), _counters.end(), &counter_), _counters.end());
+		}
+
+		//	sorted by name
+		stats_snapshot snapshot() const;
+
+	private:
+		mutable std::mutex _mutex;
+		std::vector<const stats_counter*> _counters;
+	};
+
+	//
+	//	a sharded counter, it's cheap enough for the hot paths
+	//
+	//	Every thread adds to its own shard by a relaxed atomic add, so the threads don't
+	//	contend for a cache line unless there are more of them than shards. Reading sums
+	//	the shards, so the value is only eventually consistent with the concurrent adds.
+	//	A gauge, like the depth of a queue, is a counter which is decremented too.
+	//
+	class stats_counter
+	{
+	public:
+		explicit stats_counter(std::string name_, stats_registry& registry_ = stats_registry::global())
+			: _name { std::move(name_) }
+			, _registry { registry_ }
+		{
+			_registry.add(*this);
+		}
+
+		~stats_counter()
+		{
+			_registry.remove(*this);
+		}
+
+		stats_counter(const stats_counter&) = delete;
+		stats_counter& operator=(const stats_counter&) = delete;
+
+		void add(int64_t value_ = 1)
+		{
+			_shards[_shard_of_this_thread()].value.fetch_add(value_, std::memory_order_relaxed);
+		}
+
+		void sub(int64_t value_ = 1)
+		{
+			add(-value_);
+		}
+
+		int64_t value() const
+		{
+			int64_t sum = 0;
+
+			for (auto& s : _shards)
+			{
+				sum += s.value.load(std::memory_order_relaxed);
+			}
+
+			return sum;
+		}
+
+		const std::string& name() const
+		{
+			return _name;
+		}
+
+	private:
+		static const size_t COUNT_OF_SHARDS = 16;
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		//	a cache line of its own, so the shards aren't falsely shared
+		struct alignas(CACHE_LINE_SIZE) shard
+		{
+			std::atomic<int64_t> value { 0 };
+		};
+
+		std::string _name;
+		stats_registry& _registry;
+
+		shard _shards[COUNT_OF_SHARDS];
+
+		//	the threads are assigned to the shards round robin by their first add
+		static size_t _shard_of_this_thread()
+		{
+			static std::atomic<size_t> next_shard { 0 };
+			thread_local size_t shard = next_shard++ % COUNT_OF_SHARDS;
+
+			return shard;
+		}
+	};
+
+	inline stats_snapshot stats_registry::snapshot() const
+	{
+		stats_snapshot result;
+
+		{
+			std::lock_guard<std::mutex> lock { _mutex };
+
+			for (auto ptr_counter : _counters)
+			{
+				result.emplace_back(ptr_counter->name(), ptr_counter->value());
+			}
+		}
+
+		std::sort(result.begin(), result.end(), [](const stats_snapshot::value_type& a_, const stats_snapshot::value_type& b_)
+		{
+			return a_.first < b_.first;
+		});
+
+		//	the counters of the same name are summed
+		stats_snapshot merged;
+
+		for (auto& e : result)
+		{
+			if (!merged.empty() && merged.back().first == e.first)
+			{
+				merged.back().second += e.second;
+			}
+			else
+			{
+				merged.push_back(std::move(e));
+			}
+		}
+
+		return merged;
+	}
+}
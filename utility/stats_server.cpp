@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "stats_server.hpp"
+
+using namespace std;
+using namespace utility;
+
+namespace
+{
+	const size_t MAX_REQUEST_SIZE = 4096;
+
+	const chrono::milliseconds REQUEST_TIMEOUT { 1000 };
+
+	string quoted(const string& text_)
+	{
+		string result = "\"";
+
+		for (auto c : text_)
+		{
+			if (c == '"' || c == '\\')
+			{
+				result += '\\';
+			}
+
+			result += c;
+		}
+
+		return result + "\"";
+	}
+
+	//	the first line without the line break, the rest of the request is ignored
+	string read_request_line(const end_point& end_point_, io_deadline deadline_, const cancellation_token& cancellation_)
+	{
+		string request;
+		char buffer[512];
+
+		while (request.find('\n') == string::npos && request.size() < MAX_REQUEST_SIZE)
+		{
+			const auto size = end_point_.read(buffer, sizeof(buffer), deadline_, cancellation_);
+
+			if (size == 0)
+			{
+				break;
+			}
+
+			request.append(buffer, size);
+		}
+
+		request = request.substr(0, request.find('\n'));
+
+		if (!request.empty() && request.back() == '\r')
+		{
+			request.pop_back();
+		}
+
+		return request;
+	}
+}
+
+string utility::format_stats(const stats_snapshot& snapshot_, E_STATS_FORMAT format_)
+{
+	stringstream sb;
+
+	if (format_ == STATS_FORMAT_JSON)
+	{
+		sb << "{";
+
+		const char* separator = "";
+
+		for (auto& e : snapshot_)
+		{
+			sb << separator << quoted(e.first) << ":" << e.second;
+			separator = ",";
+		}
+
+		sb << "}\n";
+	}
+	else
+	{
+		for (auto& e : snapshot_)
+		{
+			sb << e.first << " " << e.second << "\n";
+		}
+	}
+
+	return sb.str();
+}
+
+stats_server::stats_server(desc desc_, stats_registry& registry_)
+	: _registry { registry_ }
+	, _server { move(desc_) }
+	, _serving { [this] { _serve(); } }
+{
+}
+
+stats_server::~stats_server()
+{
+	_cancellation.cancel();
+	_serving.join();
+}
+
+size_t stats_server::count_of_requests() const
+{
+	return _count_of_requests;
+}
+
+void stats_server::_serve()
+{
+	while (!_cancellation.is_cancelled())
+	{
+		try
+		{
+			auto peer = _server.listening(io_deadline::max(), _cancellation);
+
+			_respond(peer);
+		}
+		catch (exception&)
+		{
+			//	cancelled, or the client has gone or timed out
+		}
+	}
+}
+
+void stats_server::_respond(const end_point& peer_)
+{
+	const auto request = read_request_line(peer_, chrono::steady_clock::now() + REQUEST_TIMEOUT, _cancellation);
+
+	const bool is_http = request.compare(0, 4, "GET ") == 0;
+	const auto format = request.find("json") != string::npos ? STATS_FORMAT_JSON : STATS_FORMAT_TEXT;
+
+	auto body = format_stats(_registry.snapshot(), format);
+
+	string response;
+
+	if (is_http)
+	{
+		stringstream sb;
+		sb << "HTTP/1.0 200 OK\r\n"
+			<< "Content-Type: " << (format == STATS_FORMAT_JSON ? "application/json" : "text/plain") << "\r\n"
+			<< "Content-Length: " << body.size() << "\r\n"
+			<< "Connection: close\r\n"
+			<< "\r\n";
+
+		response = sb.str();
+	}
+
+	response += body;
+
+	peer_.write(response.data(), response.size(), chrono::steady_clock::now() + REQUEST_TIMEOUT, _cancellation);
+
+	++_count_of_requests;
+}
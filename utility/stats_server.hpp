@@ -0,0 +1,53 @@
+#pragma once
+#include "stdafx.h"
+#include "network.hpp"
+#include "stats.hpp"
+
+namespace utility
+{
+	enum E_STATS_FORMAT
+	{
+		//	a "<name> <value>" line per counter
+		STATS_FORMAT_TEXT,
+
+		//	{ "<name>": <value>, ... }
+		STATS_FORMAT_JSON,
+	};
+
+	std::string format_stats(const stats_snapshot&, E_STATS_FORMAT);
+
+	//
+	//	serves the snapshot of a stats_registry, one snapshot per connection
+	//
+	//	The request is a single line:
+	//		"text" or "json"		the snapshot is sent back and the connection is closed
+	//		"GET <path> HTTP/1.x"	an HTTP response, JSON if the path contains "json",
+	//								so the counters can be scraped by any HTTP client
+	//
+	//	The requests are served one by one on the thread of the server, a client has a
+	//	second to send its request.
+	//
+	class stats_server
+	{
+	public:
+		stats_server(desc, stats_registry& registry_ = stats_registry::global());
+		~stats_server();
+
+		stats_server(const stats_server&) = delete;
+		stats_server& operator=(const stats_server&) = delete;
+
+		size_t count_of_requests() const;
+
+	private:
+		stats_registry& _registry;
+		server _server;
+
+		cancellation_token _cancellation;
+		std::atomic<size_t> _count_of_requests { 0 };
+
+		std::thread _serving;
+
+		void _serve();
+		void _respond(const end_point&);
+	};
+}
@@ -17,10 +17,20 @@
 
 // TODO: reference additional headers your program requires here
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <codecvt>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <typeinfo>
 #include <typeindex>
 #include <unordered_map>
@@ -0,0 +1,109 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\network.hpp>
+#include <utility\buffer_pool.hpp>
+
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	TEST_CLASS(buffer_pool_unittest)
+	{
+	public:
+		TEST_METHOD(test_block_is_reused)
+		{
+			buffer_pool pool;
+
+			{
+				auto block = pool.acquire(1000);
+				Assert::AreEqual(size_t { 1024 }, block.second.size());
+			}
+
+			auto block = pool.acquire(700);
+
+			auto stats = pool.statistics();
+			Assert::AreEqual(size_t { 1 }, stats.count_of_allocations);
+			Assert::AreEqual(size_t { 1 }, stats.count_of_reuses);
+		}
+
+		TEST_METHOD(test_slices_share_the_block)
+		{
+			buffer_pool pool;
+
+			buffer_slice tail;
+
+			{
+				auto block = pool.acquire(512);
+				memcpy(block.first, "hello, world", 12);
+
+				tail = block.second.slice(7, 5);
+				Assert::AreEqual(2L, tail.use_count());
+			}
+
+			// the block is kept alive by the slice
+			Assert::AreEqual(1L, tail.use_count());
+			Assert::AreEqual(string { "world" }, string { tail.data(), tail.size() });
+
+			Assert::ExpectException<out_of_range>([&] { tail.slice(3, 3); });
+		}
+
+		TEST_METHOD(test_adaptive_size_grows)
+		{
+			adaptive_buffer_size size { 512 };
+
+			// every read fills the buffer
+			for (int i = 0; i < 4; ++i)
+			{
+				size.observe(size.next(), size.next());
+			}
+
+			Assert::IsTrue(size.next() >= 8 * 1024);
+
+			// small reads shrink it back
+			for (int i = 0; i < 100; ++i)
+			{
+				size.observe(100, size.next());
+			}
+
+			Assert::AreEqual(size_t { 512 }, size.next());
+		}
+
+		TEST_METHOD(test_read_slice)
+		{
+			server srv { desc { "27120" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27120" } };
+			auto ptr_peer = accepting.get();
+
+			buffer_pool pool;
+			ptr_peer->set_buffer_pool(pool);
+
+			const string MESSAGE { "hello" };
+			c.write(MESSAGE.data(), MESSAGE.size());
+
+			string received;
+			while (received.size() < MESSAGE.size())
+			{
+				auto slice = ptr_peer->read_slice();
+				received.append(slice.data(), slice.size());
+			}
+
+			Assert::AreEqual(MESSAGE, received);
+			Assert::AreEqual(MESSAGE.size(), pool.statistics().received_bytes);
+		}
+	};
+}
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\network.hpp>
+#include <utility\event_loop.hpp>
+#include <utility\connection_pool.hpp>
+#include <thread_pool\thread_pool>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	namespace
+	{
+		//	accepts and keeps every connection
+		struct accepting_server
+		{
+			thread_pool pool { 1 };
+			event_loop loop { pool };
+			server srv;
+
+			mutex mtx;
+			vector<shared_ptr<end_point>> accepted;
+
+			accepting_server(string port_)
+				: srv { desc { port_ } }
+			{
+				srv.async_accept(loop, [this](shared_ptr<end_point> ptr_end_point_, exception_ptr error_)
+				{
+					if (!error_)
+					{
+						lock_guard<mutex> l { mtx };
+						accepted.push_back(move(ptr_end_point_));
+					}
+				});
+			}
+		};
+
+		template<class F> bool wait_for(F condition_)
+		{
+			for (int i = 0; i < 500; ++i)
+			{
+				if (condition_())
+				{
+					return true;
+				}
+
+				this_thread::sleep_for(chrono::milliseconds { 10 });
+			}
+
+			return false;
+		}
+	}
+
+	TEST_CLASS(connection_pool_unittest)
+	{
+	public:
+		TEST_METHOD(test_connections_are_warmed_up_and_reused)
+		{
+			accepting_server srv { "27140" };
+
+			connection_pool_desc pool_desc;
+			pool_desc.warm_connections = 2;
+
+			connection_pool pool { pool_desc };
+
+			{
+				auto connection = pool.acquire("localhost", "27140");
+				connection->write("x", 1);
+			}
+
+			Assert::AreEqual(size_t { 1 }, pool.statistics().count_of_connects);
+
+			// the returned one and the ones of the background thread
+			Assert::IsTrue(wait_for([&] { return pool.idle("localhost", "27140") >= 2; }));
+
+			auto connection = pool.acquire("localhost", "27140");
+
+			auto statistics = pool.statistics();
+			Assert::AreEqual(size_t { 1 }, statistics.count_of_connects);
+			Assert::AreEqual(size_t { 1 }, statistics.count_of_reuses);
+		}
+
+		TEST_METHOD(test_discarded_connection_isnt_returned)
+		{
+			accepting_server srv { "27141" };
+
+			connection_pool_desc pool_desc;
+			pool_desc.warm_connections = 0;
+
+			connection_pool pool { pool_desc };
+
+			pool.acquire("localhost", "27141").discard();
+
+			Assert::AreEqual(size_t { 0 }, pool.idle("localhost", "27141"));
+
+			pool.acquire("localhost", "27141");
+
+			Assert::AreEqual(size_t { 1 }, pool.idle("localhost", "27141"));
+		}
+
+		TEST_METHOD(test_reconnect_backs_off)
+		{
+			connection_pool_desc pool_desc;
+			pool_desc.initial_backoff = chrono::milliseconds { 50 };
+
+			connection_pool pool { pool_desc };
+
+			// nothing listens on it
+			Assert::ExpectException<runtime_error>([&] { pool.acquire("localhost", "27142"); });
+
+			// the background thread keeps trying, but not in a tight loop
+			this_thread::sleep_for(chrono::milliseconds { 500 });
+
+			const auto failures = pool.statistics().count_of_failed_connects;
+			Assert::IsTrue(failures >= 1);
+			Assert::IsTrue(failures < 20);
+
+			// once the server is up, the pool gets warm again
+			accepting_server srv { "27142" };
+
+			Assert::IsTrue(wait_for([&] { return pool.idle("localhost", "27142") > 0; }));
+		}
+	};
+}
@@ -0,0 +1,122 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\network.hpp>
+#include <utility\framing.hpp>
+
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	TEST_CLASS(framing_unittest)
+	{
+	public:
+		TEST_METHOD(test_varint_round_trip)
+		{
+			const uint64_t values[] = { 0, 1, 127, 128, 300, 16383, 16384, 0xFFFFFFFF, 0xFFFFFFFFFFFFFFFF };
+
+			for (auto value : values)
+			{
+				char buffer[MAX_VARINT_SIZE];
+				auto size = encode_varint(value, buffer);
+
+				uint64_t decoded = 0;
+				Assert::AreEqual(size, decode_varint(buffer, size, decoded));
+				Assert::IsTrue(value == decoded);
+
+				// a truncated prefix is incomplete
+				Assert::AreEqual(size_t { 0 }, decode_varint(buffer, size - 1, decoded));
+			}
+		}
+
+		TEST_METHOD(test_frames_split_across_reads)
+		{
+			vector<string> messages { "", "a", string(200, 'b'), "{ \"value\": 42 }" };
+
+			// the whole stream
+			vector<char> stream;
+			for (auto& m : messages)
+			{
+				char prefix[MAX_VARINT_SIZE];
+				auto size_of_prefix = encode_varint(m.size(), prefix);
+
+				stream.insert(stream.end(), prefix, prefix + size_of_prefix);
+				stream.insert(stream.end(), m.begin(), m.end());
+			}
+
+			// it's fed byte by byte
+			frame_decoder decoder;
+			vector<string> frames;
+
+			for (auto c : stream)
+			{
+				auto space = decoder.prepare(1);
+				*space.first = c;
+				decoder.commit(1);
+
+				while (auto frame = decoder.next())
+				{
+					frames.emplace_back(frame->data(), frame->size());
+				}
+			}
+
+			Assert::AreEqual(messages.size(), frames.size());
+			for (size_t i = 0; i < messages.size(); ++i)
+			{
+				Assert::AreEqual(messages[i], frames[i]);
+			}
+
+			Assert::AreEqual(size_t { 0 }, decoder.buffered());
+		}
+
+		TEST_METHOD(test_too_large_frame)
+		{
+			frame_decoder decoder { 16 };
+
+			char prefix[MAX_VARINT_SIZE];
+			auto size_of_prefix = encode_varint(17, prefix);
+
+			auto space = decoder.prepare(size_of_prefix);
+			memcpy(space.first, prefix, size_of_prefix);
+			decoder.commit(size_of_prefix);
+
+			Assert::ExpectException<runtime_error>([&] { decoder.next(); });
+		}
+
+		TEST_METHOD(test_frame_reader_writer)
+		{
+			server srv { desc { "27110" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27110" } };
+			auto ptr_peer = accepting.get();
+
+			frame_writer writer { c };
+			writer.write("first");
+			writer.write(string(10000, 'x'));
+
+			frame_reader reader { *ptr_peer };
+
+			auto first = reader.read();
+			Assert::IsTrue(first.is_initialized());
+			Assert::AreEqual(string { "first" }, first->to_string());
+
+			auto second = reader.read();
+			Assert::IsTrue(second.is_initialized());
+			Assert::AreEqual(size_t { 10000 }, second->size());
+		}
+	};
+}
@@ -1,3 +1,4 @@
 #include "stdafx.h"
 
 #pragma comment(lib, "utility.lib")
+#pragma comment(lib, "thread_pool.lib")
@@ -0,0 +1,585 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\network.hpp>
+#include <utility\event_loop.hpp>
+#include <utility\coalescing_writer.hpp>
+#include <thread_pool\thread_pool>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	TEST_CLASS(network_unittest)
+	{
+	public:
+		TEST_METHOD(test_async_read_write)
+		{
+			thread_pool pool { 2 };
+			event_loop loop { pool };
+
+			server srv { desc { "27100" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27100" } };
+			auto ptr_peer = accepting.get();
+
+			loop.attach(c);
+			loop.attach(*ptr_peer);
+
+			Assert::AreEqual(size_t { 2 }, loop.size());
+
+			// it's pending since nothing was sent yet
+			char buffer[16] = { };
+			auto reading = ptr_peer->async_read(buffer, sizeof(buffer));
+
+			const string MESSAGE { "hello" };
+			auto writing = c.async_write(MESSAGE.data(), MESSAGE.size());
+
+			Assert::AreEqual(MESSAGE.size(), writing.get());
+			Assert::AreEqual(MESSAGE.size(), reading.get());
+			Assert::AreEqual(MESSAGE, string { buffer, MESSAGE.size() });
+		}
+
+		TEST_METHOD(test_detach_aborts_pending_read)
+		{
+			thread_pool pool { 1 };
+			event_loop loop { pool };
+
+			server srv { desc { "27101" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27101" } };
+			auto ptr_peer = accepting.get();
+
+			loop.attach(*ptr_peer);
+
+			promise<bool> aborted;
+			char buffer[16];
+
+			ptr_peer->async_read(buffer, sizeof(buffer), [&](size_t, exception_ptr error_)
+			{
+				aborted.set_value(error_ != nullptr);
+			});
+
+			loop.detach(*ptr_peer);
+
+			Assert::IsTrue(aborted.get_future().get());
+			Assert::AreEqual(size_t { 0 }, loop.size());
+		}
+
+		TEST_METHOD(test_write_behind_pending_read)
+		{
+			thread_pool pool { 2 };
+			event_loop loop { pool };
+
+			server srv { desc { "27109" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27109" } };
+			auto ptr_peer = accepting.get();
+
+			// the write can't be sent at once
+			int send_buffer_size = 4 * 1024;
+			setsockopt(c.native_handle(), SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&send_buffer_size), sizeof(send_buffer_size));
+
+			loop.attach(c);
+
+			// the socket is polled for the read only
+			char buffer[16];
+			auto reading = c.async_read(buffer, sizeof(buffer));
+
+			const string LARGE(4 * 1024 * 1024, 'x');
+			auto writing = c.async_write(LARGE.data(), LARGE.size());
+
+			// a stalled write times out
+			const auto deadline = chrono::steady_clock::now() + chrono::seconds { 5 };
+
+			vector<char> received(64 * 1024);
+			size_t size = 0;
+			while (size < LARGE.size())
+			{
+				size += ptr_peer->read(received.data(), received.size(), deadline);
+			}
+
+			Assert::AreEqual(LARGE.size(), writing.get());
+
+			// the read is still pending
+			Assert::IsTrue(future_status::timeout == reading.wait_for(chrono::milliseconds { 0 }));
+
+			ptr_peer->write("done", 4);
+			Assert::AreEqual(size_t { 4 }, reading.get());
+		}
+
+		TEST_METHOD(test_move_attached_end_point)
+		{
+			thread_pool pool { 1 };
+			event_loop loop { pool };
+
+			server srv { desc { "27112" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27112" } };
+			auto ptr_peer = accepting.get();
+
+			loop.attach(*ptr_peer);
+
+			char buffer[16] = { };
+			auto reading = ptr_peer->async_read(buffer, sizeof(buffer));
+
+			// the read goes on with the new object
+			auto ptr_moved = make_unique<end_point>(move(*ptr_peer));
+			ptr_peer.reset();
+
+			Assert::AreEqual(size_t { 1 }, loop.size());
+
+			const string MESSAGE { "hello" };
+			c.write(MESSAGE.data(), MESSAGE.size());
+
+			Assert::AreEqual(MESSAGE.size(), reading.get());
+			Assert::AreEqual(MESSAGE, string { buffer, MESSAGE.size() });
+
+			// and it's detached by the new object
+			ptr_moved.reset();
+			Assert::AreEqual(size_t { 0 }, loop.size());
+		}
+
+		TEST_METHOD(test_multishot_accept)
+		{
+			constexpr size_t COUNT_OF_CLIENTS = 3;
+
+			thread_pool pool { 1 };
+			event_loop loop { pool };
+
+			server srv { desc { "27102" } };
+
+			mutex mtx;
+			vector<shared_ptr<end_point>> accepted;
+			promise<void> all_accepted;
+
+			srv.async_accept(loop, [&](shared_ptr<end_point> ptr_end_point_, exception_ptr error_)
+			{
+				if (error_)
+				{
+					return;
+				}
+
+				lock_guard<mutex> l { mtx };
+				accepted.push_back(move(ptr_end_point_));
+
+				if (accepted.size() == COUNT_OF_CLIENTS)
+				{
+					all_accepted.set_value();
+				}
+			});
+
+			vector<unique_ptr<client>> clients;
+			for (size_t i = 0; i < COUNT_OF_CLIENTS; ++i)
+			{
+				clients.push_back(make_unique<client>("localhost", desc { "27102" }));
+			}
+
+			all_accepted.get_future().wait();
+
+			Assert::AreEqual(COUNT_OF_CLIENTS, accepted.size());
+		}
+
+		TEST_METHOD(test_registered_io_round_trip)
+		{
+			thread_pool pool { 2 };
+
+			unique_ptr<event_loop> ptr_loop;
+			try
+			{
+				ptr_loop = make_unique<event_loop>(pool, 1, IO_BACKEND_REGISTERED_IO);
+			}
+			catch (runtime_error&)
+			{
+				Logger::WriteMessage("registered I/O is not supported, the test is skipped");
+				return;
+			}
+
+			auto& loop = *ptr_loop;
+
+			Assert::IsTrue(IO_BACKEND_REGISTERED_IO == loop.backend());
+
+			server srv { desc { "27111" } };
+
+			promise<shared_ptr<end_point>> accepted;
+
+			srv.async_accept(loop, [&](shared_ptr<end_point> ptr_end_point_, exception_ptr error_)
+			{
+				error_ ? accepted.set_exception(error_) : accepted.set_value(move(ptr_end_point_));
+			});
+
+			client c { "localhost", desc { "27111" } };
+			auto ptr_peer = accepted.get_future().get();
+
+			loop.attach(c);
+			loop.attach(*ptr_peer);
+
+			Assert::AreEqual(size_t { 2 }, loop.size());
+
+			char buffer[16] = { };
+			auto reading = ptr_peer->async_read(buffer, sizeof(buffer));
+
+			const string MESSAGE { "hello" };
+			Assert::AreEqual(MESSAGE.size(), c.async_write(MESSAGE.data(), MESSAGE.size()).get());
+			Assert::AreEqual(MESSAGE.size(), reading.get());
+			Assert::AreEqual(MESSAGE, string { buffer, MESSAGE.size() });
+
+			// larger than a block of the pool, so it's copied in pieces, which are sent at once
+			const string LARGE(4 * 1024 * 1024, 'x');
+			auto writing = ptr_peer->async_write(LARGE.data(), LARGE.size());
+
+			string received;
+			vector<char> large_buffer(64 * 1024);
+			while (received.size() < LARGE.size())
+			{
+				const auto size = c.async_read(large_buffer.data(), large_buffer.size()).get();
+				Assert::IsTrue(size > 0);
+
+				received.append(large_buffer.data(), size);
+			}
+
+			Assert::AreEqual(LARGE.size(), writing.get());
+			Assert::IsTrue(LARGE == received);
+
+			// the slices are received and sent in place
+			auto block = loop.acquire_buffer(MESSAGE.size());
+			memcpy(block.first, MESSAGE.data(), MESSAGE.size());
+
+			promise<buffer_slice> slice_received;
+			ptr_peer->async_read_slice([&](buffer_slice slice_, exception_ptr error_)
+			{
+				error_ ? slice_received.set_exception(error_) : slice_received.set_value(move(slice_));
+			});
+
+			promise<size_t> slice_sent;
+			c.async_write(block.second.slice(0, MESSAGE.size()), [&](size_t size_, exception_ptr error_)
+			{
+				error_ ? slice_sent.set_exception(error_) : slice_sent.set_value(size_);
+			});
+
+			Assert::AreEqual(MESSAGE.size(), slice_sent.get_future().get());
+
+			const auto slice = slice_received.get_future().get();
+			Assert::AreEqual(MESSAGE, string { slice.data(), slice.size() });
+
+			loop.detach(c);
+			loop.detach(*ptr_peer);
+		}
+	
+		TEST_METHOD(test_write_v)
+		{
+			server srv { desc { "27103" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27103" } };
+			auto ptr_peer = accepting.get();
+
+			c.write_v({ { "hello", 5 }, { ", ", 2 }, { "world", 5 } });
+
+			string received;
+			char buffer[16];
+			while (received.size() < 12)
+			{
+				received.append(buffer, ptr_peer->read(buffer, sizeof(buffer)));
+			}
+
+			Assert::AreEqual(string { "hello, world" }, received);
+		}
+
+		TEST_METHOD(test_coalescing_writer)
+		{
+			server srv { desc { "27104" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27104" } };
+			auto ptr_peer = accepting.get();
+
+			// the time based flush won't kick in during the test
+			coalescing_writer writer { c, 64, chrono::milliseconds { 60 * 1000 } };
+
+			for (int i = 0; i < 10; ++i)
+			{
+				writer.write("abcd", 4);
+			}
+
+			Assert::AreEqual(size_t { 0 }, writer.count_of_sends());
+
+			// it doesn't fit, so it's sent together with the buffered ones
+			const string LARGE(100, 'x');
+			writer.write(LARGE.data(), LARGE.size());
+
+			Assert::AreEqual(size_t { 1 }, writer.count_of_sends());
+
+			writer.write("tail", 4);
+			writer.flush();
+
+			Assert::AreEqual(size_t { 2 }, writer.count_of_sends());
+			Assert::AreEqual(size_t { 144 }, writer.count_of_bytes());
+
+			string received;
+			char buffer[256];
+			while (received.size() < 144)
+			{
+				received.append(buffer, ptr_peer->read(buffer, sizeof(buffer)));
+			}
+
+			Assert::AreEqual(string { "abcd" }, received.substr(0, 4));
+			Assert::AreEqual(string { "tail" }, received.substr(140));
+		}
+
+		TEST_METHOD(test_coalescing_writer_flushes_in_time)
+		{
+			server srv { desc { "27105" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27105" } };
+			auto ptr_peer = accepting.get();
+
+			coalescing_writer writer { c, 1024, chrono::milliseconds { 1 } };
+			writer.write("ping", 4);
+
+			// no explicit flush, the background thread sends it
+			char buffer[4];
+			size_t size = 0;
+			while (size < 4)
+			{
+				size += ptr_peer->read(buffer + size, sizeof(buffer) - size);
+			}
+
+			Assert::AreEqual(string { "ping" }, string { buffer, 4 });
+		}
+	
+		TEST_METHOD(test_coalescing_writer_keeps_the_error)
+		{
+			// every send fails
+			end_point broken { INVALID_SOCKET, 512 };
+
+			coalescing_writer writer { broken, 64, chrono::milliseconds { 60 * 1000 } };
+
+			writer.write("abcd", 4);
+
+			const string LARGE(100, 'x');
+			Assert::ExpectException<runtime_error>([&] { writer.write(LARGE.data(), LARGE.size()); });
+
+			// the buffered bytes aren't sent again after the failed send
+			Assert::ExpectException<runtime_error>([&] { writer.write("efgh", 4); });
+			Assert::ExpectException<runtime_error>([&] { writer.flush(); });
+
+			Assert::AreEqual(size_t { 0 }, writer.count_of_sends());
+		}
+
+		TEST_METHOD(test_unix_socket)
+		{
+			char temp_path[MAX_PATH];
+			GetTempPathA(MAX_PATH, temp_path);
+
+			const auto address = string { "unix:" } + temp_path + "utility_unittest.sock";
+
+			server srv { desc { address } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { address, desc { "" } };
+			auto ptr_peer = accepting.get();
+
+			Assert::IsTrue(TRANSPORT_UNIX == c.transport());
+
+			// it's ignored
+			c.set_no_delay(true);
+
+			c.write("hello", 5);
+
+			char buffer[5];
+			size_t size = 0;
+			while (size < 5)
+			{
+				size += ptr_peer->read(buffer + size, sizeof(buffer) - size);
+			}
+
+			Assert::AreEqual(string { "hello" }, string { buffer, 5 });
+		}
+
+		TEST_METHOD(test_shared_memory)
+		{
+			server srv { desc { "shm:utility_unittest" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			auto ptr_client = make_unique<client>("shm:utility_unittest", desc { "" });
+			auto ptr_peer = accepting.get();
+
+			Assert::IsTrue(TRANSPORT_SHARED_MEMORY == ptr_client->transport());
+			Assert::IsTrue(INVALID_SOCKET == ptr_client->native_handle());
+
+			ptr_client->write_v({ { "ping", 4 }, { "pong", 4 } });
+
+			char buffer[8];
+			size_t size = 0;
+			while (size < 8)
+			{
+				size += ptr_peer->read(buffer + size, sizeof(buffer) - size);
+			}
+
+			Assert::AreEqual(string { "pingpong" }, string { buffer, 8 });
+
+			ptr_peer->write("back", 4);
+			Assert::AreEqual(size_t { 4 }, ptr_client->read(buffer, sizeof(buffer)));
+
+			// disconnected
+			ptr_client.reset();
+			Assert::AreEqual(size_t { 0 }, ptr_peer->read(buffer, sizeof(buffer)));
+		}
+
+		TEST_METHOD(test_shared_memory_without_server)
+		{
+			Assert::ExpectException<runtime_error>([] { client c { "shm:utility_unittest_nobody", desc { "" } }; });
+		}
+	
+		TEST_METHOD(test_read_deadline)
+		{
+			server srv { desc { "27106" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27106" } };
+			auto ptr_peer = accepting.get();
+
+			char buffer[16];
+
+			// nothing was sent
+			Assert::ExpectException<io_timeout_exception>([&]
+			{
+				ptr_peer->read(buffer, sizeof(buffer), chrono::steady_clock::now() + chrono::milliseconds { 50 });
+			});
+
+			// the connection is still usable
+			c.write("hello", 5);
+
+			const auto size = ptr_peer->read(buffer, sizeof(buffer), chrono::steady_clock::now() + chrono::seconds { 5 });
+			Assert::AreEqual(string { "hello" }, string { buffer, size });
+		}
+
+		TEST_METHOD(test_cancel_read_from_another_thread)
+		{
+			server srv { desc { "27107" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27107" } };
+			auto ptr_peer = accepting.get();
+
+			cancellation_token cancellation;
+
+			auto reading = async(launch::async, [&]
+			{
+				char buffer[16];
+				return ptr_peer->read(buffer, sizeof(buffer), io_deadline::max(), cancellation);
+			});
+
+			this_thread::sleep_for(chrono::milliseconds { 50 });
+			cancellation.cancel();
+
+			Assert::ExpectException<io_cancelled_exception>([&] { reading.get(); });
+
+			// it stays cancelled
+			char buffer[16];
+			Assert::ExpectException<io_cancelled_exception>([&] { ptr_peer->read(buffer, sizeof(buffer), io_deadline::max(), cancellation); });
+		}
+
+		TEST_METHOD(test_accept_deadline)
+		{
+			server srv { desc { "27108" } };
+
+			Assert::ExpectException<io_timeout_exception>([&]
+			{
+				srv.listening(chrono::steady_clock::now() + chrono::milliseconds { 50 });
+			});
+
+			// the server still accepts
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening(chrono::steady_clock::now() + chrono::seconds { 5 })); });
+
+			client c { "localhost", desc { "27108" } };
+			auto ptr_peer = accepting.get();
+
+			c.write("x", 1);
+
+			char buffer[1];
+			Assert::AreEqual(size_t { 1 }, ptr_peer->read(buffer, 1));
+		}
+
+		TEST_METHOD(test_accept_deadline_beside_blocking_accept)
+		{
+			server srv { desc { "27113" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			// it leaves the listening socket as it was for the other thread
+			Assert::ExpectException<io_timeout_exception>([&]
+			{
+				srv.listening(chrono::steady_clock::now() + chrono::milliseconds { 50 });
+			});
+
+			cancellation_token cancellation;
+			auto cancelled = async(launch::async, [&] { srv.listening(io_deadline::max(), cancellation); });
+
+			cancellation.cancel();
+			Assert::ExpectException<io_cancelled_exception>([&] { cancelled.get(); });
+
+			client c { "localhost", desc { "27113" } };
+			auto ptr_peer = accepting.get();
+
+			// the accepted socket blocks in the read
+			auto reading = async(launch::async, [&]
+			{
+				char buffer[1];
+				return ptr_peer->read(buffer, 1);
+			});
+
+			c.write("x", 1);
+			Assert::AreEqual(size_t { 1 }, reading.get());
+		}
+
+		TEST_METHOD(test_shared_memory_read_deadline)
+		{
+			server srv { desc { "shm:utility_unittest_deadline" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "shm:utility_unittest_deadline", desc { "" } };
+			auto ptr_peer = accepting.get();
+
+			char buffer[16];
+
+			Assert::ExpectException<io_timeout_exception>([&]
+			{
+				ptr_peer->read(buffer, sizeof(buffer), chrono::steady_clock::now() + chrono::milliseconds { 50 });
+			});
+		}
+	};
+}
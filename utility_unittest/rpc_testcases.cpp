@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\mirror.h>
+#include <utility\rpc.hpp>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	struct rpc_point
+	{
+		int x = 0;
+		int y = 0;
+	};
+
+	struct rpc_calculator
+	{
+		int add(int a_, int b_)
+		{
+			return a_ + b_;
+		}
+
+		string echo(string text_)
+		{
+			return text_;
+		}
+
+		rpc_point swap(rpc_point point_)
+		{
+			rpc_point result;
+			result.x = point_.y;
+			result.y = point_.x;
+
+			return result;
+		}
+
+		void fail()
+		{
+			throw runtime_error { "it has failed" };
+		}
+
+		static int twice(int n_)
+		{
+			return 2 * n_;
+		}
+	};
+
+	void register_rpc_classes(base_runtime_database& runtime_)
+	{
+		runtime_.add(make_shared<cpp_class_t>(
+			"rpc_point",
+			type_of<rpc_point>(),
+			make_constructor<rpc_point>(),
+			field_t { "x", &rpc_point::x },
+			field_t { "y", &rpc_point::y }
+		));
+
+		runtime_.add(make_shared<cpp_class_t>(
+			"rpc_calculator",
+			type_of<rpc_calculator>(),
+			make_constructor<rpc_calculator>(),
+			method_t { "add", &rpc_calculator::add },
+			method_t { "echo", &rpc_calculator::echo },
+			method_t { "swap", &rpc_calculator::swap },
+			method_t { "fail", &rpc_calculator::fail },
+			method_t { "twice", &rpc_calculator::twice }
+		));
+	}
+
+	TEST_CLASS(rpc_unittest)
+	{
+	public:
+		TEST_METHOD(test_call_returns_the_result)
+		{
+			base_runtime_database runtime;
+			register_rpc_classes(runtime);
+
+			rpc_server srv { runtime, desc { "27150" } };
+			srv.bind("calculator", object_ref { rpc_calculator { } });
+
+			rpc_client c { runtime, "localhost", desc { "27150" } };
+
+			Assert::AreEqual(5, c.call("calculator", "add", { object_ref { 2 }, object_ref { 3 } }).get().as<int>());
+			Assert::AreEqual(string(100000, 'x'), c.call("calculator", "echo", { object_ref { string(100000, 'x') } }).get().as<string>());
+			Assert::AreEqual(42, c.call("calculator", "twice", { object_ref { 21 } }).get().as<int>());
+		}
+
+		TEST_METHOD(test_registered_class_is_passed_by_its_fields)
+		{
+			base_runtime_database runtime;
+			register_rpc_classes(runtime);
+
+			rpc_server srv { runtime, desc { "27151" } };
+			srv.bind("calculator", object_ref { rpc_calculator { } });
+
+			rpc_client c { runtime, "localhost", desc { "27151" } };
+
+			rpc_point point;
+			point.x = -1;
+			point.y = 1000000;
+
+			auto result = c.call("calculator", "swap", { object_ref { move(point) } }).get().as<rpc_point>();
+
+			Assert::AreEqual(1000000, result.x);
+			Assert::AreEqual(-1, result.y);
+		}
+
+		TEST_METHOD(test_pipelined_calls_are_matched_by_id)
+		{
+			base_runtime_database runtime;
+			register_rpc_classes(runtime);
+
+			rpc_server srv { runtime, desc { "27152" } };
+			srv.bind("calculator", object_ref { rpc_calculator { } });
+
+			rpc_client c { runtime, "localhost", desc { "27152" } };
+
+			vector<future<object_ref>> results;
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				results.push_back(c.call("calculator", "add", { object_ref { int { i } }, object_ref { 1 } }));
+			}
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				Assert::AreEqual(i + 1, results[i].get().as<int>());
+			}
+
+			Assert::AreEqual(size_t { 0 }, c.count_of_calls_in_flight());
+			Assert::AreEqual(size_t { 1000 }, srv.count_of_calls());
+		}
+
+		TEST_METHOD(test_errors_are_returned_to_the_caller)
+		{
+			base_runtime_database runtime;
+			register_rpc_classes(runtime);
+
+			rpc_server srv { runtime, desc { "27153" } };
+			srv.bind("calculator", object_ref { rpc_calculator { } });
+
+			rpc_client c { runtime, "localhost", desc { "27153" } };
+
+			Assert::ExpectException<rpc_exception>([&] { c.call("calculator", "fail").get(); });
+			Assert::ExpectException<rpc_exception>([&] { c.call("nobody", "add", { object_ref { 1 }, object_ref { 2 } }).get(); });
+			Assert::ExpectException<rpc_exception>([&] { c.call("calculator", "add", { object_ref { 1 } }).get(); });
+
+			// the connection is still usable
+			Assert::AreEqual(3, c.call("calculator", "add", { object_ref { 1 }, object_ref { 2 } }).get().as<int>());
+		}
+
+		TEST_METHOD(test_calls_fail_when_the_server_is_gone)
+		{
+			base_runtime_database runtime;
+			register_rpc_classes(runtime);
+
+			auto ptr_server = make_unique<rpc_server>(runtime, desc { "27154" });
+			ptr_server->bind("calculator", object_ref { rpc_calculator { } });
+
+			rpc_client c { runtime, "localhost", desc { "27154" } };
+
+			Assert::AreEqual(3, c.call("calculator", "add", { object_ref { 1 }, object_ref { 2 } }).get().as<int>());
+
+			ptr_server.reset();
+
+			Assert::ExpectException<rpc_exception>([&]
+			{
+				//	the first calls may be written before the client notices the close
+				for (;;)
+				{
+					c.call("calculator", "add", { object_ref { 1 }, object_ref { 2 } }).get();
+				}
+			});
+		}
+	};
+}
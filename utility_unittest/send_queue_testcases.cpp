@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\network.hpp>
+#include <utility\send_queue.hpp>
+
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	TEST_CLASS(send_queue_unittest)
+	{
+	public:
+		TEST_METHOD(test_messages_are_sent_in_order)
+		{
+			server srv { desc { "27130" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27130" } };
+			auto ptr_peer = accepting.get();
+
+			send_queue queue { c };
+
+			string expected;
+			for (int i = 0; i < 100; ++i)
+			{
+				auto message = to_string(i) + ";";
+				expected += message;
+
+				Assert::IsTrue(queue.enqueue(message));
+			}
+
+			queue.flush();
+
+			Assert::AreEqual(size_t { 0 }, queue.queued_bytes());
+			Assert::AreEqual(expected.size(), queue.sent_bytes());
+
+			string received;
+			char buffer[256];
+			while (received.size() < expected.size())
+			{
+				received.append(buffer, ptr_peer->read(buffer, sizeof(buffer)));
+			}
+
+			Assert::AreEqual(expected, received);
+		}
+
+		TEST_METHOD(test_stalled_peer_doesnt_block_the_producer)
+		{
+			server srv { desc { "27131" } };
+
+			auto accepting = async(launch::async, [&] { return make_unique<end_point>(srv.listening()); });
+
+			client c { "localhost", desc { "27131" } };
+
+			// it never reads
+			auto ptr_peer = accepting.get();
+
+			const size_t MAX_QUEUED_BYTES = 256 * 1024;
+
+			send_queue queue { c, MAX_QUEUED_BYTES, OVERFLOW_POLICY_DROP_NEWEST };
+
+			// far more than the socket buffers can hold
+			const string MESSAGE(64 * 1024, 'x');
+			for (int i = 0; i < 1024; ++i)
+			{
+				queue.enqueue(MESSAGE);
+
+				Assert::IsTrue(queue.queued_bytes() <= MAX_QUEUED_BYTES);
+			}
+
+			Assert::IsTrue(queue.count_of_dropped_messages() > 0);
+			Assert::AreEqual(queue.count_of_dropped_messages() * MESSAGE.size(), queue.dropped_bytes());
+
+			// the sender thread is released by closing the connection
+			ptr_peer.reset();
+		}
+	};
+}
@@ -0,0 +1,146 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "unittest_converters.h"
+
+#include <utility\network.hpp>
+#include <utility\stats_server.hpp>
+
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace std;
+using namespace utility;
+
+namespace utility_unittest
+{
+	using namespace utility;
+
+	string request_stats(const string& port_, const string& request_)
+	{
+		client c { "localhost", desc { port_ } };
+		c.write(request_.data(), request_.size());
+
+		string response;
+		char buffer[256];
+
+		for (;;)
+		{
+			auto size = c.read(buffer, sizeof(buffer));
+
+			if (size == 0)
+			{
+				break;
+			}
+
+			response.append(buffer, size);
+		}
+
+		return response;
+	}
+
+	TEST_CLASS(stats_unittest)
+	{
+	public:
+		TEST_METHOD(test_counter_sums_the_adds_of_every_thread)
+		{
+			stats_registry registry;
+			stats_counter counter { "test.adds", registry };
+
+			vector<thread> threads;
+
+			for (int i = 0; i < 8; ++i)
+			{
+				threads.emplace_back([&]
+				{
+					for (int j = 0; j < 10000; ++j)
+					{
+						counter.add();
+					}
+
+					counter.sub(100);
+				});
+			}
+
+			for (auto& t : threads)
+			{
+				t.join();
+			}
+
+			Assert::AreEqual(int64_t { 8 * 9900 }, counter.value());
+		}
+
+		TEST_METHOD(test_snapshot_merges_the_counters_of_the_same_name)
+		{
+			stats_registry registry;
+
+			stats_counter b { "test.b", registry };
+			stats_counter a1 { "test.a", registry };
+			stats_counter a2 { "test.a", registry };
+
+			a1.add(2);
+			a2.add(3);
+			b.add(7);
+
+			{
+				stats_counter gone { "test.gone", registry };
+			}
+
+			auto snapshot = registry.snapshot();
+
+			Assert::AreEqual(size_t { 2 }, snapshot.size());
+			Assert::AreEqual(string("test.a"), snapshot[0].first);
+			Assert::AreEqual(int64_t { 5 }, snapshot[0].second);
+			Assert::AreEqual(string("test.b"), snapshot[1].first);
+			Assert::AreEqual(int64_t { 7 }, snapshot[1].second);
+		}
+
+		TEST_METHOD(test_server_answers_text_json_and_http)
+		{
+			stats_registry registry;
+			stats_counter counter { "test.requests", registry };
+			counter.add(42);
+
+			stats_server srv { desc { "27160" }, registry };
+
+			Assert::AreEqual(string("test.requests 42\n"), request_stats("27160", "text\n"));
+			Assert::AreEqual(string("{\"test.requests\":42}\n"), request_stats("27160", "json\r\n"));
+
+			auto response = request_stats("27160", "GET /stats.json HTTP/1.0\r\n\r\n");
+
+			Assert::IsTrue(response.find("HTTP/1.0 200 OK\r\n") == 0);
+			Assert::IsTrue(response.find("application/json") != string::npos);
+			Assert::IsTrue(response.find("\r\n\r\n{\"test.requests\":42}\n") != string::npos);
+
+			Assert::AreEqual(size_t { 3 }, srv.count_of_requests());
+		}
+
+		TEST_METHOD(test_network_counts_the_sent_and_received_bytes)
+		{
+			auto sent = bytes_sent_counter().value();
+			auto received = bytes_received_counter().value();
+
+			server srv { desc { "27161" } };
+
+			auto accepting = async(launch::async, [&] { return srv.listening(); });
+			client c { "localhost", desc { "27161" } };
+			auto accepted = accepting.get();
+
+			c.write("0123456789", 10);
+
+			char buffer[10];
+			size_t size = 0;
+
+			while (size < sizeof(buffer))
+			{
+				size += accepted.read(buffer + size, sizeof(buffer) - size);
+			}
+
+			Assert::IsTrue(bytes_sent_counter().value() >= sent + 10);
+			Assert::IsTrue(bytes_received_counter().value() >= received + 10);
+		}
+	};
+}